@@ -0,0 +1,102 @@
+/*!
+ * \file controller.c
+ *
+ * \brief This file implements the controller support declared in
+ * controller.h and the built-in controllers.
+ *
+ */
+
+#include <stdlib.h>
+#include "controller.h"
+
+/*!
+ * The ai paddle looks toward increasing columns, the player paddle toward
+ * decreasing ones; the view folds both to distances from the own paddle.
+ */
+void ctl_view_of(const match_state *m, int side, ctl_view *view)
+{
+    view->ball_y = m->ball_y;
+    view->ball_diry = m->ball_diry;
+    view->width = m->paddle_col - m->ai_paddle_col;
+    view->bottom_row = m->bottom_row;
+    view->level = m->gameLevel;
+
+    if (side == SIDE_AI)
+    {
+        view->ball_x = m->ball_x - m->ai_paddle_col;
+        view->ball_dirx = m->ball_dirx;
+        view->own_pos = m->ai_paddle_pos;
+        view->opp_pos = m->paddle_pos;
+    } else {
+        view->ball_x = m->paddle_col - m->ball_x;
+        view->ball_dirx = -m->ball_dirx;
+        view->own_pos = m->paddle_pos;
+        view->opp_pos = m->ai_paddle_pos;
+    }
+}
+
+/*!
+ * Move one row toward the ball row, as ai_step does.
+ */
+static void chase_decide(controller *c, const ctl_view *view, int n,
+        int *intent)
+{
+    int i;
+
+    (void) c;
+    for (i = 0; i < n; ++i)
+    {
+        int diff = view[i].ball_y - view[i].own_pos;
+
+        intent[i] = (diff > 0) - (diff < 0);
+    }
+}
+
+/*!
+ * The chase controller is stateless and shared.
+ */
+controller *ctl_chase(void)
+{
+    static controller chase = { "chase", chase_decide, NULL, NULL };
+
+    return &chase;
+}
+
+/*!
+ * An approaching ball reaches the own paddle in ball_x steps; a leaving
+ * one is assumed to be returned by the opponent.
+ */
+static void predict_decide(controller *c, const ctl_view *view, int n,
+        int *intent)
+{
+    int i;
+
+    (void) c;
+    for (i = 0; i < n; ++i)
+    {
+        int d = view[i].ball_dirx < 0
+            ? view[i].ball_x : 2 * view[i].width - view[i].ball_x;
+        int diff = ball_row_after(view[i].ball_y, view[i].ball_diry,
+                view[i].bottom_row, d) - view[i].own_pos;
+
+        intent[i] = (diff > 0) - (diff < 0);
+    }
+}
+
+/*!
+ * The predict controller is stateless and shared.
+ */
+controller *ctl_predict(void)
+{
+    static controller predict = { "predict", predict_decide, NULL, NULL };
+
+    return &predict;
+}
+
+/*!
+ */
+void ctl_destroy(controller *c)
+{
+    if (c->destroy)
+        c->destroy(c);
+}
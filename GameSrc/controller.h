@@ -0,0 +1,75 @@
+/*!
+ * \file controller.h
+ *
+ * \brief Pluggable paddle controllers.
+ *
+ * A controller looks at a match from the side of the paddle it drives
+ * (ctl_view) and answers with an intent: -1 to move up, 1 to move down, 0
+ * to stand still. Decisions are always requested in batches, so a
+ * controller evaluating many matches at once pays its call overhead once.
+ */
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include "rules.h"
+
+#define SIDE_AI 0 /*!< paddle on the left (ai) side */
+#define SIDE_PLAYER 1 /*!< paddle on the right (player) side */
+
+/*!
+ * A match seen from one paddle
+ */
+typedef struct {
+    int ball_x; /*!< ball distance from the own paddle column */
+    int ball_y; /*!< ball row */
+    int ball_dirx; /*!< 1 when the ball moves away, -1 when it approaches */
+    int ball_diry; /*!< ball y speed component */
+    int own_pos; /*!< own paddle row */
+    int opp_pos; /*!< opponent paddle row */
+    int width; /*!< distance between the paddle columns */
+    int bottom_row; /*!< last row of the field */
+    int level; /*!< current game level */
+} ctl_view;
+
+/*!
+ * Paddle controller
+ */
+typedef struct controller {
+    const char *name; /*!< controller name, for reports */
+    /*! store in intent[i] the decision for view[i], for i < n */
+    void (*decide_batch)(struct controller *c, const ctl_view *view, int n,
+            int *intent);
+    void (*destroy)(struct controller *c); /*!< release the controller */
+    void *ctx; /*!< controller private data */
+} controller;
+
+/*!
+ * \brief Fill the view of a match from one side.
+ *
+ * @param m match state
+ * @param side SIDE_AI or SIDE_PLAYER
+ * @param view view to fill
+ */
+void ctl_view_of(const match_state *m, int side, ctl_view *view);
+
+/*!
+ * \brief Return the built-in controller chasing the ball row, the one
+ * ai_step plays with.
+ */
+controller *ctl_chase(void);
+
+/*!
+ * \brief Return the built-in controller moving toward the row where the
+ * ball will next reach the own paddle, bounces included.
+ */
+controller *ctl_predict(void);
+
+/*!
+ * \brief Release a controller.
+ *
+ * @param c controller
+ */
+void ctl_destroy(controller *c);
+
+#endif
@@ -0,0 +1,100 @@
+/*!
+ * \file gfx.c
+ *
+ * \brief This file implements the sprite commands declared in gfx.h.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "gfx.h"
+
+#define GFX_PLACEMENT 1 /*!< placement id of every sprite */
+
+static const char b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*!
+ * Append a command with its payload.
+ */
+static void command(tbuf *b, const char *keys, const char *payload, size_t n)
+{
+    tb_put(b, "\033_G", 3);
+    tb_put(b, keys, strlen(keys));
+    if (n)
+    {
+        tb_put(b, ";", 1);
+        tb_put(b, payload, n);
+    }
+    tb_put(b, "\033\\", 2);
+}
+
+/*!
+ */
+void gfx_upload(tbuf *b, int id, int w, int h, const unsigned char *rgba)
+{
+    char keys[96];
+    char chunk[GFX_CHUNK];
+    size_t size = (size_t) w * h * 4;
+    size_t i = 0, n = 0;
+    int first = 1;
+
+    while (i < size)
+    {
+        /* 3 bytes to 4 base64 characters, padded at the end */
+        unsigned v = rgba[i] << 16;
+
+        v |= (i + 1 < size ? rgba[i + 1] : 0) << 8;
+        v |= i + 2 < size ? rgba[i + 2] : 0;
+        chunk[n++] = b64[v >> 18 & 63];
+        chunk[n++] = b64[v >> 12 & 63];
+        chunk[n++] = i + 1 < size ? b64[v >> 6 & 63] : '=';
+        chunk[n++] = i + 2 < size ? b64[v & 63] : '=';
+        i += 3;
+
+        if (n == GFX_CHUNK || i >= size)
+        {
+            /* the first chunk carries the keys, m=1 while more follow */
+            if (first)
+                snprintf(keys, sizeof keys,
+                        "a=t,f=32,s=%d,v=%d,i=%d,q=2,m=%d",
+                        w, h, id, i < size);
+            else
+                snprintf(keys, sizeof keys, "m=%d", i < size);
+            command(b, keys, chunk, n);
+            first = 0;
+            n = 0;
+        }
+    }
+}
+
+/*!
+ */
+void gfx_place(tbuf *b, int id, int cols, int rows)
+{
+    char keys[64];
+
+    snprintf(keys, sizeof keys, "a=p,i=%d,p=%d,c=%d,r=%d,z=1,C=1,q=2",
+            id, GFX_PLACEMENT, cols, rows);
+    command(b, keys, NULL, 0);
+}
+
+/*!
+ */
+void gfx_hide(tbuf *b, int id)
+{
+    char keys[32];
+
+    snprintf(keys, sizeof keys, "a=d,d=i,i=%d,q=2", id);
+    command(b, keys, NULL, 0);
+}
+
+/*!
+ */
+void gfx_free(tbuf *b, int id)
+{
+    char keys[32];
+
+    snprintf(keys, sizeof keys, "a=d,d=I,i=%d,q=2", id);
+    command(b, keys, NULL, 0);
+}
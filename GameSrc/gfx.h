@@ -0,0 +1,61 @@
+/*!
+ * \file gfx.h
+ *
+ * \brief Sprites drawn with the kitty terminal graphics protocol.
+ *
+ * An image is transmitted once under an id, and then shown by placing it
+ * at the cursor. Placing an image again with the same placement id moves
+ * the existing placement, so a moving sprite costs a cursor motion and a
+ * short placement command per frame, whatever its resolution. Commands
+ * are encoded into a termout buffer and sent with the frame.
+ */
+
+#ifndef GFX_H
+#define GFX_H
+
+#include "termout.h"
+
+#define GFX_CHUNK 4096 /*!< max base64 bytes of image data per command */
+
+/*!
+ * \brief Append the transmission of an image.
+ *
+ * @param b buffer
+ * @param id image id, greater than 0
+ * @param w width in pixels
+ * @param h height in pixels
+ * @param rgba w x h pixels, 4 bytes each
+ */
+void gfx_upload(tbuf *b, int id, int w, int h, const unsigned char *rgba);
+
+/*!
+ * \brief Append the placement of an image at the cursor.
+ *
+ * The image is scaled to the given cells, drawn above the text, and the
+ * cursor doesn't move.
+ *
+ * @param b buffer
+ * @param id image id
+ * @param cols width in cells
+ * @param rows height in cells
+ */
+void gfx_place(tbuf *b, int id, int cols, int rows);
+
+/*!
+ * \brief Append the removal of the placement of an image, keeping its
+ * data for later placements.
+ *
+ * @param b buffer
+ * @param id image id
+ */
+void gfx_hide(tbuf *b, int id);
+
+/*!
+ * \brief Append the removal of an image and of its data.
+ *
+ * @param b buffer
+ * @param id image id
+ */
+void gfx_free(tbuf *b, int id);
+
+#endif
@@ -0,0 +1,199 @@
+/*!
+ * \file lanes.c
+ *
+ * \brief This file implements the lane-per-match simulator declared in
+ * lanes.h.
+ *
+ * Comparisons between vectors give -1 in the lanes where they hold and 0
+ * elsewhere, so they are used directly as masks: every rule of ball_step
+ * is evaluated in all the lanes and its effect is blended in only where
+ * the condition mask is set.
+ */
+
+#include "lanes.h"
+
+/*!
+ * Return a where mask is set, b elsewhere.
+ */
+static inline lane_vec select(lane_vec mask, lane_vec a, lane_vec b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+/*!
+ * Return the absolute value of each lane.
+ */
+static inline lane_vec vabs(lane_vec v)
+{
+    lane_vec sign = v >> 31;
+
+    return (v ^ sign) - sign;
+}
+
+/*!
+ */
+void lanes_load(match_lanes *l, const match_state *m)
+{
+    int i;
+
+    for (i = 0; i < LANES; ++i)
+    {
+        l->paddle_pos[i] = m[i].paddle_pos;
+        l->paddle_col[i] = m[i].paddle_col;
+        l->ai_paddle_pos[i] = m[i].ai_paddle_pos;
+        l->ai_paddle_col[i] = m[i].ai_paddle_col;
+        l->ball_x[i] = m[i].ball_x;
+        l->ball_y[i] = m[i].ball_y;
+        l->ball_dirx[i] = m[i].ball_dirx;
+        l->ball_diry[i] = m[i].ball_diry;
+        l->bottom_row[i] = m[i].bottom_row;
+        l->gameLevel[i] = m[i].gameLevel;
+        l->hitCnt[i] = m[i].hitCnt;
+        l->ai_time[i] = m[i].ai_time;
+    }
+}
+
+/*!
+ */
+void lanes_store(const match_lanes *l, match_state *m)
+{
+    int i;
+
+    for (i = 0; i < LANES; ++i)
+    {
+        m[i].paddle_pos = l->paddle_pos[i];
+        m[i].paddle_col = l->paddle_col[i];
+        m[i].ai_paddle_pos = l->ai_paddle_pos[i];
+        m[i].ai_paddle_col = l->ai_paddle_col[i];
+        m[i].ball_x = l->ball_x[i];
+        m[i].ball_y = l->ball_y[i];
+        m[i].ball_dirx = l->ball_dirx[i];
+        m[i].ball_diry = l->ball_diry[i];
+        m[i].bottom_row = l->bottom_row[i];
+        m[i].gameLevel = l->gameLevel[i];
+        m[i].hitCnt = l->hitCnt[i];
+        m[i].ai_time = l->ai_time[i];
+    }
+}
+
+/*!
+ * Masked version of ball_step: a lane that ends its match on the player
+ * side skips the ai paddle check, as the early return of ball_step does.
+ */
+static inline lane_vec lanes_ball(match_lanes *l)
+{
+    lane_vec zero = {0};
+    lane_vec x, y, dx, dy;
+    lane_vec wall, hitp, missp, lvlup, winlvl, hita, missa, in;
+    lane_vec ev;
+
+    /* update ball coordinates */
+    y = l->ball_y + l->ball_diry;
+    x = l->ball_x + l->ball_dirx;
+    dx = l->ball_dirx;
+    dy = l->ball_diry;
+
+    /* reflect ball on field top and bottom */
+    wall = (y < FIELD_TOP) | (y > l->bottom_row);
+    dy = select(wall, -dy, dy);
+    y = select(wall, y + 2 * dy, y);
+
+    /* reflect ball on player pad */
+    in = vabs(l->paddle_pos - y + dy) <= PADDLE_WIDTH / 2;
+    hitp = (x == l->paddle_col) & in;
+    missp = (x == l->paddle_col) & ~in;
+    dx = select(hitp, -dx, dx);
+    x = select(hitp, x + 2 * dx, x);
+
+    lvlup = hitp & (l->hitCnt >= MAX_HITCNT);
+    l->gameLevel -= lvlup;
+    l->hitCnt = select(lvlup, zero, l->hitCnt - hitp);
+    winlvl = hitp & (l->gameLevel > MAX_LEVEL);
+
+    /* reflect ball on AI pad, unless the match already ended */
+    in = vabs(l->ai_paddle_pos - y + dy) <= PADDLE_WIDTH / 2;
+    hita = ~(missp | winlvl) & (x == l->ai_paddle_col) & in;
+    missa = ~(missp | winlvl) & (x == l->ai_paddle_col) & ~in;
+    dx = select(hita, -dx, dx);
+    x = select(hita, x + 2 * dx, x);
+
+    l->ball_x = x;
+    l->ball_y = y;
+    l->ball_dirx = dx;
+    l->ball_diry = dy;
+
+    ev = wall & BALL_WALL;
+    ev |= hitp & BALL_HIT_PLAYER;
+    ev |= hita & BALL_HIT_AI;
+    ev |= lvlup & BALL_LEVEL_UP;
+    ev |= (winlvl | missa) & BALL_PLAYER_WINS;
+    ev |= missp & BALL_AI_WINS;
+    return ev;
+}
+
+/*!
+ * Masked version of ai_step, applied only to the lanes in move.
+ */
+static inline void lanes_ai(match_lanes *l, lane_vec move)
+{
+    lane_vec diff = l->ball_y - l->ai_paddle_pos;
+    lane_vec new = l->ai_paddle_pos + (diff < 0) - (diff > 0);
+    lane_vec ok = (new >= PADDLE_WIDTH / 2)
+        & (new <= l->bottom_row - PADDLE_WIDTH / 2);
+
+    l->ai_paddle_pos = select(move & ok, new, l->ai_paddle_pos);
+}
+
+/*!
+ * The ai catch-up loop runs a fixed AI_MAX_CATCHUP times, each lane moving
+ * only while it has TIME_GAP_AI microseconds left.
+ */
+lane_vec lanes_step(match_lanes *l, lane_vec dir)
+{
+    lane_vec zero = {0};
+    lane_vec up, down, over, delay, ev;
+    int n;
+
+    /* player paddle */
+    up = (dir < 0) & (l->paddle_pos > PADDLE_WIDTH / 2);
+    down = (dir > 0) & (l->paddle_pos < l->bottom_row - PADDLE_WIDTH / 2);
+    l->paddle_pos += up - down;
+
+    /* ball */
+    ev = lanes_ball(l);
+    over = (ev & BALL_OVER) != zero;
+
+    /* ai catches up with the ball delay of the running matches */
+    delay = TIME_GAP_BALL * (MAX_LEVEL - 1 - l->gameLevel);
+    delay &= delay > zero;
+    l->ai_time += delay & ~over;
+    for (n = 0; n < AI_MAX_CATCHUP; ++n)
+    {
+        lane_vec move = l->ai_time >= TIME_GAP_AI;
+
+        lanes_ai(l, move);
+        l->ai_time -= move & TIME_GAP_AI;
+    }
+
+    return ev;
+}
+
+/*!
+ */
+void lanes_serve(match_lanes *l, lane_vec mask, lane_vec diry)
+{
+    lane_vec zero = {0};
+    lane_vec pos = (PADDLE_WIDTH / 2
+            + l->bottom_row - PADDLE_WIDTH / 2) / 2;
+
+    l->paddle_pos = select(mask, pos, l->paddle_pos);
+    l->ai_paddle_pos = select(mask, pos, l->ai_paddle_pos);
+    l->ai_paddle_col = select(mask, zero + AI_COL, l->ai_paddle_col);
+    l->ball_x = select(mask, l->paddle_col - 1, l->ball_x);
+    l->ball_y = select(mask, pos, l->ball_y);
+    l->ball_dirx = select(mask, zero - 1, l->ball_dirx);
+    l->ball_diry = select(mask, diry, l->ball_diry);
+    l->gameLevel &= ~mask;
+    l->hitCnt &= ~mask;
+    l->ai_time &= ~mask;
+}
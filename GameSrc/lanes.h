@@ -0,0 +1,85 @@
+/*!
+ * \file lanes.h
+ *
+ * \brief Lane-per-match batch simulator.
+ *
+ * LANES independent matches are stored column-wise, one match per vector
+ * lane, and advanced together by one instruction stream. Wall reflection,
+ * paddle hit and miss are computed with lane masks and no branches, with
+ * the same semantics as match_step (rules.h), bit for bit.
+ *
+ * Vectors use the GCC vector extensions, so the same source compiles to
+ * AVX2 (-mavx2, 8 lanes), AVX-512 (-mavx512f, 16 lanes), or 4 lanes of
+ * SSE2 or NEON (the board) otherwise.
+ */
+
+#ifndef LANES_H
+#define LANES_H
+
+#include "rules.h"
+
+#if defined(__AVX512F__)
+#define LANES 16 /*!< matches per vector */
+#elif defined(__AVX2__)
+#define LANES 8 /*!< matches per vector */
+#else
+#define LANES 4 /*!< matches per vector (SSE2, NEON) */
+#endif
+
+/*! vector holding one int for each match */
+typedef int lane_vec __attribute__((vector_size(LANES * sizeof (int))));
+
+/*!
+ * LANES match states, one per lane (see match_state)
+ */
+typedef struct {
+    lane_vec paddle_pos; /*!< player paddle rows */
+    lane_vec paddle_col; /*!< player paddle columns */
+    lane_vec ai_paddle_pos; /*!< ai paddle rows */
+    lane_vec ai_paddle_col; /*!< ai paddle columns */
+    lane_vec ball_x; /*!< ball columns */
+    lane_vec ball_y; /*!< ball rows */
+    lane_vec ball_dirx; /*!< ball x speed components */
+    lane_vec ball_diry; /*!< ball y speed components */
+    lane_vec bottom_row; /*!< last rows of the fields */
+    lane_vec gameLevel; /*!< game levels */
+    lane_vec hitCnt; /*!< hit counts of the current levels */
+    lane_vec ai_time; /*!< us accumulated toward the next ai moves */
+} match_lanes;
+
+/*!
+ * \brief Copy LANES match states into the lanes.
+ *
+ * @param l lanes
+ * @param m LANES match states
+ */
+void lanes_load(match_lanes *l, const match_state *m);
+
+/*!
+ * \brief Copy the lanes back into LANES match states.
+ *
+ * @param l lanes
+ * @param m LANES match states
+ */
+void lanes_store(const match_lanes *l, match_state *m);
+
+/*!
+ * \brief Advance all lanes by one match_step.
+ *
+ * @param l lanes
+ * @param dir player paddle move of each lane (-1, 0, 1)
+ * @return BALL_* flags of each lane
+ */
+lane_vec lanes_step(match_lanes *l, lane_vec dir);
+
+/*!
+ * \brief Serve again the selected lanes, as match_serve does on a field
+ * of the same size.
+ *
+ * @param l lanes
+ * @param mask -1 for the lanes to serve, 0 for the others
+ * @param diry initial vertical direction of the ball of each lane
+ */
+void lanes_serve(match_lanes *l, lane_vec mask, lane_vec diry);
+
+#endif
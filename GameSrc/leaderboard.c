@@ -0,0 +1,248 @@
+/*!
+ * \file leaderboard.c
+ *
+ * \brief This file implements the leaderboard declared in leaderboard.h.
+ *
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "leaderboard.h"
+
+#define SLOT_SHIFT 56 /*!< position of the slot in lb->current */
+#define READERS_MASK ((1ULL << SLOT_SHIFT) - 1) /*!< readers in lb->current */
+/*! v limited to 0 .. max */
+#define CLAMP(v, max) \
+    ((v) < 0 ? 0 : (unsigned long long) (v) > (max) ? (max) \
+     : (unsigned long long) (v))
+
+/*!
+ * The ranking of a result as a single number: score, level, then rally.
+ */
+static unsigned long long key(const lb_result *r)
+{
+    return CLAMP(r->score, 0x7fffffffULL) << 32
+        | CLAMP(r->level, 0xffULL) << 24 | CLAMP(r->rally, 0xffffffULL);
+}
+
+/*!
+ * Enters a result in the board being merged, keeping the best result of
+ * each player only: a player evicted from the board can only come back
+ * with a result better than the last one, so nothing is lost by forgetting
+ * it.
+ */
+static void merge_one(leaderboard *lb, const lb_result *r)
+{
+    lb_board *b = &lb->work;
+    unsigned long long k = key(r);
+    int i;
+
+    if (b->count == lb->k && k <= key(&b->top[b->count - 1]))
+        return;
+
+    for (i = 0; i < b->count && b->top[i].player != r->player; i++)
+        ;
+    if (i < b->count)
+    {
+        if (k <= key(&b->top[i]))
+            return;
+        memmove(&b->top[i], &b->top[i + 1],
+                (b->count - i - 1) * sizeof b->top[0]);
+        b->count--;
+    }
+    else if (b->count == lb->k)
+        b->count--;
+
+    for (i = b->count; i > 0 && key(&b->top[i - 1]) < k; i--)
+        ;
+    memmove(&b->top[i + 1], &b->top[i], (b->count - i) * sizeof b->top[0]);
+    b->top[i] = *r;
+    b->count++;
+    lb->dirty = 1;
+}
+
+/*!
+ * Publishes the board being merged in a spare slot, one that no reader
+ * still copies. With all the spares busy the publication waits for the
+ * next merge, the readers are never waited for.
+ */
+static void publish(leaderboard *lb)
+{
+    unsigned long long old;
+    int cur = atomic_load_explicit(&lb->current, memory_order_relaxed)
+        >> SLOT_SHIFT;
+    int s;
+
+    for (s = 0; s < LB_SLOTS; s++)
+        if (s != cur && atomic_load_explicit(&lb->released[s],
+                    memory_order_acquire) == lb->acquired[s])
+            break;
+    if (s == LB_SLOTS)
+        return;
+
+    lb->work.version++;
+    memcpy(&lb->slot[s], &lb->work,
+            offsetof(lb_board, top) + lb->work.count * sizeof lb->work.top[0]);
+    old = atomic_exchange_explicit(&lb->current,
+            (unsigned long long) s << SLOT_SHIFT, memory_order_acq_rel);
+    lb->acquired[cur] += old & READERS_MASK;
+
+    atomic_store_explicit(&lb->floor,
+            lb->work.count == lb->k ? key(&lb->work.top[lb->k - 1]) : 0,
+            memory_order_relaxed);
+    lb->dirty = 0;
+}
+
+/*!
+ */
+int lb_init(leaderboard *lb, int k)
+{
+    int i;
+
+    if (k < 1 || k > LB_MAX_K)
+        return -1;
+    memset(lb, 0, sizeof *lb);
+    lb->k = k;
+    atomic_init(&lb->floor, 0);
+    atomic_init(&lb->writers, 0);
+    for (i = 0; i < LB_WRITERS; i++)
+        atomic_init(&lb->writer[i], NULL);
+    atomic_init(&lb->current, 0);
+    for (i = 0; i < LB_SLOTS; i++)
+        atomic_init(&lb->released[i], 0);
+    atomic_init(&lb->stop, 0);
+    return 0;
+}
+
+/*!
+ */
+lb_writer *lb_writer_open(leaderboard *lb)
+{
+    lb_writer *w;
+    int i = atomic_fetch_add(&lb->writers, 1);
+
+    if (i >= LB_WRITERS)
+        return NULL;
+    w = aligned_alloc(64, sizeof *w);
+    if (!w)
+        return NULL;
+    memset(w, 0, sizeof *w);
+    atomic_init(&w->head, 0);
+    atomic_init(&w->tail, 0);
+    atomic_store_explicit(&lb->writer[i], w, memory_order_release);
+    return w;
+}
+
+/*!
+ * The threshold is read relaxed: a stale one only lets through a result
+ * the merge step will drop.
+ */
+int lb_insert(leaderboard *lb, lb_writer *w, const lb_result *r)
+{
+    unsigned long long floor = atomic_load_explicit(&lb->floor,
+            memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&w->head, memory_order_relaxed);
+
+    if (floor && key(r) <= floor)
+    {
+        w->filtered++;
+        return 0;
+    }
+    if (head - w->tail_seen >= LB_RING)
+    {
+        w->tail_seen = atomic_load_explicit(&w->tail, memory_order_acquire);
+        if (head - w->tail_seen >= LB_RING)
+        {
+            w->full++;
+            return -1;
+        }
+    }
+    w->ring[head & (LB_RING - 1)] = *r;
+    atomic_store_explicit(&w->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/*!
+ */
+int lb_merge(leaderboard *lb)
+{
+    int n = atomic_load_explicit(&lb->writers, memory_order_acquire);
+    int merged = 0;
+    unsigned long head, tail;
+    lb_writer *w;
+    int i;
+
+    for (i = 0; i < n && i < LB_WRITERS; i++)
+    {
+        w = atomic_load_explicit(&lb->writer[i], memory_order_acquire);
+        if (!w)
+            continue;
+        tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+        head = atomic_load_explicit(&w->head, memory_order_acquire);
+        for (; tail != head; tail++, merged++)
+            merge_one(lb, &w->ring[tail & (LB_RING - 1)]);
+        atomic_store_explicit(&w->tail, tail, memory_order_release);
+    }
+    lb->work.merged += merged;
+    if (lb->dirty)
+        publish(lb);
+    return merged;
+}
+
+/*!
+ */
+static void *merge_thread(void *arg)
+{
+    leaderboard *lb = arg;
+
+    while (!atomic_load_explicit(&lb->stop, memory_order_relaxed))
+        if (!lb_merge(lb))
+            usleep(LB_IDLE_US);
+    lb_merge(lb);
+    return NULL;
+}
+
+/*!
+ */
+int lb_start(leaderboard *lb)
+{
+    if (pthread_create(&lb->thread, NULL, merge_thread, lb) != 0)
+        return -1;
+    lb->running = 1;
+    return 0;
+}
+
+/*!
+ * A reader counts itself in the current slot and takes it in the same
+ * atomic add, so it never retries: the slot can't be reused before the
+ * reader counts itself out.
+ */
+void lb_read(leaderboard *lb, lb_board *out)
+{
+    unsigned long long cur = atomic_fetch_add_explicit(&lb->current, 1,
+            memory_order_acquire);
+    int s = cur >> SLOT_SHIFT;
+    const lb_board *b = &lb->slot[s];
+
+    memcpy(out, b, offsetof(lb_board, top) + b->count * sizeof b->top[0]);
+    atomic_fetch_add_explicit(&lb->released[s], 1, memory_order_release);
+}
+
+/*!
+ */
+void lb_destroy(leaderboard *lb)
+{
+    int n = atomic_load(&lb->writers);
+    int i;
+
+    if (lb->running)
+    {
+        atomic_store(&lb->stop, 1);
+        pthread_join(lb->thread, NULL);
+        lb->running = 0;
+    }
+    for (i = 0; i < n && i < LB_WRITERS; i++)
+        free(atomic_exchange(&lb->writer[i], NULL));
+}
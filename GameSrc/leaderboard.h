@@ -0,0 +1,154 @@
+/*!
+ * \file leaderboard.h
+ *
+ * \brief Top players of many concurrent matches, without locks.
+ *
+ * The board keeps the best result of the top K players, ranked by score,
+ * then by the game level reached, then by the longest rally. Results come
+ * from any number of threads, each through a writer of its own: a single
+ * producer, single consumer ring that the merge step drains into the
+ * board. The merge step is run by a background thread (lb_start), or
+ * called directly by a single threaded program (lb_merge).
+ *
+ * Once the board is full, a result ranking below the last player can't
+ * enter it, so the writer drops it right away against the threshold the
+ * merge step publishes: the rings only carry the few results that might
+ * matter, and the merge step handles them in O(K) each.
+ *
+ * Readers get a copy of the board in a bounded number of steps whatever
+ * the writers and the merge step are doing (lb_read). The merge step
+ * writes every new board into a spare slot and swaps it in; a reader
+ * takes the current slot and counts itself in with a single atomic add,
+ * and a slot is only reused once all the readers counted in are done.
+ */
+
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define LB_MAX_K 64 /*!< max players on a board */
+#define LB_RING 4096 /*!< results queued per writer, a power of 2 */
+#define LB_WRITERS 64 /*!< max writers of a board */
+#define LB_SLOTS 4 /*!< boards published, current and spares */
+#define LB_IDLE_US 1000 /*!< pause of the merge thread with nothing queued */
+
+/*!
+ * Result of a match
+ */
+typedef struct {
+    unsigned player; /*!< player id */
+    int score; /*!< points scored, 0 to INT_MAX */
+    int level; /*!< game level reached, 0 to 255 */
+    int rally; /*!< longest rally, saturated to 2^24 - 1 */
+} lb_result;
+
+/*!
+ * Copy of the board
+ */
+typedef struct {
+    unsigned long long version; /*!< boards published before this one */
+    long long merged; /*!< results merged so far */
+    int count; /*!< players on the board */
+    lb_result top[LB_MAX_K]; /*!< best result of each player, best first */
+} lb_board;
+
+/*!
+ * Writer of a board, owned by one thread
+ */
+typedef struct {
+    _Alignas(64) atomic_ulong head; /*!< results queued, by the writer */
+    unsigned long tail_seen; /*!< last tail read by the writer */
+    long long filtered; /*!< results below the board, by the writer */
+    long long full; /*!< results refused on a full ring, by the writer */
+    _Alignas(64) atomic_ulong tail; /*!< results merged, by the merge step */
+    lb_result ring[LB_RING]; /*!< queued results */
+} lb_writer;
+
+/*!
+ * Leaderboard
+ */
+typedef struct {
+    int k; /*!< players kept */
+    _Alignas(64) atomic_ullong floor; /*!< key to beat once full, else 0 */
+    atomic_int writers; /*!< writers opened */
+    _Atomic(lb_writer *) writer[LB_WRITERS]; /*!< writers, NULL until set */
+    lb_board work; /*!< board being merged, by the merge step */
+    int dirty; /*!< work changed since the last publication */
+    _Alignas(64) atomic_ullong current; /*!< slot << 56 | readers in */
+    atomic_ullong released[LB_SLOTS]; /*!< readers done with each slot */
+    unsigned long long acquired[LB_SLOTS]; /*!< readers in, retired slots */
+    lb_board slot[LB_SLOTS]; /*!< published boards */
+    pthread_t thread; /*!< merge thread */
+    int running; /*!< the merge thread was started */
+    atomic_int stop; /*!< asks the merge thread to end */
+} leaderboard;
+
+/*!
+ * \brief Initialize an empty board.
+ *
+ * @param lb board
+ * @param k players kept, 1 to LB_MAX_K
+ * @return 0, -1 if k is out of range
+ */
+int lb_init(leaderboard *lb, int k);
+
+/*!
+ * \brief Open a writer for the calling thread.
+ *
+ * The writer is owned by the board and lives until lb_destroy.
+ *
+ * @param lb board
+ * @return the writer, NULL if LB_WRITERS are open or out of memory
+ */
+lb_writer *lb_writer_open(leaderboard *lb);
+
+/*!
+ * \brief Queue a result, never waiting.
+ *
+ * Only the thread owning the writer may call it.
+ *
+ * @param lb board
+ * @param w writer of the calling thread
+ * @param r result
+ * @return 0 if queued or below the board, -1 if the ring is full
+ */
+int lb_insert(leaderboard *lb, lb_writer *w, const lb_result *r);
+
+/*!
+ * \brief Merge the queued results and publish the board if it changed.
+ *
+ * Only one thread at a time may call it: the merge thread once started.
+ *
+ * @param lb board
+ * @return results merged
+ */
+int lb_merge(leaderboard *lb);
+
+/*!
+ * \brief Start the merge thread.
+ *
+ * @param lb board
+ * @return 0, -1 if the thread can't be created
+ */
+int lb_start(leaderboard *lb);
+
+/*!
+ * \brief Copy the last published board, wait-free.
+ *
+ * @param lb board
+ * @param out copy of the board
+ */
+void lb_read(leaderboard *lb, lb_board *out);
+
+/*!
+ * \brief Stop the merge thread after a last merge and free the writers.
+ *
+ * No writer may be in use any more.
+ *
+ * @param lb board
+ */
+void lb_destroy(leaderboard *lb);
+
+#endif
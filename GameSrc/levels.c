@@ -0,0 +1,75 @@
+/*!
+ * \file levels.c
+ *
+ * \brief This file implements the level table support declared in
+ * levels.h.
+ *
+ */
+
+#include <stdio.h>
+#include "levels.h"
+
+/*!
+ */
+void levels_default(ai_level *levels)
+{
+    const ai_level chase = AI_LEVEL_CHASE;
+    int i;
+
+    for (i = 0; i <= MAX_LEVEL; ++i)
+        levels[i] = chase;
+}
+
+/*!
+ * Parameters are validated: a reaction or speed below one would freeze the
+ * ai, a negative error makes no sense.
+ */
+int levels_load(const char *path, ai_level *levels)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    int err = 0;
+
+    if (f == NULL)
+        return -1;
+
+    levels_default(levels);
+    while (!err && fgets(line, sizeof line, f))
+    {
+        ai_level p;
+        int level;
+        char c;
+
+        if (sscanf(line, " %c", &c) != 1 || c == '#')
+            continue;
+
+        if (sscanf(line, "%d %d %d %d",
+                    &level, &p.reaction, &p.error, &p.speed) != 4
+                || level < 0 || level > MAX_LEVEL
+                || p.reaction < 1 || p.error < 0 || p.speed < 1)
+            err = -1;
+        else
+            levels[level] = p;
+    }
+
+    fclose(f);
+    return err;
+}
+
+/*!
+ */
+int levels_save(const char *path, const ai_level *levels)
+{
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if (f == NULL)
+        return -1;
+
+    fprintf(f, "# level reaction error speed\n");
+    for (i = 0; i <= MAX_LEVEL; ++i)
+        fprintf(f, "%d %d %d %d\n",
+                i, levels[i].reaction, levels[i].error, levels[i].speed);
+
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,48 @@
+/*!
+ * \file levels.h
+ *
+ * \brief Level table of the tuned ai.
+ *
+ * The table holds the ai_level parameters for the game levels 0 to
+ * MAX_LEVEL, in a text file with one line per level:
+ *
+ *     # level reaction error speed
+ *     0 3 2 1
+ *
+ * Empty lines and lines starting with '#' are ignored. Levels missing from
+ * the file keep the AI_LEVEL_CHASE parameters.
+ */
+
+#ifndef LEVELS_H
+#define LEVELS_H
+
+#include "rules.h"
+
+#define LEVELS_FILE "levels.tbl" /*!< level table loaded by default */
+
+/*!
+ * \brief Fill a level table with the AI_LEVEL_CHASE parameters.
+ *
+ * @param levels MAX_LEVEL + 1 parameters
+ */
+void levels_default(ai_level *levels);
+
+/*!
+ * \brief Load a level table.
+ *
+ * @param path level table file
+ * @param levels MAX_LEVEL + 1 parameters to fill
+ * @return 0 on success, -1 if the file can't be read or is malformed
+ */
+int levels_load(const char *path, ai_level *levels);
+
+/*!
+ * \brief Save a level table.
+ *
+ * @param path level table file
+ * @param levels MAX_LEVEL + 1 parameters
+ * @return 0 on success, -1 on write error
+ */
+int levels_save(const char *path, const ai_level *levels);
+
+#endif
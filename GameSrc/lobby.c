@@ -0,0 +1,73 @@
+/*!
+ * \file lobby.c
+ *
+ * \brief This file implements the socket mode declared in lobby.h.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "lobby.h"
+
+/*!
+ * The games that ended are reaped by the kernel, SIGCHLD being ignored,
+ * so no zombie is left however long the lobby waits for a player. A failed
+ * accept, short of file descriptors or of memory, only pauses the lobby:
+ * the games in progress free them as they end.
+ */
+int lobby_serve(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+    int listen_fd, fd;
+    pid_t pid;
+
+    if (strlen(path) >= sizeof addr.sun_path)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0
+            || bind(listen_fd, (struct sockaddr *) &addr, sizeof addr) != 0
+            || listen(listen_fd, LOBBY_BACKLOG) != 0)
+        return -1;
+    signal(SIGCHLD, SIG_IGN);
+
+    while (1)
+    {
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno != EINTR && errno != ECONNABORTED)
+            {
+                perror("cannot accept a player");
+                usleep(LOBBY_RETRY_MS * 1000);
+            }
+            continue;
+        }
+
+        pid = fork();
+        if (pid == 0)
+        {
+            /* the game of this player, whose popen needs its children */
+            close(listen_fd);
+            dup2(fd, STDIN_FILENO);
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGPIPE, SIG_IGN);
+            return 0;
+        }
+        if (pid < 0)
+            perror("cannot start a game");
+        close(fd);
+    }
+}
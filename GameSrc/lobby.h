@@ -0,0 +1,36 @@
+/*!
+ * \file lobby.h
+ *
+ * \brief Players connecting over a Unix socket instead of the tty.
+ *
+ * In socket mode the game listens on a Unix socket and runs a game in
+ * wire mode (wire.h) for every player that connects: the process forks
+ * after each accept, and the child takes the connection as its standard
+ * input and output, where a game in wire mode reads the keys and writes
+ * the frames. A player is any client speaking the wire protocol, like
+ * tools/pong_client.c or the synthetic players of tools/pong_load.c.
+ *
+ * The parent only accepts and reaps its games, so a single socket serves
+ * as many players as the host can run, each in its own process.
+ */
+
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#define LOBBY_BACKLOG 4096 /*!< connections waiting to be accepted */
+#define LOBBY_RETRY_MS 100 /*!< pause after a failed accept */
+
+/*!
+ * \brief Listen on the socket and fork a game for every player.
+ *
+ * Returns only in a child, whose standard input and output are the
+ * connection of its player, with SIGPIPE ignored so that a player gone
+ * shows up as the end of the input. The parent serves until it is killed,
+ * pausing LOBBY_RETRY_MS when a connection can't be accepted.
+ *
+ * @param path Unix socket path, replaced if it exists
+ * @return -1 with errno set if the socket can't be set up, 0 in a child
+ */
+int lobby_serve(const char *path);
+
+#endif
@@ -0,0 +1,245 @@
+/*!
+ * \file mlp.c
+ *
+ * \brief This file implements the network controller declared in mlp.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mlp.h"
+
+/*! native vector of floats */
+typedef float mlp_vec __attribute__((vector_size(MLP_VEC * sizeof (float))));
+/*! mask vector matching mlp_vec */
+typedef int mlp_mask __attribute__((vector_size(MLP_VEC * sizeof (int))));
+
+#define MLP_CHUNKS (MLP_HIDDEN / MLP_VEC) /*!< vectors per hidden layer */
+
+/*!
+ * Network weights, packed by input: w1[i] holds the weights of input i
+ * toward all the hidden units, so the hidden layer is computed as
+ * MLP_INPUTS * MLP_CHUNKS vector multiply-adds. The whole structure fits
+ * in a few cache lines.
+ */
+typedef struct {
+    mlp_vec w1[MLP_INPUTS][MLP_CHUNKS]; /*!< hidden weights, by input */
+    mlp_vec b1[MLP_CHUNKS]; /*!< hidden biases */
+    mlp_vec w2[MLP_OUTPUTS][MLP_CHUNKS]; /*!< output weights, by output */
+    float b2[MLP_OUTPUTS]; /*!< output biases */
+} mlp_weights;
+
+/*! weight from input i to hidden unit j */
+#define W1(w, i, j) ((w)->w1[i][(j) / MLP_VEC][(j) % MLP_VEC])
+/*! bias of hidden unit j */
+#define B1(w, j) ((w)->b1[(j) / MLP_VEC][(j) % MLP_VEC])
+/*! weight from hidden unit j to output k */
+#define W2(w, k, j) ((w)->w2[k][(j) / MLP_VEC][(j) % MLP_VEC])
+
+/*!
+ * Return a vector with ReLU applied to each element.
+ */
+static inline mlp_vec relu(mlp_vec v)
+{
+    return (mlp_vec) ((mlp_mask) v & (v > (mlp_vec) {0}));
+}
+
+/*!
+ * Return the index of the best score; ties keep the paddle still.
+ */
+static inline int best_move(const float *o)
+{
+    int best = 1;
+
+    if (o[0] > o[best])
+        best = 0;
+    if (o[2] > o[best])
+        best = 2;
+    return best - 1;
+}
+
+/*!
+ * Features are scaled to the field size so that the same weights play on
+ * any terminal.
+ */
+void mlp_features(const ctl_view *view, float *in)
+{
+    float width = MAX(view->width, 1);
+    float rows = MAX(view->bottom_row, 1);
+
+    in[0] = view->ball_x / width;
+    in[1] = view->ball_y / rows;
+    in[2] = view->ball_dirx;
+    in[3] = view->ball_diry;
+    in[4] = view->own_pos / rows;
+    in[5] = view->opp_pos / rows;
+    in[6] = (view->ball_y - view->own_pos) / rows;
+    in[7] = (float) view->level / MAX_LEVEL;
+}
+
+/*!
+ * Evaluate the network for one view, vectorized over the hidden units.
+ */
+static int mlp_decide(const mlp_weights *w, const ctl_view *view)
+{
+    float in[MLP_INPUTS];
+    float o[MLP_OUTPUTS];
+    mlp_vec h[MLP_CHUNKS];
+    int i, c, k;
+
+    mlp_features(view, in);
+    for (c = 0; c < MLP_CHUNKS; ++c)
+    {
+        h[c] = w->b1[c];
+        for (i = 0; i < MLP_INPUTS; ++i)
+            h[c] += w->w1[i][c] * in[i];
+        h[c] = relu(h[c]);
+    }
+
+    for (k = 0; k < MLP_OUTPUTS; ++k)
+    {
+        mlp_vec acc = w->w2[k][0] * h[0];
+
+        for (c = 1; c < MLP_CHUNKS; ++c)
+            acc += w->w2[k][c] * h[c];
+        o[k] = w->b2[k];
+        for (i = 0; i < MLP_VEC; ++i)
+            o[k] += acc[i];
+    }
+
+    return best_move(o);
+}
+
+/*!
+ * Evaluate the network for MLP_BATCH views, vectorized over the matches.
+ */
+static void mlp_decide_block(const mlp_weights *w, const ctl_view *view,
+        int *intent)
+{
+    mlp_vec x[MLP_INPUTS];
+    mlp_vec o[MLP_OUTPUTS];
+    mlp_mask up, down;
+    float in[MLP_INPUTS];
+    int i, j, k;
+
+    /* features, one lane per match */
+    for (j = 0; j < MLP_BATCH; ++j)
+    {
+        mlp_features(&view[j], in);
+        for (i = 0; i < MLP_INPUTS; ++i)
+            x[i][j] = in[i];
+    }
+
+    for (k = 0; k < MLP_OUTPUTS; ++k)
+        o[k] = (mlp_vec) {0} + w->b2[k];
+
+    for (j = 0; j < MLP_HIDDEN; ++j)
+    {
+        mlp_vec h = (mlp_vec) {0} + B1(w, j);
+
+        for (i = 0; i < MLP_INPUTS; ++i)
+            h += x[i] * W1(w, i, j);
+        h = relu(h);
+
+        for (k = 0; k < MLP_OUTPUTS; ++k)
+            o[k] += h * W2(w, k, j);
+    }
+
+    /* same choice as best_move: up or down must beat stay strictly */
+    up = o[0] > o[1];
+    down = o[2] > (mlp_vec) ((up & (mlp_mask) o[0]) | (~up & (mlp_mask) o[1]));
+    for (j = 0; j < MLP_BATCH; ++j)
+        intent[j] = down[j] ? 1 : (up[j] ? -1 : 0);
+}
+
+/*!
+ * Full blocks take the batched path, the remainder the single one.
+ */
+static void mlp_decide_batch(controller *c, const ctl_view *view, int n,
+        int *intent)
+{
+    const mlp_weights *w = c->ctx;
+    int i = 0;
+
+    for (; i + MLP_BATCH <= n; i += MLP_BATCH)
+        mlp_decide_block(w, &view[i], &intent[i]);
+    for (; i < n; ++i)
+        intent[i] = mlp_decide(w, &view[i]);
+}
+
+/*!
+ */
+static void mlp_destroy(controller *c)
+{
+    free(c->ctx);
+    free(c);
+}
+
+/*!
+ * Read n floats from the weights file.
+ */
+static int read_floats(FILE *f, float *v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+        if (fscanf(f, "%f", &v[i]) != 1)
+            return -1;
+    return 0;
+}
+
+/*!
+ * The file lists hidden weights by hidden unit; they are transposed while
+ * loading into the by-input packing of mlp_weights.
+ */
+controller *mlp_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    controller *c = malloc(sizeof *c);
+    mlp_weights *w = aligned_alloc(64, (sizeof *w + 63) / 64 * 64);
+    float row[MLP_HIDDEN];
+    int ni, nh, no;
+    int i, j, err = 0;
+
+    if (f == NULL || c == NULL || w == NULL)
+        goto fail;
+
+    memset(w, 0, sizeof *w);
+    if (fscanf(f, " pong-mlp %d %d %d", &ni, &nh, &no) != 3
+            || ni != MLP_INPUTS || nh != MLP_HIDDEN || no != MLP_OUTPUTS)
+        goto fail;
+
+    for (j = 0; j < MLP_HIDDEN && !err; ++j)
+    {
+        err = read_floats(f, row, MLP_INPUTS);
+        for (i = 0; i < MLP_INPUTS; ++i)
+            W1(w, i, j) = row[i];
+    }
+    err = err || read_floats(f, row, MLP_HIDDEN);
+    for (j = 0; j < MLP_HIDDEN; ++j)
+        B1(w, j) = row[j];
+    for (i = 0; i < MLP_OUTPUTS && !err; ++i)
+    {
+        err = read_floats(f, row, MLP_HIDDEN);
+        for (j = 0; j < MLP_HIDDEN; ++j)
+            W2(w, i, j) = row[j];
+    }
+    err = err || read_floats(f, w->b2, MLP_OUTPUTS);
+    if (err)
+        goto fail;
+
+    fclose(f);
+    c->name = "mlp";
+    c->decide_batch = mlp_decide_batch;
+    c->destroy = mlp_destroy;
+    c->ctx = w;
+    return c;
+
+fail:
+    if (f)
+        fclose(f);
+    free(c);
+    free(w);
+    return NULL;
+}
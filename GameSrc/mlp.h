@@ -0,0 +1,55 @@
+/*!
+ * \file mlp.h
+ *
+ * \brief Learned paddle controller: a small fixed-size multilayer
+ * perceptron.
+ *
+ * The network maps MLP_INPUTS features of a ctl_view through MLP_HIDDEN
+ * ReLU units to MLP_OUTPUTS scores (up, stay, down); the intent is the
+ * best scoring move. Weights are read from a text file:
+ *
+ *     pong-mlp 8 16 3
+ *     <MLP_HIDDEN rows of MLP_INPUTS hidden weights>
+ *     <MLP_HIDDEN hidden biases>
+ *     <MLP_OUTPUTS rows of MLP_HIDDEN output weights>
+ *     <MLP_OUTPUTS output biases>
+ *
+ * and packed in memory so that a single decision is a handful of native
+ * vector multiply-adds over the hidden units, while the batched path
+ * evaluates MLP_BATCH matches per vector.
+ */
+
+#ifndef MLP_H
+#define MLP_H
+
+#include "controller.h"
+
+#define MLP_INPUTS 8 /*!< features of a view */
+#define MLP_HIDDEN 16 /*!< hidden units */
+#define MLP_OUTPUTS 3 /*!< scores for up, stay and down */
+#if defined(__AVX512F__)
+#define MLP_VEC 16 /*!< floats per native vector */
+#elif defined(__AVX__)
+#define MLP_VEC 8 /*!< floats per native vector */
+#else
+#define MLP_VEC 4 /*!< floats per native vector (SSE, NEON) */
+#endif
+#define MLP_BATCH MLP_VEC /*!< matches per vector in the batched path */
+
+/*!
+ * \brief Compute the network input features of a view.
+ *
+ * @param view match view
+ * @param in MLP_INPUTS features
+ */
+void mlp_features(const ctl_view *view, float *in);
+
+/*!
+ * \brief Load a network controller from a weights file.
+ *
+ * @param path weights file
+ * @return the controller, NULL if the file can't be read or is malformed
+ */
+controller *mlp_load(const char *path);
+
+#endif
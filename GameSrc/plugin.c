@@ -0,0 +1,111 @@
+/*!
+ * \file plugin.c
+ *
+ * \brief This file implements the plugin loader declared in plugin.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <dlfcn.h>
+#include "plugin.h"
+#include "pong_plugin.h"
+
+/* views are handed to plugins as they are */
+_Static_assert(sizeof (ctl_view) == sizeof (pong_state), "view layout");
+_Static_assert(offsetof(ctl_view, level) == offsetof(pong_state, level),
+        "view layout");
+_Static_assert(sizeof (int) == sizeof (pong_intent), "intent layout");
+
+/*!
+ * Loaded plugin
+ */
+typedef struct {
+    void *handle; /*!< dlopen handle */
+    /*! plugin decision entry point */
+    void (*decide)(const pong_state *s, int n, pong_intent *out);
+    void (*fini)(void); /*!< plugin cleanup, may be NULL */
+} plugin;
+
+/*!
+ */
+static void plugin_decide_batch(controller *c, const ctl_view *view, int n,
+        int *intent)
+{
+    const plugin *p = c->ctx;
+
+    p->decide((const pong_state *) view, n, (pong_intent *) intent);
+}
+
+/*!
+ */
+static void plugin_destroy(controller *c)
+{
+    plugin *p = c->ctx;
+
+    if (p->fini)
+        p->fini();
+    dlclose(p->handle);
+    free(p);
+    free(c);
+}
+
+/*!
+ */
+controller *plugin_load(const char *path)
+{
+    controller *c = malloc(sizeof *c);
+    plugin *p = malloc(sizeof *p);
+    const int *abi;
+    const char *name;
+    int (*init)(void);
+
+    if (c == NULL || p == NULL)
+    {
+        perror("allocation error");
+        goto fail;
+    }
+
+    p->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (p->handle == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        goto fail;
+    }
+
+    abi = dlsym(p->handle, "pong_plugin_abi");
+    name = dlsym(p->handle, "pong_plugin_name");
+    *(void **) &p->decide = dlsym(p->handle, "pong_decide_batch");
+    *(void **) &init = dlsym(p->handle, "pong_plugin_init");
+    *(void **) &p->fini = dlsym(p->handle, "pong_plugin_fini");
+    if (abi == NULL || name == NULL || p->decide == NULL)
+    {
+        fprintf(stderr, "%s: not a pong plugin\n", path);
+        goto fail_close;
+    }
+    if (*abi != PONG_PLUGIN_ABI)
+    {
+        fprintf(stderr, "%s: plugin ABI %d, expected %d\n",
+                path, *abi, PONG_PLUGIN_ABI);
+        goto fail_close;
+    }
+    if (init && init() != 0)
+    {
+        fprintf(stderr, "%s: plugin initialization failed\n", path);
+        goto fail_close;
+    }
+
+    c->name = name;
+    c->decide_batch = plugin_decide_batch;
+    c->destroy = plugin_destroy;
+    c->ctx = p;
+    return c;
+
+fail_close:
+    dlclose(p->handle);
+fail:
+    free(p);
+    free(c);
+    return NULL;
+}
@@ -0,0 +1,25 @@
+/*!
+ * \file plugin.h
+ *
+ * \brief Paddle controllers loaded from plugins (pong_plugin.h).
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "controller.h"
+
+/*!
+ * \brief Load a controller plugin.
+ *
+ * The plugin decide_batch is called directly with the views: ctl_view has
+ * the layout of pong_state, so a batch costs one indirect call and no
+ * copy.
+ *
+ * @param path shared object path, as for dlopen
+ * @return the controller, NULL if the plugin can't be loaded or has
+ * another ABI version (the reason is printed on stderr)
+ */
+controller *plugin_load(const char *path);
+
+#endif
@@ -0,0 +1,28 @@
+/*!
+ * \file chase_plugin.c
+ *
+ * \brief The chase controller as a plugin (pong_plugin.h), to compare the
+ * plugin path with the built-in one.
+ *
+ * Build: gcc -O2 -shared -fPIC -I.. chase_plugin.c -o chase.so
+ */
+
+#include "pong_plugin.h"
+
+const int pong_plugin_abi = PONG_PLUGIN_ABI;
+const char pong_plugin_name[] = "chase-plugin";
+
+/*!
+ * Move one row toward the ball row.
+ */
+void pong_decide_batch(const pong_state *s, int n, pong_intent *out)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+    {
+        int diff = s[i].ball_y - s[i].own_pos;
+
+        out[i] = (diff > 0) - (diff < 0);
+    }
+}
@@ -0,0 +1,115 @@
+/*!
+ * \file pointer.c
+ *
+ * \brief This file implements the pointer predictor declared in pointer.h.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "pointer.h"
+
+#define POINTER_IDLE 100000 /*!< us without reports for a pointer at rest */
+
+/*!
+ * Clamp a row to the rows the paddle reached in the last frame.
+ */
+static int clamp(const pointer *p, int y)
+{
+    if (y < p->top)
+        return p->top;
+    if (y > p->bottom)
+        return p->bottom;
+    return y;
+}
+
+/*!
+ */
+void pointer_init(pointer *p, long long lead)
+{
+    p->lead = lead;
+    p->active = 0;
+    p->speed = 0;
+    p->gap = 0;
+    p->top = 0;
+    p->bottom = 0;
+    p->reports = 0;
+    p->error = 0;
+    p->error_raw = 0;
+}
+
+/*!
+ * The velocity is the mean of the last two report intervals, weighted
+ * toward the newest: reports come at every row the pointer crosses, so a
+ * single interval is too noisy. Reports read in the same pass carry the
+ * same time and only the last one counts.
+ */
+void pointer_report(pointer *p, int y, long long now)
+{
+    long long dt = now - p->at;
+
+    if (!p->active)
+    {
+        p->active = 1;
+        p->speed = 0;
+        p->gap = 0;
+        p->y = y;
+        p->at = now;
+        p->shown = y;
+        return;
+    }
+
+    /* pointer against the paddle on screen, predicted or not */
+    p->reports++;
+    p->error += abs(clamp(p, y) - p->shown);
+    p->error_raw += abs(clamp(p, y) - clamp(p, p->y));
+
+    if (dt >= POINTER_IDLE)
+    {
+        /* moving again after a rest */
+        p->speed = 0;
+        p->gap = 0;
+    } else if (dt > 0)
+    {
+        p->speed = 0.5 * p->speed + 0.5 * (y - p->y) / dt;
+        p->gap = p->gap > 0 ? 0.75 * p->gap + 0.25 * dt : dt;
+    }
+    p->y = y;
+    p->at = now;
+}
+
+/*!
+ */
+void pointer_release(pointer *p)
+{
+    p->active = 0;
+}
+
+/*!
+ * Past two report intervals without a report the pointer is taken at
+ * rest on the last reported row.
+ */
+int pointer_predict(pointer *p, long long now, int top, int bottom)
+{
+    long long since = now - p->at;
+    int y = p->y;
+
+    p->top = top;
+    p->bottom = bottom;
+    if (p->lead > 0 && p->gap > 0 && since <= 2 * p->gap)
+        y += (int) lround(p->speed * (since + p->lead));
+    p->shown = clamp(p, y);
+    return p->shown;
+}
+
+/*!
+ */
+void pointer_stats(const pointer *p, FILE *out)
+{
+    if (p->reports == 0)
+        return;
+    fprintf(out, "pointer: %ld reports, paddle %.2f rows off the pointer, "
+            "%.2f on the last report (lead %.1f ms)\n", p->reports,
+            (double) p->error / p->reports,
+            (double) p->error_raw / p->reports, p->lead / 1e3);
+}
@@ -0,0 +1,88 @@
+/*!
+ * \file pointer.h
+ *
+ * \brief Motion predictor of the mouse pointer driving the player paddle.
+ *
+ * Mouse reports reach the game a frame or more after the pointer moved,
+ * through the terminal and the pty, so a paddle placed on the last report
+ * trails the pointer. The predictor keeps a smoothed pointer velocity and
+ * extrapolates the last report to the time the next frame shows up, plus
+ * a tunable lead. The extrapolation stops when reports stop coming (the
+ * pointer stopped) and is clamped to the rows the paddle can reach.
+ *
+ * The predictor also measures itself: at every report the row the pointer
+ * reached is compared with the paddle on screen, and with the paddle a
+ * plain copy of the last report would have shown.
+ */
+
+#ifndef POINTER_H
+#define POINTER_H
+
+#include <stdio.h>
+
+#define POINTER_LEAD 20000 /*!< default lead in us, about a frame */
+
+/*!
+ * Pointer predictor
+ */
+typedef struct {
+    long long lead; /*!< extrapolation ahead of the frame in us, 0 for none */
+    int active; /*!< the pointer drives the paddle */
+    int y; /*!< row of the last report */
+    long long at; /*!< sched_now() time of the last report */
+    double speed; /*!< smoothed velocity in rows per us */
+    double gap; /*!< smoothed time between reports in us */
+    int shown; /*!< paddle row on screen */
+    int top; /*!< first row the paddle could reach in the last frame */
+    int bottom; /*!< last row the paddle could reach in the last frame */
+    long reports; /*!< reports measured */
+    long long error; /*!< sum of the rows between pointer and paddle */
+    long long error_raw; /*!< idem, for the paddle on the last report */
+} pointer;
+
+/*!
+ * \brief Initialize a predictor.
+ *
+ * @param p predictor
+ * @param lead extrapolation ahead of the frame in us, 0 to place the
+ * paddle on the last report
+ */
+void pointer_init(pointer *p, long long lead);
+
+/*!
+ * \brief Feed a pointer report.
+ *
+ * @param p predictor
+ * @param y pointer row
+ * @param now sched_now() time of the report
+ */
+void pointer_report(pointer *p, int y, long long now);
+
+/*!
+ * \brief Stop driving the paddle until the next report, as when the
+ * keyboard takes over.
+ *
+ * @param p predictor
+ */
+void pointer_release(pointer *p);
+
+/*!
+ * \brief Return the paddle row for a frame.
+ *
+ * @param p predictor
+ * @param now sched_now() time of the frame
+ * @param top first row the paddle can reach
+ * @param bottom last row the paddle can reach
+ * @return predicted row, clamped to top and bottom
+ */
+int pointer_predict(pointer *p, long long now, int top, int bottom);
+
+/*!
+ * \brief Print the error measures.
+ *
+ * @param p predictor
+ * @param out output stream
+ */
+void pointer_stats(const pointer *p, FILE *out);
+
+#endif
@@ -4,52 +4,519 @@
  *
  * This is a clone of the pong game, implemented in c with ncurses interface.
  *
- * The game main thread act as a controller, receiving data from three 
- * children threads: one for the keyboard input handling, one controlling the
- * ball position and one for the ai moves. Another thread is used as signal
- * listener, handling kill/int/term and terminal resize signals. Signals are 
- * blocked during program initialization and then managed with a signal file 
- * descriptor and a poll from the kernel. Thread comunication is provided 
- * with a pipe.
+ * The game runs as a set of stackless coroutines on a single thread (see
+ * sched.h): a controller coroutine drives menus and screen updates, and 
+ * during a game three more coroutines handle the keyboard input, the ball 
+ * position and the ai moves. Another coroutine is used as signal listener,
+ * handling kill/int/term and terminal resize signals. Signals are blocked 
+ * during program initialization and then managed with a signal file 
+ * descriptor polled by the scheduler. Coroutines communicate through the 
+ * shared game_data structure: moved objects are flagged for redraw and the
+ * controller repaints them once per scheduler tick.
  *
- * Note that ncurses is not thread safe, so operations on the window
- * must be inside a critical zone secured with a mutex.
+ * Since everything runs on one thread, ncurses is never accessed 
+ * concurrently and no locking is needed.
  *
  * Note: the program uses a system call to change the keyboard settings for a
  * smooth playing, and previous settings are restored before game exit.
  * System keyboard settings are managed throug xset command, so the game
  * requires to run into a X session.
+ *
+ * Build: gcc pong.c support.c sched.c rules.c controller.c mlp.c \
+ *        levels.c plugin.c rt.c tick.c render.c termout.c gfx.c \
+ *        termcache.c pointer.c wire.c spectate.c lobby.c leaderboard.c \
+ *        scores.c -lncurses -ldl -lm -pthread
  * 
  */
 
 #include <ncurses.h>
 #include <sys/ioctl.h>
 #include <sys/signalfd.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
-#include <pthread.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include "support.h"
+#include "mlp.h"
+#include "levels.h"
+#include "plugin.h"
+#include "rt.h"
+#include "tick.h"
+#include "termcache.h"
+#include "lobby.h"
 
 /* global variables for keyboard delay and rate settings */
 char del[4];
 char rate[3];
+int term_fd = STDOUT_FILENO;
+frame_out *game_frame;
+
+#define BOARD_SIZE 10 /*!< players kept on the leaderboard */
+
+static score_store *open_scores; /*!< store closed at exit, if open */
+
+/*!
+ * \brief Close the high-score store at exit.
+ *
+ * Registered with atexit, so that the games queued are written when the
+ * game quits through termination_handler too. main closes the store
+ * itself and clears open_scores before returning.
+ */
+static void close_scores(void)
+{
+    if (open_scores)
+        score_close(open_scores);
+}
 
-int main(void)
+/*!
+ * \brief Wait for a key from the menu.
+ *
+ * Return the first pending key, ERR if none is available yet. Pressing
+ * QUIT_KEY, or the end of the input, terminates the program.
+ */
+static int menu_key(void)
+{
+    int c = getch();
+
+    if (c == QUIT_KEY || (c == ERR && input_closed()))
+        /* safe because no game is running */
+        termination_handler(); 
+    return c;
+}
+
+/*!
+ * \brief Enter the game just ended on the leaderboard.
+ *
+ * The game is the only writer of its board and runs no merge thread, so
+ * the result is merged right away.
+ */
+static void record_game(game_data *data)
 {
-    char buf[TAG_SIZE + 1]; /* buffer to take tags from the pipe in*/
-    pthread_t keyboard_handler_thread; /* thread for keyboard handling */
-    pthread_t mouse_handler_thread; /* thread for mouse handling */
-    pthread_t ball_handler_thread; /* thread for ball position generation */
-    pthread_t ai_handler_thread; /* thread for ai position handling */
-    pthread_t signal_thread; /* thread for signal listening */
-    FILE *sett[2]; /* pipes to read xorg key settings */
-    game_data data; /* game data shared between threads */
+    lb_result r;
+
+    r.player = getuid();
+    r.score = data->hits;
+    r.level = data->match.gameLevel;
+    r.rally = data->rally;
+    if (data->board_in && lb_insert(&data->board, data->board_in, &r) == 0)
+        lb_merge(&data->board);
+    if (data->scores.fd >= 0)
+        score_add(&data->scores, &r, !data->winner);
+}
+
+/*!
+ * \brief Coroutine acting as game controller.
+ *
+ * Each iteration of the outer loop is a single game: the controller waits
+ * for the start key, spawns the game coroutines and then redraws the
+ * objects they move once per tick, until the game ends.
+ */
+static int game_controller(coroutine *co)
+{
+    game_data *data = (game_data*) co->arg;
+
+    CO_BEGIN(co);
+
+    print_intro_menu(stdscr);
+    send_menu(data, WIRE_MENU_INTRO, 0);
+
+    /* each iteration is a single game */
+    do {
+        /* wait until the user press space (game start) or q (quit) */
+        while (!data->autoplay)
+        {
+            CO_AWAIT_INPUT(co, STDIN_FILENO);
+            if (menu_key() == ' ')
+                break;
+        }
+
+        data->haltFlag = 0;
+        /* play status on */
+        data->play_flag = 1;
+        data->redraw = 0;
+
+        /* place paddles and ball for the serve */
+        match_serve(
+                &data->match,
+                getmaxy(stdscr),
+                getmaxx(stdscr),
+                (rand() % 2 == 0 ? 1 : -1));
+        data->match.rng = rand() | 1; /* xorshift state must be non-zero */
+        data->hits = data->rally = 0;
+        pointer_release(&data->pointer); /* until the mouse moves */
+
+        /* static court in place of the menu */
+        show_court(data);
+
+        data->ball_x_old = data->match.ball_x;
+        data->ball_y_old = data->match.ball_y;
+        draw_paddle(data, KBD_TAG);
+        draw_paddle(data, AI_TAG);
+        draw_ball(data);
+
+        /* don't mask any mouse events */
+        mousemask(ALL_MOUSE_EVENTS | REPORT_MOUSE_POSITION, NULL);
+        /* makes the terminal report mouse movement events */
+        if (!data->autoplay && data->wire.fd < 0)
+            printf("\033[?1003h\n");
+
+        /* create coroutines for keyboard (or autoplayer), ai and ball */
+        data->kbd_co = sched_spawn(co->sched,
+                data->autoplay ? autoplayer : keyboard_handler, data);
+        data->ai_co = sched_spawn(co->sched, ai_handler, data);
+        data->ball_co = sched_spawn(co->sched, ball_handler, data);
+
+        /* manage screen update */
+        while (!data->exit_flag && data->play_flag)
+        {
+            CO_AWAIT_TICK(co);
+
+            /* the predicted pointer moves between the mouse reports */
+            follow_pointer(data);
+            if (data->redraw & REDRAW_KBD) /* player paddle moved */
+            {
+                delete_paddle(data, KBD_TAG);
+                draw_paddle(data, KBD_TAG);
+                /* the ai controllers see it: their plan is stale */
+                if (!data->levels && data->ai != ctl_chase()
+                        && data->match.paddle_pos != data->paddle_pos_old)
+                {
+                    data->ai_stale = 1;
+                    sched_wake(data->ai_co);
+                }
+            }
+            if (data->redraw & REDRAW_AI) /* ai paddle moved */
+            {
+                delete_paddle(data, AI_TAG);
+                draw_paddle(data, AI_TAG);
+            }
+            if (data->redraw & REDRAW_BALL) /* ball moved */
+            {
+                delete_ball(data);
+                draw_ball(data);
+            }
+            if (data->redraw)
+            {
+                frame_flush(&data->frame, stdscr, term_fd);
+                send_objects(data);
+            }
+            data->redraw = 0;
+        }
+
+        /* terminate the game coroutines (the ball one may have 
+         * terminated itself yet) */
+        sched_cancel(data->kbd_co);
+        sched_cancel(data->ai_co);
+        if (data->exit_flag)
+            sched_cancel(data->ball_co);
+
+        /* sprites don't belong on the menus */
+        frame_hide(&data->frame, term_fd);
+
+        /* disable mouse movement events, as l = low */
+        if (!data->autoplay && data->wire.fd < 0)
+            printf("\033[?1003l\n");
+
+        /* print endgame message in superimpression */
+        if (!data->exit_flag)
+        {
+            print_intra_menu(
+                    stdscr,
+                    (data->winner ? "GAME LOST" : "GAME WON"));
+            send_menu(data, data->winner ? WIRE_MENU_LOST : WIRE_MENU_WON,
+                    0);
+            if (data->winner)
+                data->lost++;
+            else
+                data->won++;
+            record_game(data);
+        }
+
+        /* autoplay ends after the requested games */
+        if (data->autoplay && --data->autoplay == 0)
+            data->exit_flag = 1;
+
+    } while (!data->exit_flag);
+
+    sched_stop(co->sched);
+
+    CO_END(co);
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-l levels] [-m weights] [-p plugin] [-s] [-P]\n"
+            "          [-R fifo|deadline] [-c cores] [-a games] [-t tick]\n"
+            "          [-L lead] [-W colsxrows] [-v path] [-S path] [-H file]\n"
+            "  -l levels   tuned ai level table (default " LEVELS_FILE
+            " if present)\n"
+            "  -m weights  ai driven by the network in the weights file\n"
+            "  -p plugin   ai driven by a controller plugin (pong_plugin.h)\n"
+            "  -s          print wakeups, cpu usage, timer lateness and output\n"
+            "              bytes on exit\n"
+            "  -P          probe the terminal again instead of using the\n"
+            "              cached features\n"
+            "  -R policy   real-time scheduling (fifo or deadline), see rt.h\n"
+            "  -c cores    pin the game to the given cores, as 0,2-3\n"
+            "  -a games    autoplay the games on a null terminal in virtual\n"
+            "              time, then print the results\n"
+            "  -t tick     lock the game clock to a frame tick: /dev/uioN[:hz]\n"
+            "              for the fpga vsync interrupt, or a rate in hz\n"
+            "  -L lead     ms the mouse pointer is extrapolated ahead of\n"
+            "              the frames, 0 to follow the last report (default\n"
+            "              %d)\n"
+            "  -W size     wire mode: send frame deltas on stdout to a thin\n"
+            "              client (tools/pong_client.c) with a colsxrows\n"
+            "              court, and read its keys on stdin\n"
+            "  -v path     let spectators watch the game on a Unix socket,\n"
+            "              with the stream of wire mode\n"
+            "  -S path     socket mode: listen on a Unix socket and play a\n"
+            "              game in wire mode with every client connecting\n"
+            "              (80x24 unless -W is given)\n"
+            "  -H file     high-score store (default ~/.local/share/"
+            SCORE_FILE "),\n"
+            "              kept in autoplay only if given\n",
+            prog, POINTER_LEAD / 1000);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *sett; /* pipe to read xorg key settings */
+    char line[256]; /* line of the xorg settings */
+    game_data data; /* game data shared between coroutines */
     sigset_t sigset; /* signal set */
+    const char *levels_path = NULL; /* level table given by the user */
+    int stats = 0; /* print power and timing statistics on exit */
+    int rt = RT_NONE; /* real-time scheduling policy */
+    const char *cpus = NULL; /* cores to pin the game to */
+    const char *tick_spec = NULL; /* frame tick source */
+    tick_source tick; /* frame tick, when tick_spec is given */
+    long long started; /* sched_now() time the game started */
+    struct timespec real_start, real_end; /* wall clock of an autoplay */
+    int autoplayed; /* games requested in autoplay */
+    int features; /* optional terminal features (TERM_*) */
+    int reprobe = 0; /* ignore the cached terminal features */
+    int lead = POINTER_LEAD; /* pointer extrapolation in us */
+    int wire_rows = 0, wire_cols = 0; /* court size of the thin client */
+    const char *spec_path = NULL; /* spectator socket */
+    const char *lobby_path = NULL; /* socket of the players */
+    const char *scores_path = NULL; /* high-score store given by the user */
+    FILE *results = stdout; /* output of the autoplay results */
+    int cached; /* features read from the cache */
+    int i;
+    int opt;
+
+    /* parse options, before touching the terminal */
+    data.ai = ctl_chase();
+    data.levels = NULL;
+    data.ai_co = NULL;
+    data.autoplay = 0;
+    data.won = data.lost = 0;
+    memset(&data.court, 0, sizeof data.court);
+    memset(&data.frame, 0, sizeof data.frame);
+    lb_init(&data.board, BOARD_SIZE);
+    data.board_in = lb_writer_open(&data.board);
+    while ((opt = getopt(argc, argv, "l:m:p:sPR:c:a:t:L:W:v:S:H:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'l':
+                /* tuned ai level table */
+                levels_path = optarg;
+                break;
+
+            case 's':
+                stats = 1;
+                break;
+
+            case 'P':
+                reprobe = 1;
+                break;
+
+            case 'R':
+                rt = rt_policy(optarg);
+                if (rt < 0)
+                {
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                stats = 1;
+                break;
+
+            case 'c':
+                cpus = optarg;
+                break;
+
+            case 't':
+                tick_spec = optarg;
+                break;
+
+            case 'W':
+                /* thin client court size */
+                if (sscanf(optarg, "%dx%d", &wire_cols, &wire_rows) != 2
+                        || wire_cols < 10 || wire_rows < 10)
+                {
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'v':
+                spec_path = optarg;
+                break;
+
+            case 'S':
+                lobby_path = optarg;
+                break;
+
+            case 'H':
+                scores_path = optarg;
+                break;
+
+            case 'L':
+                lead = atoi(optarg);
+                if (lead < 0)
+                {
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                lead *= 1000;
+                break;
+
+            case 'a':
+                data.autoplay = atoi(optarg);
+                if (data.autoplay < 1)
+                {
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'p':
+                /* plugin ai */
+                data.ai = plugin_load(optarg);
+                if (data.ai == NULL)
+                {
+                    fprintf(stderr, "cannot load plugin %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'm':
+                /* learned ai */
+                data.ai = mlp_load(optarg);
+                if (data.ai == NULL)
+                {
+                    fprintf(stderr, "cannot load weights from %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
 
-    srand(getpid());
+    /* in socket mode this is a game for a player that connected, in wire
+     * mode on the connection */
+    if (lobby_path && !data.autoplay)
+    {
+        if (lobby_serve(lobby_path) != 0)
+        {
+            perror(lobby_path);
+            exit(EXIT_FAILURE);
+        }
+        if (!wire_rows)
+        {
+            wire_rows = 24;
+            wire_cols = 80;
+        }
+    }
+
+    pointer_init(&data.pointer, lead);
+
+    /* in wire mode stdout carries the frame-delta stream */
+    wire_init(&data.wire, wire_rows ? STDOUT_FILENO : -1);
+    if (wire_rows)
+    {
+        results = stderr;
+        /* a client gone shows up as a failed write, not as a signal */
+        signal(SIGPIPE, SIG_IGN);
+    }
+    if (spec_path && spec_open(&data.spec, spec_path, &data.wire) != 0)
+    {
+        perror(spec_path);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the tuned built-in ai plays unless a controller was chosen; the 
+     * default table is optional */
+    if (data.ai == ctl_chase())
+    {
+        if (levels_load(
+                    levels_path ? levels_path : LEVELS_FILE,
+                    data.level_table) == 0)
+            data.levels = data.level_table;
+        else if (levels_path)
+        {
+            fprintf(stderr, "cannot load level table %s\n", levels_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* high scores of the past runs, before the real-time profile so that
+     * the store thread doesn't inherit it; autoplay keeps its games out of
+     * the default store */
+    data.scores.fd = -1;
+    if (!data.autoplay || scores_path)
+    {
+        if (score_open(&data.scores, scores_path) == 0)
+        {
+            for (i = 0; data.board_in && i < data.scores.table.count; i++)
+                lb_insert(&data.board, data.board_in,
+                        &data.scores.table.top[i]);
+            lb_merge(&data.board);
+            open_scores = &data.scores;
+            atexit(close_scores);
+        }
+        else if (scores_path && errno != EWOULDBLOCK)
+        {
+            perror(scores_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* real-time profile, falling back to default scheduling */
+    if (rt != RT_NONE || cpus)
+        rt_setup(rt, cpus);
+
+    /* autoplay is reproducible and runs in virtual time */
+    if (data.autoplay)
+    {
+        srand(1);
+        sched_virtual_clock();
+    } else
+        srand(getpid());
+
+    /* frame clock: timers advance by whole frames of the tick source */
+    if (tick_spec)
+    {
+        if (tick_open(&tick, tick_spec) != 0)
+        {
+            perror(tick_spec);
+            exit(EXIT_FAILURE);
+        }
+        sched_frame_clock(tick.fd, tick.period, tick_frames, &tick);
+    }
 
     /* create signal set containing resize and kill/int/term signals */
     sigemptyset(&sigset);
@@ -64,39 +531,55 @@ int main(void)
     /* create pipe for signal handling */
     data.signal_fd = signalfd(-1, &sigset, 0); 
 
-    /* read typematic settings (repeat delay and rate) from system 
-     * and save them into global variables */
-    sett[0] =  
-        popen("xset q | grep 'auto repeat delay:' |"
-                " egrep -o '([0-9])+' | sed -n '1p'", "r");
-    sett[1] =
-        popen("xset q | grep 'auto repeat delay:' |"
-                " egrep -o '([0-9])+' | sed -n '2p'", "r");
-    fgets(del, 4, sett[0]);
-    fgets(rate, 3, sett[1]);
+    if (!data.autoplay && !wire_rows)
+    {
+        /* read typematic settings (repeat delay and rate) from system 
+         * and save them into global variables, with a single xset run */
+        sett = popen("xset q", "r");
+        while (sett && fgets(line, sizeof line, sett))
+        {
+            char *p = strstr(line, "auto repeat delay:");
 
-    /* change key delay and rate (for smoother playing) */
-    system("xset r rate 100 30");
+            if (p && sscanf(p, "auto repeat delay: %3[0-9] repeat rate: "
+                        "%2[0-9]", del, rate) != 2)
+                del[0] = '\0';
+        }
+        if (sett)
+            pclose(sett);
+
+        /* change key delay and rate (for smoother playing) */
+        system("xset r rate 100 30");
+    }
 
     /* init game data */
     data.exit_flag = 0;
     data.play_flag = 0;
-    pthread_mutex_init(&data.mut, NULL);
-    if (pipe(data.pipedes) == -1)
+    sched_init(&data.sched);
+
+    /* ncurses init, on a null terminal in autoplay and in wire mode, 
+     * where the keys come from the thin client */
+    if (data.autoplay || wire_rows)
     {
-        perror("Pipe creation error\n");
-        exit(EXIT_FAILURE);
-    }
+        FILE *null_out = fopen("/dev/null", "w");
 
-    /* ncurses init */
-    initscr();   /* init screen */
+        if (null_out == NULL || newterm("xterm", null_out,
+                    data.autoplay ? fopen("/dev/null", "r") : stdin) == NULL)
+        {
+            fprintf(stderr, "cannot open the null terminal\n");
+            exit(EXIT_FAILURE);
+        }
+        term_fd = fileno(null_out);
+        if (wire_rows)
+            resizeterm(wire_rows, wire_cols);
+    } else
+        initscr();   /* init screen */
     noecho();    /* no keyboard echo on screen */
     curs_set(0); /* hide cursor */
     keypad(stdscr, TRUE); /* enable special keys */
     timeout(0);  /* non-blocking input */
 
     /* get bottom row of the field */
-    data.bottom_row = getmaxy(stdscr) - 1; 
+    data.match.bottom_row = getmaxy(stdscr) - 1; 
 
     /* check for color capability */
     if (has_colors() == FALSE)
@@ -118,125 +601,101 @@ int main(void)
     /* set color pair for ai */
     init_pair(AI_COLOR, COLOR_WHITE, COLOR_YELLOW);
 
-    /* create thread for signal listening */
-    pthread_create(
-            &signal_thread,
-            NULL,
-            signal_listener,
-            &data);
-
-    print_intro_menu(stdscr);
-
-    /* each iteration is a single game */
-    do {
-        char c;
-	
-        /* wait until the user press space (game start) or q (quit) */
-        do { 
-            c = getch();
-            if (c == QUIT_KEY)
-                /* safe because threads have not been created yet */
-                termination_handler(); 
-        } while (c != ' ');
-	
-	data.haltFlag = 0;
-        /* play status on */
-        data.play_flag = 1;
-        data.termination_flag = 0; /* zero to run, non-zero to terminate */
-
-        /* clear screen */
-        clear();
-
-        /* init player paddle */
-        data.paddle_pos = (PADDLE_WIDTH / 2 
-                + data.bottom_row - PADDLE_WIDTH / 2) / 2;
-        data.paddle_col = getmaxx(stdscr) - 1;
-        draw_paddle(&data, KBD_TAG);
-
-        /* init ai paddle */
-        data.ai_paddle_pos = data.paddle_pos;
-        data.ai_paddle_col = 1;
-        draw_paddle(&data, AI_TAG);
-
-        /* init ball */
-        data.ball_x_old = data.ball_x = data.paddle_col - 1;
-        data.ball_y_old = data.ball_y = data.paddle_pos;
-        data.ball_dirx = -1;
-        data.ball_diry = (rand() % 2 == 0 ? 1 : -1);
-        draw_ball(&data);
-
-        /* create thread for keyboard handling */
-        pthread_create(
-                &keyboard_handler_thread,
-                NULL,
-                keyboard_handler,
-                &data);
-
-	/* create thread for ai */
-        pthread_create(
-                &ai_handler_thread,
-                NULL,
-                ai_handler,
-                &data);
-
-        /* create thread for ball movement */
-        pthread_create(
-                &ball_handler_thread,
-                NULL,
-                ball_handler,
-                &data);
-
-        /* manage screen update */
-        while (!data.exit_flag && data.play_flag)
-        {
-	    while(data.haltFlag != 0);
-        
-            read(data.pipedes[0], buf, TAG_SIZE);
-
-            /* critical section */
-            pthread_mutex_lock(&data.mut);
-            if (!strcmp(buf, KBD_TAG)) /* data from keyboard */
-            {
-                delete_paddle(&data, KBD_TAG);
-                draw_paddle(&data, KBD_TAG);
-            }
-            if (!strcmp(buf, AI_TAG)) /* data from ai */
-            {
-                delete_paddle(&data, AI_TAG);
-                draw_paddle(&data, AI_TAG);
-            }
-            if (!strcmp(buf, BALL_TAG)) /* data from ball */
-            {
-                delete_ball(&data);
-                draw_ball(&data);
-            }
-            refresh();
-            pthread_mutex_unlock(&data.mut);
-        }
+    /* set color pair for court lines */
+    init_pair(COURT_COLOR, COLOR_GREEN, COLOR_BLACK);
+
+    /* optional features of the frame encoder, probed on a clean screen
+     * unless already known for this terminal */
+    refresh();
+    features = tc_probe(data.autoplay || wire_rows ? -1 : STDIN_FILENO,
+            term_fd,
+            reprobe, &cached);
+    tb_enable(features);
+
+    /* sprites for the moving objects where the terminal can show them */
+    if ((features & TERM_KITTY) && load_sprites(&data) != 0)
+        features &= ~TERM_KITTY;
+
+    /* from here termination_handler takes the sprites down too */
+    game_frame = &data.frame;
+
+    /* create coroutines for signal listening and game control */
+    sched_spawn(&data.sched, signal_listener, &data);
+    sched_spawn(&data.sched, game_controller, &data);
+    if (spec_path)
+        sched_spawn(&data.sched, spectator_handler, &data);
+
+    /* play until the user asks to quit */
+    autoplayed = data.autoplay;
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    started = sched_now();
+    sched_run(&data.sched);
+
+    if (spec_path)
+        spec_close(&data.spec);
+    court_free(&data.court);
+    game_frame = NULL;
+    frame_free(&data.frame, term_fd); /* sprites live on the game screen */
+    endwin(); /* close ncurses window */
 
-        /* allow termination of other threads */
-        data.termination_flag = 1; 
+    restore_key_rate(); /* restore keyboard settings */
 
-        /* print endgame message in superimpression (critical section) */
-        if (!data.exit_flag)
-        {
-            pthread_mutex_lock(&data.mut);
-            print_intra_menu(
-                    stdscr,
-                    (data.winner ? "GAME LOST" : "GAME WON"));
-            pthread_mutex_unlock(&data.mut);
-        }
+    /* the store is in data, which doesn't outlive main: the last games are
+     * written here, close_scores only covers the exits during the game */
+    score_close(&data.scores);
 
-    } while (!data.exit_flag);
+    if (stats)
+    {
+        struct rusage ru;
+        double secs = (sched_now() - started) / 1e6;
+        double cpu;
+        lb_board best;
+
+        getrusage(RUSAGE_SELF, &ru);
+        cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+            + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+        fprintf(stderr, "%ld wakeups in %.1f s: %.1f wakeups/s, "
+                "cpu %.2f%%\n", data.sched.wakeups, secs,
+                data.sched.wakeups / secs, 100.0 * cpu / secs);
+        sched_report(&data.sched, stderr);
+        frame_report(&data.frame, stderr);
+        pointer_stats(&data.pointer, stderr);
+        if (data.wire.fd >= 0)
+            fprintf(stderr, "wire: %ld frames, %lld bytes, %.1f bytes/s\n",
+                    data.wire.frames, data.wire.sent, data.wire.sent / secs);
+        if (spec_path)
+            spec_report(&data.spec, stderr);
+        if (open_scores)
+            score_report(&data.scores, stderr);
+        lb_read(&data.board, &best);
+        for (i = 0; i < best.count; i++)
+            fprintf(stderr, "board %d: player %u, score %d, level %d, "
+                    "rally %d\n", i + 1, best.top[i].player,
+                    best.top[i].score, best.top[i].level, best.top[i].rally);
+        fprintf(stderr, "terminal features:%s%s%s%s%s\n",
+                features & TERM_REP ? " rep" : "",
+                features & TERM_ECH ? " ech" : "",
+                features & TERM_KITTY ? " kitty" : "",
+                features & TERM_SYNC ? " sync" : "",
+                cached ? " (cached)" : "");
+    }
 
-    /* wait for remaining children threads termination 
-     * (ball thread terminated itself yet) */
-    pthread_join(ai_handler_thread, NULL);
-    pthread_join(keyboard_handler_thread, NULL);
-   
-    endwin(); /* close ncurses window */
+    if (autoplayed)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &real_end);
+        fprintf(results,
+                "%d games: %d won, %d lost, %.3f s of game time in %.3f s\n",
+                data.won + data.lost, data.won, data.lost,
+                (sched_now() - started) / 1e6,
+                (real_end.tv_sec - real_start.tv_sec)
+                + (real_end.tv_nsec - real_start.tv_nsec) / 1e9);
+    }
 
-    restore_key_rate(); /* restore keyboard settings */
+    if (tick_spec)
+        tick_close(&tick);
+    ctl_destroy(data.ai);
+    lb_destroy(&data.board);
 
+    open_scores = NULL;
     return 0;
 }
@@ -0,0 +1,137 @@
+/*!
+ * \file pong_env.c
+ *
+ * \brief This file implements the batched environment declared in
+ * pong_env.h.
+ *
+ */
+
+#include <stdlib.h>
+#include "rules.h"
+#include "pong_env.h"
+
+/*!
+ * Batch of matches
+ */
+struct pong_env {
+    int k; /*!< number of matches */
+    int rows; /*!< rows of the field */
+    int cols; /*!< columns of the field */
+    unsigned rng; /*!< xorshift state for the serve directions */
+    match_state *match; /*!< k match states */
+};
+
+/*!
+ * Return a random serve direction.
+ */
+static int serve_dir(pong_env *env)
+{
+    env->rng ^= env->rng << 13;
+    env->rng ^= env->rng >> 17;
+    env->rng ^= env->rng << 5;
+    return (env->rng & 1) ? 1 : -1;
+}
+
+/*!
+ * Store the observation of a match.
+ */
+static void observe(const match_state *m, float *obs)
+{
+    obs[PONG_OBS_BALL_X] = m->ball_x;
+    obs[PONG_OBS_BALL_Y] = m->ball_y;
+    obs[PONG_OBS_BALL_DIRX] = m->ball_dirx;
+    obs[PONG_OBS_BALL_DIRY] = m->ball_diry;
+    obs[PONG_OBS_PADDLE] = m->paddle_pos;
+    obs[PONG_OBS_AI_PADDLE] = m->ai_paddle_pos;
+    obs[PONG_OBS_LEVEL] = m->gameLevel;
+    obs[PONG_OBS_HITCNT] = m->hitCnt;
+}
+
+/*!
+ */
+pong_env *pong_env_create(int k, int rows, int cols, unsigned seed)
+{
+    pong_env *env = malloc(sizeof *env);
+
+    if (env == NULL)
+        return NULL;
+
+    env->k = k;
+    env->rows = rows;
+    env->cols = cols;
+    env->rng = seed ? seed : 1; /* xorshift state must be non-zero */
+    env->match = malloc(k * sizeof *env->match);
+    if (env->match == NULL)
+    {
+        pong_env_destroy(env);
+        return NULL;
+    }
+    pong_env_reset(env, NULL);
+
+    return env;
+}
+
+/*!
+ */
+void pong_env_destroy(pong_env *env)
+{
+    free(env->match);
+    free(env);
+}
+
+/*!
+ */
+int pong_env_size(const pong_env *env)
+{
+    return env->k;
+}
+
+/*!
+ * A NULL observation buffer just serves the matches.
+ */
+void pong_env_reset(pong_env *env, float *obs)
+{
+    int i;
+
+    for (i = 0; i < env->k; ++i)
+    {
+        match_serve(&env->match[i], env->rows, env->cols, serve_dir(env));
+        if (obs)
+            observe(&env->match[i], obs + i * PONG_OBS_SIZE);
+    }
+}
+
+/*!
+ * Each match advances by one match_step with the requested action.
+ */
+void pong_env_step(
+        pong_env *env,
+        const int *actions,
+        float *obs,
+        float *rewards,
+        unsigned char *done)
+{
+    int i;
+
+    for (i = 0; i < env->k; ++i)
+    {
+        match_state *m = &env->match[i];
+        int ev;
+
+        ev = match_step(m, actions[i]);
+
+        if (ev & BALL_OVER)
+        {
+            rewards[i] = (ev & BALL_PLAYER_WINS) ? 1.0f : -1.0f;
+            done[i] = 1;
+
+            /* auto reset */
+            match_serve(m, env->rows, env->cols, serve_dir(env));
+        } else {
+            rewards[i] = 0.0f;
+            done[i] = 0;
+        }
+
+        observe(m, obs + i * PONG_OBS_SIZE);
+    }
+}
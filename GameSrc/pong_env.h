@@ -0,0 +1,101 @@
+/*!
+ * \file pong_env.h
+ *
+ * \brief libpong: batched headless matches for training and evaluating
+ * paddle controllers.
+ *
+ * An environment holds K independent matches played by the rules of the
+ * game (rules.h). The caller controls the player paddle of every match and
+ * the built-in ai controls the other one; a single call advances all the
+ * matches by one ball step:
+ *
+ *     pong_env_step(env, actions[K]) -> obs[K][PONG_OBS_SIZE], rewards[K],
+ *                                       done[K]
+ *
+ * Observations, rewards and done flags are written straight into buffers
+ * owned by the caller. A finished match is served again at once, so the
+ * observation returned together with done = 1 is the first one of the new
+ * match.
+ *
+ * Time in a match is measured in ball steps (see match_step in rules.h).
+ *
+ * Build: gcc -O2 -shared -fPIC pong_env.c rules.c -o libpong.so
+ */
+
+#ifndef PONG_ENV_H
+#define PONG_ENV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_OBS_SIZE 8 /*!< floats in the observation of a match */
+#define PONG_OBS_BALL_X 0 /*!< ball column */
+#define PONG_OBS_BALL_Y 1 /*!< ball row */
+#define PONG_OBS_BALL_DIRX 2 /*!< ball x speed component */
+#define PONG_OBS_BALL_DIRY 3 /*!< ball y speed component */
+#define PONG_OBS_PADDLE 4 /*!< player paddle row */
+#define PONG_OBS_AI_PADDLE 5 /*!< ai paddle row */
+#define PONG_OBS_LEVEL 6 /*!< current game level */
+#define PONG_OBS_HITCNT 7 /*!< hit count of the current level */
+
+#define PONG_UP -1 /*!< action moving the player paddle up */
+#define PONG_STAY 0 /*!< action keeping the player paddle still */
+#define PONG_DOWN 1 /*!< action moving the player paddle down */
+
+typedef struct pong_env pong_env; /*!< opaque batch of matches */
+
+/*!
+ * \brief Create an environment of k matches.
+ *
+ * @param k number of matches
+ * @param rows number of rows of the field
+ * @param cols number of columns of the field
+ * @param seed seed of the serve directions
+ * @return the environment, NULL on allocation failure
+ */
+pong_env *pong_env_create(int k, int rows, int cols, unsigned seed);
+
+/*!
+ * \brief Destroy an environment.
+ *
+ * @param env environment
+ */
+void pong_env_destroy(pong_env *env);
+
+/*!
+ * \brief Return the number of matches of an environment.
+ *
+ * @param env environment
+ */
+int pong_env_size(const pong_env *env);
+
+/*!
+ * \brief Serve all the matches again.
+ *
+ * @param env environment
+ * @param obs k * PONG_OBS_SIZE floats receiving the observations
+ */
+void pong_env_reset(pong_env *env, float *obs);
+
+/*!
+ * \brief Advance all the matches by one ball step.
+ *
+ * @param env environment
+ * @param actions k actions (PONG_UP, PONG_STAY, PONG_DOWN)
+ * @param obs k * PONG_OBS_SIZE floats receiving the observations
+ * @param rewards k floats receiving 1 on player win, -1 on ai win, else 0
+ * @param done k flags set to 1 when the match ended (and was served again)
+ */
+void pong_env_step(
+        pong_env *env,
+        const int *actions,
+        float *obs,
+        float *rewards,
+        unsigned char *done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/*!
+ * \file pong_plugin.h
+ *
+ * \brief Stable C ABI of the paddle controller plugins.
+ *
+ * A plugin is a shared object exporting:
+ *
+ *     const int pong_plugin_abi = PONG_PLUGIN_ABI;
+ *     const char pong_plugin_name[] = "...";
+ *     void pong_decide_batch(const pong_state *s, int n, pong_intent *out);
+ *
+ * and optionally
+ *
+ *     int pong_plugin_init(void);     non zero refuses the load
+ *     void pong_plugin_fini(void);
+ *
+ * pong_decide_batch stores in out[i] the move of the paddle for the match
+ * s[i], for i < n: -1 up, 1 down, 0 stand still. It is called once for a
+ * whole batch of matches, possibly from several threads at once on
+ * different batches.
+ *
+ * This header depends on nothing else of the game. pong_decide_batch
+ * walks arrays of pong_state, so the stride of the array is part of the
+ * ABI: any change to the structures, even a field added at the end,
+ * bumps PONG_PLUGIN_ABI.
+ */
+
+#ifndef PONG_PLUGIN_H
+#define PONG_PLUGIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_PLUGIN_ABI 1 /*!< version of this interface */
+
+/*!
+ * A match seen from the plugin paddle, see ctl_view in controller.h
+ */
+typedef struct {
+    int32_t ball_x; /*!< ball distance from the own paddle column */
+    int32_t ball_y; /*!< ball row */
+    int32_t ball_dirx; /*!< 1 when the ball moves away, -1 when it approaches */
+    int32_t ball_diry; /*!< ball y speed component */
+    int32_t own_pos; /*!< own paddle row */
+    int32_t opp_pos; /*!< opponent paddle row */
+    int32_t width; /*!< distance between the paddle columns */
+    int32_t bottom_row; /*!< last row of the field */
+    int32_t level; /*!< current game level */
+} pong_state;
+
+typedef int32_t pong_intent; /*!< paddle move: -1, 0 or 1 */
+
+/* the size of pong_state is fixed for PONG_PLUGIN_ABI 1 */
+#ifndef __cplusplus
+_Static_assert(sizeof(pong_state) == 9 * sizeof(int32_t),
+        "pong_state changed: bump PONG_PLUGIN_ABI");
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
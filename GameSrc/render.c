@@ -0,0 +1,449 @@
+/*!
+ * \file render.c
+ *
+ * \brief This file implements the static court layer declared in render.h.
+ *
+ */
+
+#include <string.h>
+#include <term.h>
+#include "gfx.h"
+#include "render.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b)) /*!< return minimum of 2 values */
+#define PADDLE_MARGIN 2 /*!< columns kept free for each paddle */
+#define SYNC_MIN 256 /*!< smallest frame worth a synchronized update */
+
+/*!
+ * Draw the score frame text centered on the top border.
+ */
+static void draw_score(court *c)
+{
+    int len = strlen(c->score);
+    int x;
+
+    if (len == 0 || len + 2 > c->cols - 2 * PADDLE_MARGIN)
+        return;
+
+    x = (c->cols - len - 2) / 2;
+    wattron(c->layer, COLOR_PAIR(COURT_COLOR) | A_BOLD);
+    mvwaddch(c->layer, 0, x, ACS_RTEE);
+    mvwaddstr(c->layer, 0, x + 1, c->score);
+    mvwaddch(c->layer, 0, x + len + 1, ACS_LTEE);
+    wattroff(c->layer, COLOR_PAIR(COURT_COLOR) | A_BOLD);
+}
+
+/*!
+ */
+int court_compose(court *c)
+{
+    int rows = getmaxy(stdscr);
+    int cols = getmaxx(stdscr);
+    int y;
+
+    if (c->layer && rows == c->rows && cols == c->cols)
+        return 0;
+
+    if (c->layer)
+        delwin(c->layer);
+    c->layer = newwin(rows, cols, 0, 0);
+    if (c->layer == NULL)
+        return -1;
+    c->rows = rows;
+    c->cols = cols;
+
+    /* borders between the paddles, and the net in the middle */
+    wattron(c->layer, COLOR_PAIR(COURT_COLOR));
+    if (cols > 2 * PADDLE_MARGIN)
+    {
+        mvwhline(c->layer, 0, PADDLE_MARGIN, ACS_HLINE,
+                cols - 2 * PADDLE_MARGIN);
+        if (rows > 1)
+            mvwhline(c->layer, rows - 1, PADDLE_MARGIN, ACS_HLINE,
+                    cols - 2 * PADDLE_MARGIN);
+    }
+    for (y = 1; y < rows - 1; y += 2)
+        mvwaddch(c->layer, y, cols / 2, ACS_VLINE);
+    wattroff(c->layer, COLOR_PAIR(COURT_COLOR));
+
+    draw_score(c);
+    return 0;
+}
+
+/*!
+ */
+void court_score(court *c, const char *text)
+{
+    int len = strlen(c->score);
+    int x = (c->cols - len - 2) / 2;
+
+    if (strcmp(text, c->score) == 0)
+        return;
+
+    /* give the old frame back to the border */
+    if (len > 0 && len + 2 <= c->cols - 2 * PADDLE_MARGIN)
+    {
+        wattron(c->layer, COLOR_PAIR(COURT_COLOR));
+        mvwhline(c->layer, 0, x, ACS_HLINE, len + 2);
+        wattroff(c->layer, COLOR_PAIR(COURT_COLOR));
+    }
+
+    strncpy(c->score, text, SCORE_MAX);
+    c->score[SCORE_MAX] = '\0';
+    draw_score(c);
+}
+
+/*!
+ */
+void court_show(const court *c)
+{
+    overwrite(c->layer, stdscr);
+}
+
+/*!
+ */
+chtype court_cell(const court *c, int y, int x)
+{
+    if (y < 0 || y >= c->rows || x < 0 || x >= c->cols)
+        return ' ';
+    return mvwinch(c->layer, y, x);
+}
+
+/*!
+ */
+void court_free(court *c)
+{
+    if (c->layer)
+        delwin(c->layer);
+    c->layer = NULL;
+}
+
+/*!
+ * Copy the opaque cells of a layout onto a window.
+ */
+static void copy_layout(WINDOW *layout, WINDOW *win)
+{
+    int rows = MIN(getmaxy(layout), getmaxy(win));
+    int cols = MIN(getmaxx(layout), getmaxx(win));
+    int y, x, cy, cx;
+
+    /* the cursor of curscr is where ncurses believes the terminal one is */
+    getyx(win, cy, cx);
+    for (y = 0; y < rows; ++y)
+        for (x = 0; x < cols; ++x)
+        {
+            chtype ch = mvwinch(layout, y, x);
+
+            if (ch != ' ')
+                mvwaddch(win, y, x, ch);
+        }
+    wmove(win, cy, cx);
+}
+
+/*!
+ */
+int banner_begin(banner *b, int key)
+{
+    int rows = getmaxy(stdscr);
+    int cols = getmaxx(stdscr);
+
+    if (b->layout && rows == b->rows && cols == b->cols && key == b->key)
+        return 0;
+
+    if (b->layout && (rows != b->rows || cols != b->cols))
+    {
+        delwin(b->layout);
+        b->layout = NULL;
+    }
+    if (b->layout == NULL)
+        b->layout = newwin(rows, cols, 0, 0);
+    if (b->layout == NULL)
+        return 0;
+    werase(b->layout);
+    b->rows = rows;
+    b->cols = cols;
+    b->key = key;
+    b->encoded = 0;
+    return 1;
+}
+
+/*!
+ */
+int banner_key(const char *text)
+{
+    unsigned h = 5381;
+
+    while (*text)
+        h = h * 33 + (unsigned char) *text++;
+    return (int) (h & 0x7fffffff);
+}
+
+/*!
+ */
+void banner_center(banner *b, int y, const char *text, attr_t attr)
+{
+    int len = MIN((int) strlen(text), b->cols);
+
+    if (y < 0 || y >= b->rows)
+        return;
+    wattron(b->layout, attr);
+    mvwaddnstr(b->layout, y, (b->cols - len) / 2, text, len);
+    wattroff(b->layout, attr);
+}
+
+/*!
+ */
+void banner_end(banner *b)
+{
+    int y, x;
+
+    tb_reset(&b->bytes);
+    if (tb_save(&b->bytes) != 0)
+        return; /* shown through ncurses */
+
+    /* runs of opaque cells, each after an absolute cursor motion */
+    for (y = 0; y < b->rows; ++y)
+    {
+        int run = 0;
+
+        for (x = 0; x < b->cols; ++x)
+        {
+            chtype ch = mvwinch(b->layout, y, x);
+            char c = ch & A_CHARTEXT;
+
+            if (ch == ' ')
+            {
+                run = 0;
+                continue;
+            }
+            if (!run)
+                tb_cup(&b->bytes, y, x);
+            run = 1;
+            tb_attr(&b->bytes, ch & A_ATTRIBUTES);
+            tb_put(&b->bytes, &c, 1);
+        }
+    }
+    tb_restore(&b->bytes);
+    b->encoded = 1;
+}
+
+/*!
+ * Encodes the cells of a window that differ from curscr, as runs after
+ * a cursor motion, and updates curscr to match.
+ */
+static void encode_changes(tbuf *b, WINDOW *win)
+{
+    int rows = MIN(getmaxy(win), getmaxy(curscr));
+    int cols = MIN(getmaxx(win), getmaxx(curscr));
+    int skip_corner = auto_right_margin && !eat_newline_glitch;
+    int y, x, cy, cx, n, run;
+
+    getyx(curscr, cy, cx);
+    for (y = 0; y < rows; ++y)
+    {
+        if (!is_linetouched(win, y))
+            continue;
+        for (x = 0; x < cols; ++x)
+        {
+            chtype ch = mvwinch(win, y, x);
+
+            if (ch == mvwinch(curscr, y, x))
+                continue;
+            /* the last cell would scroll the screen, left to ncurses */
+            if (skip_corner && y == rows - 1 && x == cols - 1)
+                continue;
+            /* run of identical cells, up to the last changed one */
+            for (n = 1, run = 1; x + run < cols; ++run)
+            {
+                chtype next = mvwinch(win, y, x + run);
+
+                if (next != ch
+                        || (skip_corner && y == rows - 1
+                            && x + run == cols - 1))
+                    break;
+                if (next != mvwinch(curscr, y, x + run))
+                    n = run + 1;
+            }
+
+            tb_move(b, win, y, x);
+            tb_run(b, ch, n);
+            for (run = 0; run < n; ++run)
+                mvwaddch(curscr, y, x + run, ch);
+            x += n - 1;
+        }
+    }
+    wmove(curscr, cy, cx);
+}
+
+/*!
+ */
+void banner_show(banner *b, WINDOW *win, int fd)
+{
+    if (b->layout == NULL)
+        return;
+
+    tb_reset(&b->out);
+    if (b->encoded && tb_geometry(getmaxy(curscr), getmaxx(curscr), fd) == 0
+            && tb_save(&b->out) == 0)
+    {
+        /* pending changes, then the banner, in a single write */
+        encode_changes(&b->out, win);
+        tb_restore(&b->out);
+        tb_put(&b->out, b->bytes.buf, b->bytes.len);
+        tb_sync(&b->out, 0);
+        if (tb_write(&b->out, fd) == 0)
+        {
+            wnoutrefresh(win);
+            copy_layout(b->layout, win);
+            copy_layout(b->layout, curscr);
+            return;
+        }
+        clearok(win, TRUE); /* curscr is no longer the terminal */
+    }
+
+    copy_layout(b->layout, win);
+    wrefresh(win);
+}
+
+/*!
+ */
+void banner_free(banner *b)
+{
+    if (b->layout)
+        delwin(b->layout);
+    b->layout = NULL;
+    tb_free(&b->bytes);
+    tb_free(&b->out);
+}
+
+/*!
+ */
+void frame_flush(frame_out *f, WINDOW *win, int fd)
+{
+    tbuf *b = &f->bytes;
+    size_t saved;
+    int n;
+
+    tb_reset(b);
+    if (tb_geometry(getmaxy(curscr), getmaxx(curscr), fd) != 0
+            || tb_save(b) != 0)
+    {
+        wrefresh(win);
+        return;
+    }
+    saved = b->len;
+    encode_changes(b, win);
+
+    /* sprites moved since the last frame */
+    for (n = 1; f->sprites && n <= SPRITE_MAX; ++n)
+    {
+        sprite *s = &f->sprite[n];
+
+        if (!s->moved || s->cols == 0)
+            continue;
+        tb_move(b, win, s->y, s->x);
+        gfx_place(b, n, s->cols, s->rows);
+        s->moved = 0;
+        s->shown = 1;
+    }
+
+    if (b->len > saved)
+    {
+        tb_restore(b);
+        /* repaints of the whole court show up at once */
+        if (b->len > SYNC_MIN)
+            tb_sync(b, 0);
+        if (tb_write(b, fd) == 0)
+        {
+            f->frames++;
+            f->sent += b->len;
+        }
+    }
+
+    /* hand the frame to ncurses too, which finds nothing left to send */
+    wnoutrefresh(win);
+}
+
+/*!
+ */
+int frame_upload(frame_out *f, int fd, int id, int w, int h,
+        const unsigned char *rgba, int cols, int rows)
+{
+    tbuf up = { 0 };
+    int err;
+
+    tb_reset(&up);
+    gfx_upload(&up, id, w, h, rgba);
+    err = tb_write(&up, fd);
+    tb_free(&up);
+    if (err)
+        return -1;
+
+    f->sprite[id].cols = cols;
+    f->sprite[id].rows = rows;
+    f->sprites = 1;
+    return 0;
+}
+
+/*!
+ */
+void frame_sprite(frame_out *f, int id, int y, int x)
+{
+    sprite *s = &f->sprite[id];
+
+    if (s->shown && !s->moved && s->y == y && s->x == x)
+        return;
+    s->y = y;
+    s->x = x;
+    s->moved = 1;
+}
+
+/*!
+ */
+void frame_hide(frame_out *f, int fd)
+{
+    tbuf *b = &f->bytes;
+    int id;
+
+    tb_reset(b);
+    for (id = 1; id <= SPRITE_MAX; ++id)
+        if (f->sprite[id].shown)
+        {
+            gfx_hide(b, id);
+            f->sprite[id].shown = 0;
+            f->sprite[id].moved = 0;
+        }
+    if (b->len)
+        tb_write(b, fd);
+}
+
+/*!
+ */
+void frame_report(const frame_out *f, FILE *out)
+{
+    const tbuf *b = &f->bytes;
+
+    if (f->frames == 0)
+        return;
+    fprintf(out, "%ld frames: %.1f bytes/frame, cursor motion %.1f "
+            "bytes/frame, %.1f with absolute motions (%.1f saved)\n",
+            f->frames, (double) f->sent / f->frames,
+            (double) b->motion / f->frames, (double) b->naive / f->frames,
+            (double) (b->naive - b->motion) / f->frames);
+}
+
+/*!
+ */
+void frame_free(frame_out *f, int fd)
+{
+    tbuf *b = &f->bytes;
+    int id;
+
+    tb_reset(b);
+    for (id = 1; id <= SPRITE_MAX; ++id)
+        if (f->sprite[id].cols)
+            gfx_free(b, id);
+    if (b->len)
+        tb_write(b, fd);
+    tb_free(b);
+}
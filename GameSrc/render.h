@@ -0,0 +1,247 @@
+/*!
+ * \file render.h
+ *
+ * \brief Static background layer of the court.
+ *
+ * The static part of the screen (court borders, centre net and score frame)
+ * is composed into an off-screen window once per terminal size. Starting a
+ * game or repainting after a resize copies the layer onto the screen, and
+ * the moving objects restore the background cells they leave instead of
+ * blanking them, so each frame only touches the cells of moving objects.
+ *
+ * Menus and banners are laid out in the same way once per terminal size,
+ * and pre-encoded (termout.h) into the byte string that paints them, so
+ * showing one costs a single write.
+ *
+ * During a game the frames are encoded by the game itself rather than by
+ * ncurses: the cells that differ between the window and the terminal go
+ * out with the cheapest cursor motions (termout.h), in one write per
+ * frame, and are copied into curscr so that ncurses stays in sync.
+ *
+ * On terminals with the kitty graphics protocol the moving objects can be
+ * sprites instead of cells (gfx.h): their images are uploaded once and
+ * each frame only moves their placements.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdio.h>
+#include <ncurses.h>
+#include "termout.h"
+
+#define COURT_COLOR 5 /*!< color pair identifier for court lines */
+#define SCORE_MAX 40 /*!< max length of the score frame text */
+
+/*!
+ * Static layer of the court
+ */
+typedef struct {
+    WINDOW *layer; /*!< static cells, the size of the screen */
+    int rows; /*!< screen rows the layer was composed for */
+    int cols; /*!< screen columns the layer was composed for */
+    char score[SCORE_MAX + 1]; /*!< text of the score frame */
+} court;
+
+/*!
+ * Pre-rendered menu or banner
+ */
+typedef struct {
+    WINDOW *layout; /*!< off-screen layout, the size of the screen */
+    int rows; /*!< screen rows the layout was made for */
+    int cols; /*!< screen columns the layout was made for */
+    int key; /*!< variant of the content (level, message...) */
+    tbuf bytes; /*!< encoded output painting the layout */
+    int encoded; /*!< bytes hold the layout */
+    tbuf out; /*!< pending changes and banner, as written */
+} banner;
+
+#define SPRITE_MAX 4 /*!< highest sprite id */
+
+/*!
+ * Sprite of a frame output
+ */
+typedef struct {
+    int cols; /*!< width in cells, 0 if the sprite isn't uploaded */
+    int rows; /*!< height in cells */
+    int y; /*!< row of the top left cell */
+    int x; /*!< column of the top left cell */
+    int moved; /*!< moved since the last frame */
+    int shown; /*!< placed on the terminal */
+} sprite;
+
+/*!
+ * Frame output of a game
+ */
+typedef struct {
+    tbuf bytes; /*!< encoded frame */
+    long frames; /*!< frames written */
+    long long sent; /*!< bytes written */
+    int sprites; /*!< moving objects are drawn as sprites */
+    sprite sprite[SPRITE_MAX + 1]; /*!< sprites by id */
+} frame_out;
+
+/*!
+ * \brief Compose the static layer for the current screen size.
+ *
+ * Nothing is done when the size didn't change since the last call.
+ *
+ * @param c court, zeroed before the first call
+ * @return 0 on success, -1 if the layer can't be allocated
+ */
+int court_compose(court *c);
+
+/*!
+ * \brief Write the score frame text into the static layer.
+ *
+ * @param c composed court
+ * @param text text of the frame, truncated to SCORE_MAX characters
+ */
+void court_score(court *c, const char *text);
+
+/*!
+ * \brief Copy the static layer onto the screen, in place of clear().
+ *
+ * @param c composed court
+ */
+void court_show(const court *c);
+
+/*!
+ * \brief Return the background of a screen cell, with its attributes.
+ *
+ * @param c composed court
+ * @param y row
+ * @param x column
+ */
+chtype court_cell(const court *c, int y, int x);
+
+/*!
+ * \brief Release the static layer.
+ *
+ * @param c court
+ */
+void court_free(court *c);
+
+/*!
+ * \brief Start the layout of a banner, unless it is up to date.
+ *
+ * When the screen size or the key changed, the layout is cleared and the
+ * caller draws the banner into it, then calls banner_end. Blank cells
+ * without attributes are transparent.
+ *
+ * @param b banner, zeroed before the first call
+ * @param key variant of the content
+ * @return 1 if the caller has to draw the layout, 0 if it is up to date
+ */
+int banner_begin(banner *b, int key);
+
+/*!
+ * \brief Return a banner key telling texts apart.
+ *
+ * @param text text of the variant
+ */
+int banner_key(const char *text);
+
+/*!
+ * \brief Draw a line of text centered in the layout.
+ *
+ * @param b banner being laid out
+ * @param y row
+ * @param text text of the line, clipped to the screen width
+ * @param attr attributes and color pair of the text
+ */
+void banner_center(banner *b, int y, const char *text, attr_t attr);
+
+/*!
+ * \brief Finish the layout of a banner, encoding its output.
+ *
+ * @param b banner being laid out
+ */
+void banner_end(banner *b);
+
+/*!
+ * \brief Show a banner on top of a window.
+ *
+ * The changes of the window not shown yet and the pre-encoded banner are
+ * written in one go, then the banner is copied into the window and into
+ * curscr, so that ncurses knows the terminal already shows it. Terminals
+ * that can't save the cursor get the banner through a plain refresh
+ * instead.
+ *
+ * @param b laid out banner
+ * @param win window the banner is shown on, stdscr
+ * @param fd terminal output file descriptor
+ */
+void banner_show(banner *b, WINDOW *win, int fd);
+
+/*!
+ * \brief Release a banner.
+ *
+ * @param b banner
+ */
+void banner_free(banner *b);
+
+/*!
+ * \brief Write the changes of a window to the terminal as one frame.
+ *
+ * Terminals that can't save the cursor or address it get the frame
+ * through a plain refresh instead.
+ *
+ * @param f frame output, zeroed before the first call
+ * @param win window holding the new frame, stdscr
+ * @param fd terminal output file descriptor
+ */
+void frame_flush(frame_out *f, WINDOW *win, int fd);
+
+/*!
+ * \brief Upload the image of a sprite and turn sprites on.
+ *
+ * @param f frame output
+ * @param fd terminal output file descriptor
+ * @param id sprite id, 1 to SPRITE_MAX
+ * @param w width in pixels
+ * @param h height in pixels
+ * @param rgba w x h pixels, 4 bytes each
+ * @param cols width of the sprite in cells
+ * @param rows height of the sprite in cells
+ * @return 0 on success, -1 on write error
+ */
+int frame_upload(frame_out *f, int fd, int id, int w, int h,
+        const unsigned char *rgba, int cols, int rows);
+
+/*!
+ * \brief Move a sprite, from the next frame on.
+ *
+ * @param f frame output
+ * @param id sprite id
+ * @param y row of the top left cell
+ * @param x column of the top left cell
+ */
+void frame_sprite(frame_out *f, int id, int y, int x);
+
+/*!
+ * \brief Remove the shown sprites from the terminal.
+ *
+ * @param f frame output
+ * @param fd terminal output file descriptor
+ */
+void frame_hide(frame_out *f, int fd);
+
+/*!
+ * \brief Print the frame output statistics.
+ *
+ * @param f frame output
+ * @param out output stream
+ */
+void frame_report(const frame_out *f, FILE *out);
+
+/*!
+ * \brief Release the frame output buffer, and the sprite images on the
+ * terminal.
+ *
+ * @param f frame output
+ * @param fd terminal output file descriptor
+ */
+void frame_free(frame_out *f, int fd);
+
+#endif
@@ -0,0 +1,153 @@
+/*!
+ * \file rt.c
+ *
+ * \brief This file implements the real-time profile declared in rt.h.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "rt.h"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK 1
+#endif
+
+/*!
+ * sched_setattr argument, not exported by every C library
+ */
+struct rt_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+/*!
+ */
+int rt_policy(const char *name)
+{
+    if (!strcmp(name, "fifo"))
+        return RT_FIFO;
+    if (!strcmp(name, "deadline"))
+        return RT_DEADLINE;
+    return -1;
+}
+
+/*!
+ * Parse a core list like "0,2-3" into a cpu set.
+ */
+static int parse_cpus(const char *cpus, cpu_set_t *set)
+{
+    const char *s = cpus;
+
+    CPU_ZERO(set);
+    while (*s)
+    {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+
+        if (end == s)
+            return -1;
+        if (*end == '-')
+        {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s)
+                return -1;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE)
+            return -1;
+        for (; lo <= hi; ++lo)
+            CPU_SET(lo, set);
+        s = end;
+        if (*s == ',')
+            s++;
+        else if (*s)
+            return -1;
+    }
+    return 0;
+}
+
+/*!
+ * Each step reports its own failure, so a partially privileged process
+ * (e.g. CAP_IPC_LOCK without CAP_SYS_NICE) keeps what it could get.
+ */
+int rt_setup(int policy, const char *cpus)
+{
+    int err = 0;
+
+    if (cpus)
+    {
+        cpu_set_t set;
+
+        if (parse_cpus(cpus, &set) != 0)
+        {
+            fprintf(stderr, "rt: bad core list %s, not pinning\n", cpus);
+            err = -1;
+        } else if (sched_setaffinity(0, sizeof set, &set) != 0) {
+            fprintf(stderr, "rt: cannot pin to cores %s: %s\n",
+                    cpus, strerror(errno));
+            err = -1;
+        }
+    }
+
+    if (policy == RT_NONE)
+        return err;
+
+    /* no page faults in the game loop */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        fprintf(stderr, "rt: cannot lock memory: %s\n", strerror(errno));
+        err = -1;
+    }
+
+    if (policy == RT_FIFO)
+    {
+        struct sched_param sp = { .sched_priority = RT_FIFO_PRIO };
+
+        /* the xset children get the default scheduling */
+        if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &sp)
+                != 0)
+        {
+            fprintf(stderr, "rt: cannot set SCHED_FIFO: %s, "
+                    "keeping default scheduling\n", strerror(errno));
+            err = -1;
+        }
+    } else if (policy == RT_DEADLINE) {
+        struct rt_attr attr;
+
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.sched_policy = SCHED_DEADLINE;
+        attr.sched_flags = SCHED_FLAG_RESET_ON_FORK; /* or fork fails */
+        attr.sched_runtime = RT_RUNTIME_US * 1000ULL;
+        attr.sched_deadline = RT_PERIOD_US * 1000ULL;
+        attr.sched_period = RT_PERIOD_US * 1000ULL;
+        if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0)
+        {
+            /* deadline tasks can't have a narrowed affinity: EPERM here
+             * may come from the pinning as well as from privileges */
+            fprintf(stderr, "rt: cannot set SCHED_DEADLINE: %s, "
+                    "keeping default scheduling\n", strerror(errno));
+            err = -1;
+        }
+    }
+
+    return err;
+}
@@ -0,0 +1,46 @@
+/*!
+ * \file rt.h
+ *
+ * \brief Opt-in real-time scheduling profile.
+ *
+ * The game runs all its actors on one thread (sched.h), so the profile
+ * applies to the simulation and the rendering at once: the thread is
+ * pinned to a set of cores, its memory is locked, and it is given a
+ * SCHED_FIFO priority or a SCHED_DEADLINE reservation sized on the ball
+ * period. Every step is optional: what the process is not allowed to do is
+ * reported and skipped, and the game goes on with the default scheduling.
+ */
+
+#ifndef RT_H
+#define RT_H
+
+#define RT_NONE 0 /*!< default scheduling */
+#define RT_FIFO 1 /*!< SCHED_FIFO at RT_FIFO_PRIO */
+#define RT_DEADLINE 2 /*!< SCHED_DEADLINE reservation */
+
+#define RT_FIFO_PRIO 10 /*!< SCHED_FIFO priority, above default irq threads */
+#define RT_RUNTIME_US 2000 /*!< SCHED_DEADLINE runtime per period */
+#define RT_PERIOD_US 25000 /*!< SCHED_DEADLINE period: one ball step */
+
+/*!
+ * \brief Parse a policy name.
+ *
+ * @param name "fifo" or "deadline"
+ * @return RT_FIFO or RT_DEADLINE, -1 if unknown
+ */
+int rt_policy(const char *name);
+
+/*!
+ * \brief Apply the real-time profile to the calling thread.
+ *
+ * Must be called before the terminal is taken over, since failures are
+ * reported on stderr.
+ *
+ * @param policy RT_NONE, RT_FIFO or RT_DEADLINE
+ * @param cpus cores to pin the thread to, as "0,2-3"; NULL to leave the
+ * affinity alone
+ * @return 0 if every step succeeded, -1 if some fell back
+ */
+int rt_setup(int policy, const char *cpus);
+
+#endif
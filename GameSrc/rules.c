@@ -0,0 +1,239 @@
+/*!
+ * \file rules.c
+ *
+ * \brief This file implements the game rules declared in rules.h.
+ *
+ */
+
+#include <stdlib.h>
+#include "rules.h"
+
+/*!
+ * The ai paddle starts aligned to the player paddle, and the ball starts
+ * just in front of the player paddle, moving toward the ai.
+ */
+void match_serve(match_state *m, int rows, int cols, int diry)
+{
+    m->bottom_row = rows - 1;
+
+    /* init player paddle */
+    m->paddle_pos = (PADDLE_WIDTH / 2
+            + m->bottom_row - PADDLE_WIDTH / 2) / 2;
+    m->paddle_col = cols - 1;
+
+    /* init ai paddle */
+    m->ai_paddle_pos = m->paddle_pos;
+    m->ai_paddle_col = AI_COL;
+
+    /* init ball */
+    m->ball_x = m->paddle_col - 1;
+    m->ball_y = m->paddle_pos;
+    m->ball_dirx = -1;
+    m->ball_diry = diry;
+
+    m->gameLevel = 0;
+    m->hitCnt = 0;
+    m->ai_time = 0;
+    m->ai_target = m->ai_paddle_pos;
+    m->ai_wait = 0;
+}
+
+/*!
+ * The ball moves diagonally by one cell, bouncing on the field borders and
+ * on the paddles. Every MAX_HITCNT + 1 player hits the level is increased;
+ * the match ends when a paddle misses the ball or the last level is
+ * cleared.
+ */
+int ball_step(match_state *m)
+{
+    int ev = 0;
+
+    /* update ball coordinates */
+    m->ball_y += m->ball_diry;
+    m->ball_x += m->ball_dirx;
+
+    /* reflect ball on field top and bottom */
+    if (m->ball_y < FIELD_TOP || m->ball_y > m->bottom_row)
+    {
+        m->ball_diry *= -1;
+        m->ball_y += 2 * m->ball_diry;
+        ev |= BALL_WALL;
+    }
+
+    /* reflect ball on player pad */
+    if (m->ball_x == m->paddle_col)
+    {
+        if (abs(m->paddle_pos - m->ball_y - -m->ball_diry)
+                <= PADDLE_WIDTH / 2)
+        {
+            /* ball is above the pad; consider one extra on length
+             * because the ball is moving diagonally */
+            m->ball_dirx *= -1;
+            m->ball_x += 2 * m->ball_dirx;
+            ev |= BALL_HIT_PLAYER;
+
+            if (m->hitCnt >= MAX_HITCNT)
+            {
+                m->gameLevel++;
+                m->hitCnt = 0;
+                ev |= BALL_LEVEL_UP;
+            }
+            else
+                m->hitCnt++;
+
+            /* last level cleared, player wins */
+            if (m->gameLevel > MAX_LEVEL)
+                return ev | BALL_PLAYER_WINS;
+
+        } else {
+            /* ball is out, player loses */
+            return ev | BALL_AI_WINS;
+        }
+    }
+
+    /* reflect ball on AI pad */
+    if (m->ball_x == m->ai_paddle_col)
+    {
+        if (abs(m->ai_paddle_pos - m->ball_y - -m->ball_diry)
+                <= PADDLE_WIDTH / 2)
+        {
+            /* ball is above the pad; consider one extra on length
+             * because the ball is moving diagonally */
+            m->ball_dirx *= -1;
+            m->ball_x += 2 * m->ball_dirx;
+            ev |= BALL_HIT_AI;
+        } else {
+            /* ball is out, ai loses */
+            return ev | BALL_PLAYER_WINS;
+        }
+    }
+
+    return ev;
+}
+
+/*!
+ * The ai paddle chases the ball row, one row per step, as long as it stays
+ * inside the field.
+ */
+void ai_step(match_state *m)
+{
+    int diff = m->ball_y - m->ai_paddle_pos;
+
+    ai_move(m, diff / (diff == 0 ? 1 : abs(diff)));
+}
+
+/*!
+ * With AI_LEVEL_CHASE parameters the tuned ai moves exactly as ai_step.
+ */
+void ai_tuned_step(match_state *m, const ai_level *p)
+{
+    int i;
+
+    /* aim again at the ball */
+    if (--m->ai_wait <= 0)
+    {
+        m->ai_target = m->ball_y;
+        if (p->error > 0)
+        {
+            m->rng ^= m->rng << 13;
+            m->rng ^= m->rng >> 17;
+            m->rng ^= m->rng << 5;
+            m->ai_target += (int) (m->rng % (2 * p->error + 1)) - p->error;
+        }
+        m->ai_wait = p->reaction;
+    }
+
+    /* walk toward the aim */
+    for (i = 0; i < p->speed && m->ai_paddle_pos != m->ai_target; ++i)
+        ai_move(m, m->ai_target > m->ai_paddle_pos ? 1 : -1);
+}
+
+/*!
+ * The bounces fold the straight path of the ball into a triangle wave of
+ * period 2 * bottom_row.
+ */
+int ball_row_after(int y, int diry, int bottom_row, int steps)
+{
+    int period = 2 * MAX(bottom_row, 1);
+
+    y = (y + steps * diry) % period;
+    if (y < 0)
+        y += period;
+    return y <= period / 2 ? y : period - y;
+}
+
+/*!
+ * The ball turns on the step that takes it past the field top or bottom,
+ * or onto the column of a paddle.
+ */
+int ball_turn_steps(const match_state *m)
+{
+    int wall = m->ball_diry > 0 ? m->bottom_row - m->ball_y + 1
+        : m->ball_y - FIELD_TOP + 1;
+    int paddle = m->ball_dirx > 0 ? m->paddle_col - m->ball_x
+        : m->ball_x - m->ai_paddle_col;
+
+    return MAX(MIN(wall, paddle), 1);
+}
+
+/*!
+ */
+void ai_move(match_state *m, int dir)
+{
+    int new = m->ai_paddle_pos + dir;
+
+    if (new >= PADDLE_WIDTH / 2
+            && new <= m->bottom_row - PADDLE_WIDTH / 2)
+        m->ai_paddle_pos = new;
+}
+
+/*!
+ * Advance by one ball step; the ai moves as ai_step when levels is NULL.
+ * The ball delay is clamped to zero: the last levels run the ball at full
+ * speed, with the ai standing still between ball steps.
+ */
+static int step(match_state *m, int dir, const ai_level *levels)
+{
+    int ev;
+
+    player_step(m, dir);
+    ev = ball_step(m);
+
+    if (!(ev & BALL_OVER))
+    {
+        m->ai_time += MAX(BALL_DELAY(m->gameLevel), 0);
+        for (; m->ai_time >= TIME_GAP_AI; m->ai_time -= TIME_GAP_AI)
+        {
+            if (levels)
+                ai_tuned_step(m, &levels[MIN(m->gameLevel, MAX_LEVEL)]);
+            else
+                ai_step(m);
+        }
+    }
+
+    return ev;
+}
+
+/*!
+ */
+int match_step(match_state *m, int dir)
+{
+    return step(m, dir, NULL);
+}
+
+/*!
+ */
+int match_step_tuned(match_state *m, int dir, const ai_level *levels)
+{
+    return step(m, dir, levels);
+}
+
+/*!
+ */
+void player_step(match_state *m, int dir)
+{
+    if (dir < 0 && m->paddle_pos > PADDLE_WIDTH / 2)
+        m->paddle_pos--;
+    if (dir > 0 && m->paddle_pos < m->bottom_row - PADDLE_WIDTH / 2)
+        m->paddle_pos++;
+}
@@ -0,0 +1,174 @@
+/*!
+ * \file rules.h
+ *
+ * \brief Game rules, independent from terminal and timing.
+ *
+ * The ball and ai coroutines of the game and the headless simulators share
+ * these routines, so every front-end plays by exactly the same rules.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#define TIME_GAP_BALL 25000 /*!< time in us between ball position update */
+#define TIME_GAP_AI 25000 /*!< time in us between ai position update */
+#define FIELD_TOP 0 /*!< top row for the playing field */
+#define AI_COL 1 /*!< column for the ai paddle */
+#define PADDLE_WIDTH 5 /*!< width of the paddles, must be an odd number */
+
+#define MAX_HITCNT 1 /*!< max hit count of each level */
+#define MAX_LEVEL 3 /*!< max number of game levels */
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b)) /*!< return maximum of 2 values */
+#define MIN(a,b) ((a) < (b) ? (a) : (b)) /*!< return minimum of 2 values */
+
+/*! time in us between ball position updates at the given level */
+#define BALL_DELAY(level) (TIME_GAP_BALL * (MAX_LEVEL - 1 - (level)))
+
+/*! max number of ai moves between two ball steps */
+#define AI_MAX_CATCHUP (BALL_DELAY(0) / TIME_GAP_AI + 1)
+
+#define BALL_WALL 1 /*!< ball bounced on field top or bottom */
+#define BALL_HIT_PLAYER 2 /*!< ball bounced on the player paddle */
+#define BALL_HIT_AI 4 /*!< ball bounced on the ai paddle */
+#define BALL_LEVEL_UP 8 /*!< the player hit cleared a level */
+#define BALL_PLAYER_WINS 16 /*!< ai missed the ball or last level cleared */
+#define BALL_AI_WINS 32 /*!< player missed the ball */
+#define BALL_OVER (BALL_PLAYER_WINS | BALL_AI_WINS) /*!< match ended */
+/*! the ball changed direction */
+#define BALL_TURN (BALL_WALL | BALL_HIT_PLAYER | BALL_HIT_AI)
+
+/*!
+ * State of a single match
+ */
+typedef struct {
+    int paddle_pos; /*!< player paddle's current vertical position */
+    int paddle_col; /*!< player paddle's column */
+    int ai_paddle_pos; /*!< ai paddle's current position */
+    int ai_paddle_col; /*!< ai paddle's column */
+    int ball_x; /*!< current ball x (column) coord */
+    int ball_y; /*!< current ball y (row) coord */
+    int ball_dirx; /*!< current ball x speed component */
+    int ball_diry; /*!< current ball y speed component */
+    int bottom_row; /*!< last row of the gaming field */
+    int gameLevel; /*!< current game level (MAX_LEVEL) */
+    int hitCnt; /*!< hit count of the current game level (MAX_HITCNT) */
+    int ai_time; /*!< us accumulated toward the next ai move (headless) */
+    int ai_target; /*!< row aimed by the tuned ai */
+    int ai_wait; /*!< ai moves left before the tuned ai aims again */
+    unsigned rng; /*!< random state of the tuned ai, set by the caller */
+} match_state;
+
+/*!
+ * Difficulty parameters of the ai at one game level
+ */
+typedef struct {
+    int reaction; /*!< ai moves between two aims at the ball */
+    int error; /*!< max rows of error of an aim */
+    int speed; /*!< max rows moved at each ai move */
+} ai_level;
+
+/*! ai level playing as ai_step: aims at each move, exact, one row */
+#define AI_LEVEL_CHASE { 1, 0, 1 }
+
+/*!
+ * \brief Place paddles and ball for the serve.
+ *
+ * @param m match state
+ * @param rows number of rows of the field
+ * @param cols number of columns of the field
+ * @param diry initial vertical direction of the ball (1 or -1)
+ */
+void match_serve(match_state *m, int rows, int cols, int diry);
+
+/*!
+ * \brief Advance the ball by one position.
+ *
+ * @param m match state
+ * @return BALL_* flags describing what happened
+ */
+int ball_step(match_state *m);
+
+/*!
+ * \brief Move the ai paddle one row toward the ball.
+ *
+ * @param m match state
+ */
+void ai_step(match_state *m);
+
+/*!
+ * \brief Move the ai paddle as the tuned ai with the given parameters.
+ *
+ * Every reaction moves the ai aims at the current ball row, off by up to
+ * error rows, and then walks toward the aim by up to speed rows per move.
+ *
+ * @param m match state
+ * @param p parameters of the current level
+ */
+void ai_tuned_step(match_state *m, const ai_level *p);
+
+/*!
+ * \brief Return the row of the ball after some steps, bounces on the field
+ * top and bottom included.
+ *
+ * @param y ball row
+ * @param diry ball y speed component
+ * @param bottom_row last row of the field
+ * @param steps number of ball steps
+ */
+int ball_row_after(int y, int diry, int bottom_row, int steps);
+
+/*!
+ * \brief Return the ball steps up to the next one changing the direction of
+ * the ball (BALL_TURN) or ending the match.
+ *
+ * Until that step the ball moves in a straight line, one row and one
+ * column per step.
+ *
+ * @param m match state
+ * @return steps, 1 if the next step does
+ */
+int ball_turn_steps(const match_state *m);
+
+/*!
+ * \brief Move the ai paddle by one row, when possible.
+ *
+ * @param m match state
+ * @param dir -1 for up, 1 for down, 0 to stand still
+ */
+void ai_move(match_state *m, int dir);
+
+/*!
+ * \brief Advance a headless match by one ball step.
+ *
+ * The player paddle moves first, then the ball, then the ai moves once for
+ * every TIME_GAP_AI microseconds of BALL_DELAY at the current level, as the
+ * ball and ai coroutines of the game do.
+ *
+ * @param m match state
+ * @param dir player paddle move (see player_step)
+ * @return BALL_* flags of the ball step
+ */
+int match_step(match_state *m, int dir);
+
+/*!
+ * \brief Advance a headless match by one ball step, with the tuned ai.
+ *
+ * As match_step, with ai moves made by ai_tuned_step.
+ *
+ * @param m match state
+ * @param dir player paddle move (see player_step)
+ * @param levels parameters of the tuned ai, one per level up to MAX_LEVEL
+ * @return BALL_* flags of the ball step
+ */
+int match_step_tuned(match_state *m, int dir, const ai_level *levels);
+
+/*!
+ * \brief Move the player paddle by one row, when possible.
+ *
+ * @param m match state
+ * @param dir -1 for up, 1 for down, 0 to stand still
+ */
+void player_step(match_state *m, int dir);
+
+#endif
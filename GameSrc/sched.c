@@ -0,0 +1,290 @@
+/*!
+ * \file sched.c
+ *
+ * \brief This file implements the cooperative scheduler declared in sched.h.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <poll.h>
+#include <time.h>
+#include <string.h>
+#include "sched.h"
+
+static long long virtual_now = -1; /* virtual clock, -1 for real time */
+static int frame_fd = -1; /* frame tick descriptor of the frame clock */
+static long long frame_period; /* us of game time per frame */
+static long (*frame_count)(void *); /* frames elapsed on frame_fd */
+static void *frame_ctx; /* argument of frame_count */
+
+/*!
+ */
+long long sched_now(void)
+{
+    struct timespec ts;
+
+    if (virtual_now >= 0)
+        return virtual_now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*!
+ */
+void sched_virtual_clock(void)
+{
+    virtual_now = 0;
+}
+
+/*!
+ */
+void sched_frame_clock(int fd, long long period_us,
+        long (*frames)(void *ctx), void *ctx)
+{
+    virtual_now = 0;
+    frame_fd = fd;
+    frame_period = period_us;
+    frame_count = frames;
+    frame_ctx = ctx;
+}
+
+/*!
+ */
+void sched_init(scheduler *s)
+{
+    int i;
+
+    memset(s, 0, sizeof *s);
+    for (i = 0; i < SCHED_MAX_CO; ++i)
+        s->co[i].wait = CO_DONE;
+}
+
+/*!
+ * The new coroutine is placed in the first free slot, so coroutines are
+ * resumed in creation order within a scheduler pass.
+ */
+coroutine *sched_spawn(scheduler *s, int (*fn)(coroutine*), void *arg)
+{
+    int i;
+
+    for (i = 0; i < SCHED_MAX_CO; ++i)
+    {
+        if (s->co[i].wait == CO_DONE)
+        {
+            s->co[i].fn = fn;
+            s->co[i].arg = arg;
+            s->co[i].sched = s;
+            s->co[i].line = 0;
+            s->co[i].fd = -1;
+            s->co[i].wake_at = 0;
+            s->co[i].wait = CO_READY;
+            return &s->co[i];
+        }
+    }
+    return NULL;
+}
+
+/*!
+ */
+void sched_cancel(coroutine *co)
+{
+    co->wait = CO_DONE;
+}
+
+/*!
+ */
+void sched_wake(coroutine *co)
+{
+    if (co->wait == CO_WAIT_WAKE || co->wait == CO_WAIT_WAKE_TIMER)
+        co->wait = CO_READY;
+}
+
+/*!
+ */
+void sched_stop(scheduler *s)
+{
+    s->stop = 1;
+}
+
+/*!
+ * Account the lateness of a timer in the histogram.
+ */
+static void account(scheduler *s, long long late)
+{
+    int b = 0;
+
+    if (late > 0)
+        b = 64 - __builtin_clzll(late);
+    if (b > SCHED_HIST - 1)
+        b = SCHED_HIST - 1;
+    s->late[b]++;
+    s->timers++;
+    s->misses += late > SCHED_MISS_US;
+    if (late > s->max_late)
+        s->max_late = late;
+}
+
+/*!
+ */
+void sched_report(const scheduler *s, FILE *f)
+{
+    int i;
+
+    fprintf(f, "%ld timer ticks, %ld missed by more than %d us, "
+            "worst %lld us late\n", s->timers, s->misses, SCHED_MISS_US,
+            s->max_late);
+    for (i = 0; i < SCHED_HIST; ++i)
+    {
+        if (s->late[i] == 0)
+            continue;
+        if (i == 0)
+            fprintf(f, "  on time      %8ld\n", s->late[i]);
+        else if (i == SCHED_HIST - 1)
+            fprintf(f, "  >= %7ld us %8ld\n", 1L << (i - 1), s->late[i]);
+        else
+            fprintf(f, "  < %8ld us %8ld\n", 1L << i, s->late[i]);
+    }
+}
+
+/*!
+ * Resume a coroutine and store the state it suspended on.
+ */
+static void resume(coroutine *co)
+{
+    co->wait = co->fn(co);
+}
+
+/*!
+ * Every pass resumes the coroutines whose input is ready, then the expired
+ * timers, then the woken coroutines and the tick waiters. Between passes
+ * the thread sleeps in a single ppoll on all awaited descriptors, with the
+ * nearest deadline as timeout; no coroutine ever blocks the thread on its
+ * own. A tick is one such pass, so tick waiters run after every batch of
+ * events.
+ */
+void sched_run(scheduler *s)
+{
+    s->stop = 0;
+
+    while (!s->stop)
+    {
+        struct pollfd pfd[SCHED_MAX_CO + 1];
+        int owner[SCHED_MAX_CO]; /* coroutine slot for each pollfd */
+        int npfd = 0;
+        int alive = 0;
+        int ready = 0; /* some coroutine can run without waiting */
+        long long deadline = -1;
+        long long now;
+        int i;
+
+        /* collect what the suspended coroutines are waiting for */
+        for (i = 0; i < SCHED_MAX_CO; ++i)
+        {
+            coroutine *co = &s->co[i];
+
+            switch (co->wait)
+            {
+                case CO_READY:
+                    ready = 1;
+                    break;
+
+                case CO_WAIT_TICK:
+                case CO_WAIT_WAKE:
+                    /* ticks follow the passes and wakes come from other
+                     * coroutines, they never keep the thread awake on
+                     * their own */
+                    break;
+
+                case CO_WAIT_INPUT:
+                    pfd[npfd].fd = co->fd;
+                    pfd[npfd].events = POLLIN;
+                    pfd[npfd].revents = 0;
+                    owner[npfd++] = i;
+                    break;
+
+                case CO_WAIT_TIMER:
+                case CO_WAIT_WAKE_TIMER:
+                    if (deadline < 0 || co->wake_at < deadline)
+                        deadline = co->wake_at;
+                    break;
+
+                default:
+                    continue;
+            }
+            alive++;
+        }
+
+        if (!alive)
+            break;
+
+        /* the frame tick is polled last, after the input waiters */
+        if (frame_fd >= 0)
+        {
+            pfd[npfd].fd = frame_fd;
+            pfd[npfd].events = POLLIN;
+            pfd[npfd].revents = 0;
+        }
+
+        /* sleep until input or the nearest deadline */
+        now = sched_now();
+        if (ready || (deadline >= 0 && deadline <= now))
+        {
+            if (npfd || frame_fd >= 0)
+                poll(pfd, npfd + (frame_fd >= 0), 0);
+        } else if (frame_fd >= 0) {
+            /* frame clock: timers only expire on frames */
+            ppoll(pfd, npfd + 1, NULL, NULL);
+            s->wakeups++;
+        } else if (virtual_now >= 0 && deadline >= 0) {
+            /* virtual time: check input, then jump to the deadline */
+            if (npfd == 0 || poll(pfd, npfd, 0) == 0)
+                virtual_now = deadline;
+            s->wakeups++;
+        } else {
+            struct timespec ts;
+            long long gap = deadline - now;
+
+            ts.tv_sec = gap / 1000000;
+            ts.tv_nsec = (gap % 1000000) * 1000;
+            ppoll(pfd, npfd, deadline < 0 ? NULL : &ts, NULL);
+            s->wakeups++;
+        }
+
+        /* a new frame moves the clock on */
+        if (frame_fd >= 0 && pfd[npfd].revents)
+            virtual_now += frame_count(frame_ctx) * frame_period;
+
+        /* input waiters */
+        for (i = 0; i < npfd && !s->stop; ++i)
+        {
+            coroutine *co = &s->co[owner[i]];
+
+            if (pfd[i].revents && co->wait == CO_WAIT_INPUT)
+                resume(co);
+        }
+
+        /* expired timers */
+        now = sched_now();
+        for (i = 0; i < SCHED_MAX_CO && !s->stop; ++i)
+        {
+            coroutine *co = &s->co[i];
+
+            if ((co->wait == CO_WAIT_TIMER || co->wait == CO_WAIT_WAKE_TIMER)
+                    && co->wake_at <= now)
+            {
+                account(s, now - co->wake_at);
+                resume(co);
+            }
+        }
+
+        /* new, woken and tick waiting coroutines */
+        for (i = 0; i < SCHED_MAX_CO && !s->stop; ++i)
+        {
+            coroutine *co = &s->co[i];
+
+            if (co->wait == CO_READY || co->wait == CO_WAIT_TICK)
+                resume(co);
+        }
+    }
+}
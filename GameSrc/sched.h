@@ -0,0 +1,211 @@
+/*!
+ * \file sched.h
+ *
+ * \brief Cooperative scheduler for the game actors.
+ *
+ * Actors (ball, ai, keyboard, signal listener and the game controller) are
+ * stackless coroutines multiplexed on a single thread. A coroutine body is
+ * an ordinary function wrapped in CO_BEGIN/CO_END; it suspends itself with
+ * one of the await primitives and is resumed by the scheduler when the
+ * awaited condition holds:
+ *
+ *  - CO_AWAIT_TICK(co)       resume on the next scheduler pass
+ *  - CO_AWAIT_INPUT(co, fd)  resume when fd becomes readable
+ *  - CO_AWAIT_TIMER(co, us)  resume after us microseconds
+ *  - CO_AWAIT_UNTIL(co, at)  resume at the sched_now() timestamp at
+ *  - CO_AWAIT_WAKE(co)       resume when another coroutine calls sched_wake
+ *  - CO_AWAIT_WAKE_UNTIL(co, at)
+ *                            resume on sched_wake or at the timestamp at,
+ *                            whichever comes first
+ *
+ * The thread only wakes up when some awaited condition can hold: timers
+ * with the same deadline expire in the same wakeup, none before its
+ * deadline, and the scheduler counts its wakeups so that idle power can
+ * be measured.
+ * It also keeps a histogram of how late timers are resumed, to account for
+ * ticks that missed their deadline.
+ *
+ * Every timestamp and timer goes through sched_now(), which can be switched
+ * to a virtual clock: time then stands still while any coroutine can run
+ * and jumps to the nearest deadline when all of them wait, so a game runs
+ * as fast as its slowest step allows. It can also be switched to a frame
+ * clock, that only advances by whole frames when a frame tick descriptor
+ * (tick.h) becomes readable, locking every timer to the display refresh.
+ *
+ * Being stackless, a coroutine does not keep its local variables across an
+ * await: any state that must survive a suspension lives in the structure
+ * passed as argument. Two awaits must not share the same source line.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdio.h>
+
+#define SCHED_MAX_CO 8 /*!< max number of coroutines in a scheduler */
+#define SCHED_MISS_US 1000 /*!< timer lateness counted as a missed tick */
+#define SCHED_HIST 18 /*!< buckets of the timer lateness histogram */
+
+#define CO_READY 0 /*!< coroutine is runnable */
+#define CO_WAIT_TICK 1 /*!< coroutine waits for the next scheduler pass */
+#define CO_WAIT_INPUT 2 /*!< coroutine waits for a readable descriptor */
+#define CO_WAIT_TIMER 3 /*!< coroutine waits for a deadline */
+#define CO_DONE 4 /*!< coroutine has terminated, slot is free */
+#define CO_WAIT_WAKE 5 /*!< coroutine waits for sched_wake */
+#define CO_WAIT_WAKE_TIMER 6 /*!< coroutine waits for a wake or a deadline */
+
+struct scheduler;
+
+/*!
+ * Coroutine control block
+ */
+typedef struct coroutine {
+    int (*fn)(struct coroutine*); /*!< body, returns the new wait state */
+    void *arg; /*!< argument shared with the body */
+    struct scheduler *sched; /*!< owning scheduler */
+    int line; /*!< resume point inside the body */
+    int wait; /*!< what the coroutine is waiting for (CO_* state) */
+    int fd; /*!< descriptor awaited in CO_WAIT_INPUT state */
+    long long wake_at; /*!< deadline (us) awaited in CO_WAIT_TIMER state, or
+                         in CO_WAIT_WAKE_TIMER state */
+} coroutine;
+
+/*!
+ * Single threaded scheduler
+ */
+typedef struct scheduler {
+    coroutine co[SCHED_MAX_CO]; /*!< coroutine slots */
+    int stop; /*!< non-zero makes sched_run return */
+    long wakeups; /*!< times the thread woke up from sleep */
+    long timers; /*!< timers resumed */
+    long misses; /*!< timers resumed more than SCHED_MISS_US late */
+    long long max_late; /*!< worst timer lateness (us) */
+    /*! timers by lateness: bucket 0 on time, bucket i late by less than
+     * 2^i us, the last one by more */
+    long late[SCHED_HIST];
+} scheduler;
+
+/*! start of a coroutine body */
+#define CO_BEGIN(co) switch ((co)->line) { case 0:
+
+/*! end of a coroutine body, the coroutine terminates */
+#define CO_END(co) } (co)->line = -1; return CO_DONE
+
+/*! terminate the coroutine from inside its body */
+#define CO_RETURN(co) do { (co)->line = -1; return CO_DONE; } while (0)
+
+/*! suspend with the given wait state, resume right after */
+#define CO_YIELD(co, state) \
+    do { (co)->line = __LINE__; return (state); case __LINE__:; } while (0)
+
+/*! suspend until the next scheduler pass */
+#define CO_AWAIT_TICK(co) CO_YIELD(co, CO_WAIT_TICK)
+
+/*! suspend until the descriptor is readable */
+#define CO_AWAIT_INPUT(co, desc) \
+    do { (co)->fd = (desc); CO_YIELD(co, CO_WAIT_INPUT); } while (0)
+
+/*! suspend for the given amount of microseconds */
+#define CO_AWAIT_TIMER(co, us) \
+    do { \
+        (co)->wake_at = sched_now() + (us); \
+        CO_YIELD(co, CO_WAIT_TIMER); \
+    } while (0)
+
+/*! suspend until the given sched_now() timestamp */
+#define CO_AWAIT_UNTIL(co, at) \
+    do { (co)->wake_at = (at); CO_YIELD(co, CO_WAIT_TIMER); } while (0)
+
+/*! suspend until another coroutine calls sched_wake */
+#define CO_AWAIT_WAKE(co) CO_YIELD(co, CO_WAIT_WAKE)
+
+/*! suspend until another coroutine calls sched_wake or until the given
+ * sched_now() timestamp, whichever comes first */
+#define CO_AWAIT_WAKE_UNTIL(co, at) \
+    do { (co)->wake_at = (at); CO_YIELD(co, CO_WAIT_WAKE_TIMER); } while (0)
+
+/*!
+ * \brief Return a monotonic timestamp in microseconds.
+ */
+long long sched_now(void);
+
+/*!
+ * \brief Switch sched_now() to a virtual clock starting at zero.
+ *
+ * Instead of sleeping, sched_run advances the virtual clock to the nearest
+ * deadline; awaited descriptors are still polled, but only wait in real
+ * time when no timer is pending. Call before any timestamp is taken.
+ */
+void sched_virtual_clock(void);
+
+/*!
+ * \brief Switch sched_now() to a frame clock starting at zero.
+ *
+ * The clock advances by period_us for every frame reported by frames when
+ * fd becomes readable; timers are resumed on the first frame at or after
+ * their deadline. Call before any timestamp is taken.
+ *
+ * @param fd descriptor readable when new frames have elapsed
+ * @param period_us game time of a frame
+ * @param frames return the frames elapsed, consuming the fd readiness
+ * @param ctx argument of frames
+ */
+void sched_frame_clock(int fd, long long period_us,
+        long (*frames)(void *ctx), void *ctx);
+
+/*!
+ * \brief Initialize an empty scheduler.
+ *
+ * @param s scheduler
+ */
+void sched_init(scheduler *s);
+
+/*!
+ * \brief Create a new coroutine; it runs at the next scheduler pass.
+ *
+ * @param s scheduler
+ * @param fn coroutine body
+ * @param arg argument shared with the body
+ * @return the coroutine, NULL if there are no free slots
+ */
+coroutine *sched_spawn(scheduler *s, int (*fn)(coroutine*), void *arg);
+
+/*!
+ * \brief Terminate a suspended coroutine and free its slot.
+ *
+ * @param co coroutine
+ */
+void sched_cancel(coroutine *co);
+
+/*!
+ * \brief Make a coroutine suspended in CO_AWAIT_WAKE or
+ * CO_AWAIT_WAKE_UNTIL runnable in the current scheduler pass; coroutines
+ * waiting for anything else are left alone.
+ *
+ * @param co coroutine
+ */
+void sched_wake(coroutine *co);
+
+/*!
+ * \brief Run coroutines until sched_stop is called or none is left.
+ *
+ * @param s scheduler
+ */
+void sched_run(scheduler *s);
+
+/*!
+ * \brief Print the timer lateness statistics.
+ *
+ * @param s scheduler
+ * @param f output stream
+ */
+void sched_report(const scheduler *s, FILE *f);
+
+/*!
+ * \brief Ask the scheduler to return from sched_run.
+ *
+ * @param s scheduler
+ */
+void sched_stop(scheduler *s);
+
+#endif
@@ -0,0 +1,351 @@
+/*!
+ * \file scores.c
+ *
+ * \brief This file implements the high-score store declared in scores.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include "scores.h"
+
+/*! bytes of a checkpoint covered by its CRC */
+#define TABLE_CRC_LEN \
+    (offsetof(score_table, top) + SCORE_TOP * sizeof(lb_result) \
+     - offsetof(score_table, seq))
+
+/*!
+ * CRC-32 (IEEE) of a buffer, bit by bit: the store checks a few pages at
+ * startup and a record per game, no table is worth it.
+ */
+static uint32_t crc32(const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    uint32_t crc = 0xffffffff;
+    int i;
+
+    while (len--)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+            crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+/*!
+ * Build the path of the store file, return -1 if there's no home.
+ */
+static int score_path(char *path, size_t size)
+{
+    const char *xdg = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    int n;
+
+    if (xdg && *xdg)
+        n = snprintf(path, size, "%s", xdg);
+    else if (home && *home)
+    {
+        n = snprintf(path, size, "%s/.local", home);
+        if (n > 0 && (size_t) n < size)
+            mkdir(path, 0755); /* usually there already */
+        n = snprintf(path, size, "%s/.local/share", home);
+    }
+    else
+        return -1;
+    if (n < 0 || (size_t) n >= size)
+        return -1;
+    mkdir(path, 0755);
+    size -= n;
+    n = snprintf(path + n, size, "/%s", SCORE_FILE);
+    return n < 0 || (size_t) n >= size ? -1 : 0;
+}
+
+/*!
+ * Ranks game a before game b: score, then level, then rally.
+ */
+static int better(const lb_result *a, const lb_result *b)
+{
+    if (a->score != b->score)
+        return a->score > b->score;
+    if (a->level != b->level)
+        return a->level > b->level;
+    return a->rally > b->rally;
+}
+
+/*!
+ * Counts a game in the table.
+ */
+static void apply(score_table *t, const lb_result *r, int won)
+{
+    int i;
+
+    t->stats.games++;
+    t->stats.won += !!won;
+    t->stats.hits += r->score;
+    if (r->level > t->stats.level)
+        t->stats.level = r->level;
+    if (r->rally > t->stats.rally)
+        t->stats.rally = r->rally;
+
+    if (t->count == SCORE_TOP && !better(r, &t->top[SCORE_TOP - 1]))
+        return;
+    if (t->count < SCORE_TOP)
+        t->count++;
+    for (i = t->count - 1; i > 0 && better(r, &t->top[i - 1]); i--)
+        t->top[i] = t->top[i - 1];
+    t->top[i] = *r;
+}
+
+/*!
+ */
+static int table_valid(const score_table *t)
+{
+    return t->magic == SCORE_MAGIC && t->count >= 0 && t->count <= SCORE_TOP
+        && t->crc == crc32(&t->seq, TABLE_CRC_LEN);
+}
+
+/*!
+ */
+static int record_valid(const score_record *r, uint64_t index)
+{
+    return r->index == index
+        && r->crc == crc32(&r->won, sizeof *r - offsetof(score_record, won));
+}
+
+/*!
+ * Writes the table to the older checkpoint, once the records it covers
+ * are on disk, and syncs it: until then the newer checkpoint and its
+ * records stand.
+ */
+static void checkpoint(score_store *s)
+{
+    score_table *t;
+
+    fdatasync(s->fd);
+    s->table.magic = SCORE_MAGIC;
+    s->table.seq++;
+    s->table.applied = s->next;
+    s->table.crc = crc32(&s->table.seq, TABLE_CRC_LEN);
+    t = &s->map->table[s->table.seq % 2].t;
+    memcpy(t, &s->table, sizeof *t);
+    fdatasync(s->fd);
+    s->checkpointed = s->next;
+    s->syncs += 2;
+    s->checkpoints++;
+}
+
+/*!
+ * Appends the queued games to the log, checkpointing every
+ * SCORE_CHECKPOINT games, and returns the games appended.
+ */
+static int drain(score_store *s)
+{
+    unsigned long tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&s->head, memory_order_acquire);
+    const score_game *g;
+    score_record *r;
+    int n = 0;
+
+    for (; tail != head; tail++, n++)
+    {
+        if (s->next - s->checkpointed >= SCORE_CHECKPOINT)
+            checkpoint(s);
+        g = &s->queue[tail % SCORE_QUEUE];
+        r = &s->map->log[s->next % SCORE_LOG].r;
+        r->won = g->won;
+        r->index = s->next;
+        r->result = g->result;
+        r->crc = crc32(&r->won, sizeof *r - offsetof(score_record, won));
+        apply(&s->table, &g->result, g->won);
+        s->next++;
+        atomic_store_explicit(&s->tail, tail + 1, memory_order_release);
+    }
+    return n;
+}
+
+/*!
+ * Syncs after every batch of games, so a game is on disk a sync after it
+ * ended; the last games are checkpointed on the way out.
+ */
+static void *store_thread(void *arg)
+{
+    score_store *s = arg;
+    uint64_t wakes;
+    int stop;
+
+    do
+    {
+        if (read(s->wake_fd, &wakes, sizeof wakes) < 0 && errno != EINTR)
+            break;
+        stop = atomic_load(&s->stop);
+        if (drain(s))
+        {
+            fdatasync(s->fd);
+            s->syncs++;
+        }
+    } while (!stop);
+    drain(s);
+    if (s->next != s->checkpointed)
+        checkpoint(s);
+    return NULL;
+}
+
+/*!
+ * Loading is a lookup, not a parse: the newer valid checkpoint is copied
+ * out of the mapping as it is, then the few records after it are applied.
+ */
+int score_open(score_store *s, const char *path)
+{
+    char def[512];
+    struct stat st;
+    const score_table *t;
+    sigset_t all, old;
+    int i, err;
+
+    memset(s, 0, sizeof *s);
+    s->fd = -1;
+    s->wake_fd = -1;
+    atomic_init(&s->stop, 0);
+    atomic_init(&s->head, 0);
+    atomic_init(&s->tail, 0);
+    if (path == NULL)
+    {
+        if (score_path(def, sizeof def) != 0)
+        {
+            errno = ENOENT;
+            return -1;
+        }
+        path = def;
+    }
+
+    s->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (s->fd < 0
+            || flock(s->fd, LOCK_EX | LOCK_NB) != 0
+            || fstat(s->fd, &st) != 0
+            || (st.st_size < (off_t) sizeof *s->map
+                && ftruncate(s->fd, sizeof *s->map) != 0))
+        goto fail;
+    s->map = mmap(NULL, sizeof *s->map, PROT_READ | PROT_WRITE, MAP_SHARED,
+            s->fd, 0);
+    if (s->map == MAP_FAILED)
+    {
+        s->map = NULL;
+        goto fail;
+    }
+
+    /* newer valid checkpoint, then the log after it */
+    for (i = 0; i < 2; i++)
+    {
+        t = &s->map->table[i].t;
+        if (table_valid(t) && (s->table.magic == 0 || t->seq > s->table.seq))
+            memcpy(&s->table, t, sizeof *t);
+    }
+    s->next = s->checkpointed = s->table.applied;
+    while (record_valid(&s->map->log[s->next % SCORE_LOG].r, s->next)
+            && s->next - s->checkpointed < SCORE_LOG)
+    {
+        apply(&s->table, &s->map->log[s->next % SCORE_LOG].r.result,
+                s->map->log[s->next % SCORE_LOG].r.won);
+        s->next++;
+        s->replayed++;
+    }
+
+    s->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (s->wake_fd < 0)
+        goto fail;
+
+    /* the thread blocks every signal, so that they all reach the game:
+     * ncurses would _exit on it and a resize would be lost */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    err = pthread_create(&s->thread, NULL, store_thread, s);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err == 0)
+        return 0;
+    errno = err;
+
+fail:
+    err = errno;
+    if (s->map)
+        munmap(s->map, sizeof *s->map);
+    if (s->wake_fd >= 0)
+        close(s->wake_fd);
+    if (s->fd >= 0)
+        close(s->fd);
+    s->map = NULL;
+    s->fd = s->wake_fd = -1;
+    errno = err;
+    return -1;
+}
+
+/*!
+ * The eventfd only wakes the store thread: it is written without waiting,
+ * and several games coalesce in a single wake up.
+ */
+int score_add(score_store *s, const lb_result *r, int won)
+{
+    unsigned long head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    uint64_t one = 1;
+
+    if (head - atomic_load_explicit(&s->tail, memory_order_acquire)
+            >= SCORE_QUEUE)
+    {
+        s->dropped++;
+        return -1;
+    }
+    s->queue[head % SCORE_QUEUE].result = *r;
+    s->queue[head % SCORE_QUEUE].won = !!won;
+    atomic_store_explicit(&s->head, head + 1, memory_order_release);
+
+    /* the counter of the eventfd can't fill up: the write never waits */
+    return write(s->wake_fd, &one, sizeof one) == sizeof one ? 0 : -1;
+}
+
+/*!
+ */
+void score_close(score_store *s)
+{
+    uint64_t one = 1;
+
+    if (s->fd < 0)
+        return;
+    atomic_store(&s->stop, 1);
+    if (write(s->wake_fd, &one, sizeof one) == sizeof one)
+        pthread_join(s->thread, NULL);
+    munmap(s->map, sizeof *s->map);
+    close(s->wake_fd);
+    close(s->fd);
+    s->map = NULL;
+    s->fd = s->wake_fd = -1;
+}
+
+/*!
+ */
+void score_report(const score_store *s, FILE *out)
+{
+    const score_stats *st = &s->table.stats;
+    int i;
+
+    fprintf(out, "scores: %llu games, %llu won, %llu hits, level %d, "
+            "rally %d\n", (unsigned long long) st->games,
+            (unsigned long long) st->won, (unsigned long long) st->hits,
+            st->level, st->rally);
+    for (i = 0; i < s->table.count; i++)
+        fprintf(out, "best %d: score %d, level %d, rally %d\n", i + 1,
+                s->table.top[i].score, s->table.top[i].level,
+                s->table.top[i].rally);
+    fprintf(out, "store: %ld games replayed, %ld syncs, %ld checkpoints, "
+            "%ld dropped\n", s->replayed, s->syncs, s->checkpoints,
+            s->dropped);
+}
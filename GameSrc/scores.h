@@ -0,0 +1,167 @@
+/*!
+ * \file scores.h
+ *
+ * \brief High scores and statistics of the player, kept across runs.
+ *
+ * The store is a file of fixed layout, mapped in memory: two checkpoints
+ * of the whole table (statistics and best games, score_table) and a ring
+ * of SCORE_LOG log records, one per sector, each holding one game. A game
+ * is appended to the log; every SCORE_CHECKPOINT games the table is
+ * written to the older checkpoint, which then becomes the newer one.
+ *
+ * Checkpoints and records carry a CRC, and records carry their position
+ * in the log, so that a write torn by a power loss is recognised: loading
+ * takes the valid checkpoint with the highest sequence number, as it is
+ * in the file, and applies the records that follow it, up to the first
+ * one missing or torn. A checkpoint is only written once the records it
+ * covers are on disk, and the records after the other checkpoint are not
+ * overwritten before it is, so a power loss at any point loses at most the
+ * games not synced yet.
+ *
+ * The game only queues its results in memory (score_add): a thread of the
+ * store writes them to the file and syncs it, so the game never waits for
+ * the disk, not even for a page under writeback.
+ *
+ * The file is $XDG_DATA_HOME/pong-scores, or ~/.local/share/pong-scores.
+ * It is locked while in use: a second game running at the same time, as
+ * the games of socket mode, plays without a store.
+ */
+
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "leaderboard.h"
+
+#define SCORE_FILE "pong-scores" /*!< name of the store file */
+#define SCORE_MAGIC 0x31534850 /*!< "PHS1", first bytes of a checkpoint */
+#define SCORE_TOP 10 /*!< best games kept */
+#define SCORE_LOG 256 /*!< records of the log ring */
+#define SCORE_CHECKPOINT 64 /*!< games between two checkpoints */
+#define SCORE_SECTOR 512 /*!< bytes of a log record, a disk sector */
+#define SCORE_PAGE 4096 /*!< bytes of a checkpoint */
+#define SCORE_QUEUE 64 /*!< games queued for the store thread */
+
+/*!
+ * Statistics of all the games
+ */
+typedef struct {
+    uint64_t games; /*!< games played */
+    uint64_t won; /*!< games won */
+    uint64_t hits; /*!< player paddle hits */
+    int32_t level; /*!< highest level reached */
+    int32_t rally; /*!< longest rally */
+} score_stats;
+
+/*!
+ * Checkpoint of the store, as in the file
+ */
+typedef struct {
+    uint32_t magic; /*!< SCORE_MAGIC */
+    uint32_t crc; /*!< CRC-32 of the rest of the checkpoint */
+    uint64_t seq; /*!< checkpoints written before this one */
+    uint64_t applied; /*!< log records included */
+    score_stats stats; /*!< statistics */
+    int32_t count; /*!< best games kept */
+    lb_result top[SCORE_TOP]; /*!< best games, best first */
+} score_table;
+
+/*!
+ * Game of the log, as in the file
+ */
+typedef struct {
+    uint32_t crc; /*!< CRC-32 of the rest of the record */
+    uint32_t won; /*!< 1 if the player won */
+    uint64_t index; /*!< position in the log, from 0 */
+    lb_result result; /*!< result of the game */
+} score_record;
+
+/*!
+ * Layout of the store file
+ */
+typedef struct {
+    union {
+        score_table t; /*!< checkpoint */
+        char pad[SCORE_PAGE]; /*!< a checkpoint per page */
+    } table[2]; /*!< the two checkpoints, written in turn */
+    union {
+        score_record r; /*!< game */
+        char pad[SCORE_SECTOR]; /*!< a record per sector */
+    } log[SCORE_LOG]; /*!< ring of the games after the checkpoints */
+} score_file;
+
+/*!
+ * Game queued for the store thread
+ */
+typedef struct {
+    lb_result result; /*!< result of the game */
+    int won; /*!< 1 if the player won */
+} score_game;
+
+/*!
+ * Open store
+ */
+typedef struct {
+    int fd; /*!< store file, -1 when closed */
+    score_file *map; /*!< mapping of the file */
+    score_table table; /*!< loaded table, then kept by the store thread */
+    uint64_t next; /*!< next log position, by the store thread */
+    uint64_t checkpointed; /*!< log records in the newer checkpoint */
+    int wake_fd; /*!< eventfd waking the store thread */
+    pthread_t thread; /*!< store thread */
+    atomic_int stop; /*!< asks the store thread to end */
+    _Alignas(64) atomic_ulong head; /*!< games queued, by the game */
+    long dropped; /*!< games lost on a full queue, by the game */
+    _Alignas(64) atomic_ulong tail; /*!< games taken, by the store thread */
+    score_game queue[SCORE_QUEUE]; /*!< games queued */
+    long replayed; /*!< log records applied at load */
+    long syncs; /*!< file syncs, by the store thread */
+    long checkpoints; /*!< checkpoints written, by the store thread */
+} score_store;
+
+/*!
+ * \brief Load the store and start its thread.
+ *
+ * The file is created if missing. Once open, s->table holds the scores
+ * loaded, until the store thread takes it over with the first game. The
+ * thread blocks all signals.
+ *
+ * @param s store
+ * @param path store file, NULL for the default one
+ * @return 0, -1 with errno set (EWOULDBLOCK if another game has it)
+ */
+int score_open(score_store *s, const char *path);
+
+/*!
+ * \brief Queue the result of a game, never waiting.
+ *
+ * @param s store
+ * @param r result
+ * @param won 1 if the player won
+ * @return 0, -1 if the queue is full and the game is lost, or if the
+ * store thread can't be woken and the game waits for the next one
+ */
+int score_add(score_store *s, const lb_result *r, int won);
+
+/*!
+ * \brief Write the queued games, checkpoint and close the store.
+ *
+ * s->table is left with the final scores. Closing a closed store does
+ * nothing.
+ *
+ * @param s store
+ */
+void score_close(score_store *s);
+
+/*!
+ * \brief Print the scores and the activity of a closed store.
+ *
+ * @param s store
+ * @param out output stream
+ */
+void score_report(const score_store *s, FILE *out);
+
+#endif
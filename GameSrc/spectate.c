@@ -0,0 +1,477 @@
+/*!
+ * \file spectate.c
+ *
+ * \brief This file implements the spectator fan-out declared in
+ * spectate.h.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "sched.h"
+#include "spectate.h"
+
+/*!
+ * Take an unused buffer, with one reference for the caller.
+ */
+static spec_buf *buf_get(spectators *sp)
+{
+    spec_buf *b = sp->free;
+
+    if (b)
+        sp->free = b->next;
+    else if ((b = malloc(sizeof *b)) == NULL)
+    {
+        perror("allocation error");
+        exit(EXIT_FAILURE);
+    }
+    b->refs = 1;
+    b->len = 0;
+    return b;
+}
+
+/*!
+ * Release a reference, the last one gives the buffer back.
+ */
+static void buf_put(spectators *sp, spec_buf *b)
+{
+    if (--b->refs > 0)
+        return;
+    b->next = sp->free;
+    sp->free = b;
+}
+
+/*!
+ * Return the keyframe of the end of the log, NULL while the wire output
+ * holds messages not published yet.
+ */
+static spec_buf *keyframe(spectators *sp)
+{
+    if (sp->key == NULL && sp->wire->len == 0)
+    {
+        sp->key = buf_get(sp);
+        sp->key->len = wire_keyframe(sp->wire, sp->key->data);
+    }
+    return sp->key;
+}
+
+/*!
+ * Register the socket of a spectator for writability, or stop.
+ */
+static void watch(spectators *sp, spectator *s, int out)
+{
+    struct epoll_event ev;
+
+    if (s->polled == out)
+        return;
+    ev.events = EPOLLIN | EPOLLRDHUP | (out ? EPOLLOUT : 0);
+    ev.data.ptr = s;
+    epoll_ctl(sp->epoll_fd, EPOLL_CTL_MOD, s->fd, &ev);
+    s->polled = out;
+}
+
+/*!
+ * Disconnect a spectator.
+ */
+static void drop(spectators *sp, spectator *s)
+{
+    if (s->part)
+        buf_put(sp, s->part);
+    close(s->fd); /* leaves the epoll set too */
+
+    /* the last spectator takes the free slot */
+    sp->list[s->slot] = sp->list[--sp->count];
+    sp->list[s->slot]->slot = s->slot;
+    free(s);
+}
+
+/*!
+ * Keep the rest of a buffer the socket took in part.
+ */
+static void keep_part(spectator *s, spec_buf *b, size_t off)
+{
+    b->refs++;
+    s->part = b;
+    s->part_off = off;
+}
+
+/*!
+ * Send a spectator, in one call, the buffer it sent in part, the keyframe
+ * it waits for and the flushes of the log it hasn't got.
+ *
+ * @return 1 if it is still behind only because of SPEC_IOV, 0 if it is up
+ * to date or its socket is full, -1 if it was dropped
+ */
+static int serve(spectators *sp, spectator *s)
+{
+    struct iovec iov[SPEC_IOV + 2];
+    struct msghdr msg = { 0 };
+    spec_buf *key = NULL;
+    long long seq, last;
+    size_t offered = 0, len;
+    ssize_t n;
+    int i = 0;
+
+    /* too far behind: a keyframe replaces what it missed */
+    if (!s->resync && s->seq < sp->head && (sp->head - s->seq > SPEC_LOG
+                || sp->total - sp->log_at[s->seq % SPEC_LOG]
+                > SPEC_QUEUE_MAX))
+    {
+        s->resync = 1;
+        sp->downgrades++;
+    }
+
+    if (s->part)
+    {
+        iov[i].iov_base = s->part->data + s->part_off;
+        iov[i++].iov_len = s->part->len - s->part_off;
+    }
+    seq = last = s->seq;
+    if (s->resync && (key = keyframe(sp)) != NULL)
+    {
+        iov[i].iov_base = key->data;
+        iov[i++].iov_len = key->len;
+        seq = last = sp->head;
+    }
+    if (!s->resync || key)
+        for (; last < sp->head && i < SPEC_IOV + 2; ++last, ++i)
+        {
+            iov[i].iov_base = sp->log[last % SPEC_LOG]->data;
+            iov[i].iov_len = sp->log[last % SPEC_LOG]->len;
+        }
+    if (i == 0)
+    {
+        if (s->resync)
+            return 1; /* for a keyframe */
+        s->stalled = 0;
+        watch(sp, s, 0);
+        return 0;
+    }
+
+    msg.msg_iov = iov;
+    msg.msg_iovlen = i;
+    for (i = 0; i < (int) msg.msg_iovlen; ++i)
+        offered += iov[i].iov_len;
+    n = sendmsg(s->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    sp->sends++;
+    if (n < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        drop(sp, s);
+        return -1;
+    }
+    n = n < 0 ? 0 : n;
+    sp->sent += n;
+
+    /* move on by what the socket took, in the order offered */
+    len = n;
+    if (s->part)
+    {
+        if (len < s->part->len - s->part_off)
+        {
+            s->part_off += len;
+            len = 0;
+            key = NULL;
+            last = s->seq; /* nothing else went */
+        } else {
+            len -= s->part->len - s->part_off;
+            buf_put(sp, s->part);
+            s->part = NULL;
+        }
+    }
+    if (key && (len > 0 || key->len == 0))
+    {
+        if (len < key->len)
+            keep_part(s, key, len);
+        len -= len < key->len ? len : key->len;
+        s->resync = 0;
+        s->seq = seq;
+    }
+    for (; !s->resync && s->seq < last && len > 0; ++s->seq)
+    {
+        spec_buf *b = sp->log[s->seq % SPEC_LOG];
+
+        if (len < b->len)
+            keep_part(s, b, len);
+        len -= len < b->len ? len : b->len;
+    }
+
+    if (s->part == NULL && !s->resync && s->seq == sp->head)
+    {
+        s->stalled = 0;
+        watch(sp, s, 0);
+        return 0;
+    }
+    if ((size_t) n == offered)
+        return 1;
+
+    /* the socket is full: wait for it to drain */
+    if (!s->stalled)
+        s->stalled = sched_now();
+    watch(sp, s, 1);
+    return 0;
+}
+
+/*!
+ * Accept the pending connections; each new spectator waits for a
+ * keyframe.
+ */
+static void accept_all(spectators *sp)
+{
+    struct epoll_event ev;
+    spectator *s;
+    int fd;
+
+    while ((fd = accept4(sp->listen_fd, NULL, NULL,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        if (sp->count == sp->cap)
+        {
+            int cap = sp->cap ? 2 * sp->cap : 64;
+            spectator **list = realloc(sp->list, cap * sizeof *list);
+
+            if (list == NULL)
+            {
+                close(fd);
+                return;
+            }
+            sp->list = list;
+            sp->cap = cap;
+        }
+        s = calloc(1, sizeof *s);
+        if (s == NULL)
+        {
+            close(fd);
+            return;
+        }
+        s->fd = fd;
+        s->slot = sp->count;
+        s->seq = sp->head;
+        s->resync = 1;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = s;
+        if (epoll_ctl(sp->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            free(s);
+            continue;
+        }
+        sp->list[sp->count++] = s;
+        sp->joined++;
+    }
+}
+
+/*!
+ */
+int spec_open(spectators *sp, const char *path, wire_out *w)
+{
+    struct sockaddr_un addr = { 0 };
+    struct epoll_event ev, wake;
+
+    memset(sp, 0, sizeof *sp);
+    sp->listen_fd = sp->epoll_fd = sp->wake_fd = -1;
+    if (strlen(path) >= sizeof addr.sun_path)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    sp->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK
+            | SOCK_CLOEXEC, 0);
+    sp->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    sp->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.events = wake.events = EPOLLIN;
+    ev.data.ptr = &sp->listen_fd;
+    wake.data.ptr = &sp->wake_fd;
+    if (sp->listen_fd < 0 || sp->epoll_fd < 0 || sp->wake_fd < 0
+            || bind(sp->listen_fd, (struct sockaddr *) &addr,
+                sizeof addr) != 0
+            || listen(sp->listen_fd, SOMAXCONN) != 0
+            || epoll_ctl(sp->epoll_fd, EPOLL_CTL_ADD, sp->listen_fd,
+                &ev) != 0
+            || epoll_ctl(sp->epoll_fd, EPOLL_CTL_ADD, sp->wake_fd,
+                &wake) != 0)
+    {
+        int err = errno;
+
+        spec_close(sp);
+        errno = err;
+        return -1;
+    }
+    sp->path = path;
+    sp->wire = w;
+    w->tap = spec_publish;
+    w->tap_ctx = sp;
+    return 0;
+}
+
+/*!
+ */
+void spec_publish(void *ctx, const unsigned char *buf, size_t len)
+{
+    spectators *sp = ctx;
+    spec_buf *b = buf_get(sp);
+    int q = sp->head % SPEC_LOG;
+
+    memcpy(b->data, buf, len);
+    b->len = len;
+    if (sp->log[q])
+        buf_put(sp, sp->log[q]);
+    sp->log[q] = b;
+    sp->log_at[q] = sp->total;
+    sp->total += len;
+    sp->head++;
+    if (sp->key)
+    {
+        buf_put(sp, sp->key); /* the state moved on */
+        sp->key = NULL;
+    }
+
+    /* once per slice, the coroutine of spec_events has work */
+    if (!sp->kicked && sp->count > 0)
+    {
+        uint64_t one = 1;
+
+        sp->kicked = write(sp->wake_fd, &one, sizeof one) == sizeof one;
+    }
+}
+
+/*!
+ * The events come first, so that a slice doesn't send to spectators that
+ * are gone. A slice walks the spectators from where the last one stopped,
+ * skipping those up to date and those waiting for their socket to drain,
+ * which are disconnected when they waited too long.
+ */
+int spec_events(spectators *sp)
+{
+    struct epoll_event ev[SPEC_EVENTS];
+    long long now = sched_now();
+    char junk[256];
+    int i, n, served = 0, again = 0, scanned;
+
+    n = epoll_wait(sp->epoll_fd, ev, SPEC_EVENTS, 0);
+    for (i = 0; i < n; ++i)
+    {
+        spectator *s = ev[i].data.ptr;
+
+        if (ev[i].data.ptr == &sp->listen_fd)
+        {
+            accept_all(sp);
+            continue;
+        }
+        if (ev[i].data.ptr == &sp->wake_fd)
+        {
+            uint64_t count;
+
+            if (read(sp->wake_fd, &count, sizeof count) > 0)
+                sp->kicked = 0;
+            continue;
+        }
+
+        /* spectators have nothing to say: input is discarded, and the
+         * end of it means they're gone */
+        if (ev[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            ssize_t r = recv(s->fd, junk, sizeof junk, MSG_DONTWAIT);
+
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                drop(sp, s);
+                continue;
+            }
+        }
+        if ((ev[i].events & EPOLLOUT) && serve(sp, s) > 0)
+            again = 1;
+    }
+
+    for (scanned = 0; scanned < sp->count && served < SPEC_SLICE; ++scanned)
+    {
+        spectator *s;
+
+        if (sp->cursor >= sp->count)
+            sp->cursor = 0;
+        s = sp->list[sp->cursor];
+        if (s->polled)
+        {
+            if (now - s->stalled > SPEC_STALL_US)
+            {
+                sp->drops++;
+                drop(sp, s); /* the last one moves to the cursor */
+            } else
+                sp->cursor++;
+            continue;
+        }
+        if (s->part == NULL && !s->resync && s->seq == sp->head)
+        {
+            sp->cursor++;
+            continue;
+        }
+        served++;
+        n = serve(sp, s);
+        if (n < 0)
+            continue;
+        again |= n;
+        sp->cursor++;
+    }
+    return again || served == SPEC_SLICE;
+}
+
+/*!
+ */
+void spec_report(const spectators *sp, FILE *out)
+{
+    fprintf(out, "spectators: %ld joined, %d connected, %lld flushes, "
+            "%lld bytes in %lld sends, %ld downgraded, %ld dropped\n",
+            sp->joined, sp->count, sp->head, sp->sent, sp->sends,
+            sp->downgrades, sp->drops);
+}
+
+/*!
+ */
+void spec_close(spectators *sp)
+{
+    spec_buf *b;
+    int i;
+
+    while (sp->count > 0)
+        drop(sp, sp->list[sp->count - 1]);
+    free(sp->list);
+    sp->list = NULL;
+    sp->cap = 0;
+    for (i = 0; i < SPEC_LOG; ++i)
+        if (sp->log[i])
+        {
+            buf_put(sp, sp->log[i]);
+            sp->log[i] = NULL;
+        }
+    if (sp->key)
+        buf_put(sp, sp->key);
+    sp->key = NULL;
+    while ((b = sp->free) != NULL)
+    {
+        sp->free = b->next;
+        free(b);
+    }
+    if (sp->listen_fd >= 0)
+        close(sp->listen_fd);
+    if (sp->epoll_fd >= 0)
+        close(sp->epoll_fd);
+    if (sp->wake_fd >= 0)
+        close(sp->wake_fd);
+    if (sp->path)
+        unlink(sp->path);
+    sp->listen_fd = sp->epoll_fd = sp->wake_fd = -1;
+    sp->path = NULL;
+    if (sp->wire)
+        ((wire_out *) sp->wire)->tap = NULL;
+}
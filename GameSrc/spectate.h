@@ -0,0 +1,149 @@
+/*!
+ * \file spectate.h
+ *
+ * \brief Fan-out of the wire stream (wire.h) to spectator sockets.
+ *
+ * Viewers attach to a running game on a local Unix socket and receive the
+ * same frame-delta stream a thin client gets, starting with a keyframe.
+ * Every flush of the wire output is copied once into a reference counted
+ * buffer and appended to a log of the last SPEC_LOG flushes. A spectator
+ * is only a position in the log: it is sent everything from there to the
+ * end with a single sendmsg, whose iovecs point into the shared buffers,
+ * so nothing is encoded or copied per spectator.
+ *
+ * Sending costs a system call per spectator whatever the size, so the
+ * spectators are served in slices of SPEC_SLICE, SPEC_SLICE_US apart, and
+ * with many of them each call carries several frames: the cost for the
+ * game is bounded, and with 10,000 spectators they get fewer, larger
+ * updates instead of slowing the game down. With a few spectators every
+ * flush goes out right away.
+ *
+ * Spectators are never waited for. A spectator whose socket is full is
+ * left out of the slices and served again when the socket drains. Once it
+ * is more than SPEC_LOG flushes or SPEC_QUEUE_MAX bytes behind, it is
+ * downgraded to keyframes: it gets the next keyframe as soon as its socket
+ * has room, and deltas from there. A spectator that can't take anything
+ * for SPEC_STALL_US is disconnected.
+ *
+ * All the sockets are registered in one epoll instance, whose descriptor
+ * is readable when any of them needs attention or a flush is waiting, so
+ * the whole fan-out is driven by a single coroutine of the game scheduler
+ * (spec_events).
+ */
+
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "wire.h"
+
+#define SPEC_LOG 256 /*!< flushes kept for the spectators behind */
+#define SPEC_QUEUE_MAX 16384 /*!< bytes behind before a downgrade */
+#define SPEC_IOV 64 /*!< max flushes sent in a call */
+#define SPEC_SLICE 512 /*!< spectators served in a slice */
+#define SPEC_SLICE_US 4000 /*!< pause between two slices */
+#define SPEC_STALL_US 5000000 /*!< wait for a full socket before a drop */
+#define SPEC_EVENTS 256 /*!< epoll events handled per call */
+
+/*!
+ * Reference counted flush
+ */
+typedef struct spec_buf {
+    int refs; /*!< holders of the buffer: log, keyframe or spectator */
+    size_t len; /*!< bytes of the flush */
+    struct spec_buf *next; /*!< next free buffer, when unused */
+    unsigned char data[WIRE_BUF]; /*!< wire messages */
+} spec_buf;
+
+/*!
+ * Connected spectator
+ */
+typedef struct {
+    int fd; /*!< socket */
+    int slot; /*!< index in the list of spectators */
+    long long seq; /*!< next flush of the log to send */
+    spec_buf *part; /*!< buffer sent in part, finished first, or NULL */
+    size_t part_off; /*!< bytes of part already sent */
+    int resync; /*!< waiting for a keyframe */
+    long long stalled; /*!< sched_now() time the socket got full, or 0 */
+    int polled; /*!< registered for writability */
+} spectator;
+
+/*!
+ * Spectator server
+ */
+typedef struct {
+    int listen_fd; /*!< listening socket, -1 when closed */
+    int epoll_fd; /*!< epoll instance of all the descriptors */
+    int wake_fd; /*!< eventfd signalled by a flush */
+    int kicked; /*!< wake_fd was signalled since the last slice */
+    const char *path; /*!< socket path */
+    const wire_out *wire; /*!< stream the keyframes are taken from */
+    spectator **list; /*!< connected spectators */
+    int count; /*!< spectators connected */
+    int cap; /*!< size of list */
+    int cursor; /*!< first spectator of the next slice */
+    spec_buf *free; /*!< unused buffers */
+    spec_buf *key; /*!< keyframe of the current state, NULL if stale */
+    spec_buf *log[SPEC_LOG]; /*!< last flushes, by sequence modulo */
+    long long log_at[SPEC_LOG]; /*!< bytes published before each flush */
+    long long head; /*!< sequence of the next flush, flushes published */
+    long long total; /*!< bytes published */
+    long long sent; /*!< bytes sent to all the spectators */
+    long long sends; /*!< sendmsg calls */
+    long joined; /*!< spectators accepted */
+    long downgrades; /*!< spectators sent a keyframe after falling behind */
+    long drops; /*!< spectators disconnected for stalling */
+} spectators;
+
+/*!
+ * \brief Open the spectator socket.
+ *
+ * Once open, the server is fed by the tap of the wire output.
+ *
+ * @param sp spectator server
+ * @param path Unix socket path, replaced if it exists
+ * @param w wire output of the game
+ * @return 0 on success, -1 on error with errno set
+ */
+int spec_open(spectators *sp, const char *path, wire_out *w);
+
+/*!
+ * \brief Append a flush of the wire output to the log.
+ *
+ * This is the tap of the wire output; the flush is sent by the next
+ * spec_events.
+ *
+ * @param ctx spectator server
+ * @param buf wire messages
+ * @param len number of bytes, up to WIRE_BUF
+ */
+void spec_publish(void *ctx, const unsigned char *buf, size_t len);
+
+/*!
+ * \brief Handle the pending socket events (new spectators, sockets with
+ * room again, spectators gone), then serve a slice of the spectators.
+ *
+ * @param sp spectator server
+ * @return non-zero if spectators are still behind, and the next slice
+ * is due in SPEC_SLICE_US
+ */
+int spec_events(spectators *sp);
+
+/*!
+ * \brief Print the fan-out statistics.
+ *
+ * @param sp spectator server
+ * @param out output stream
+ */
+void spec_report(const spectators *sp, FILE *out);
+
+/*!
+ * \brief Disconnect every spectator and remove the socket.
+ *
+ * @param sp spectator server
+ */
+void spec_close(spectators *sp);
+
+#endif
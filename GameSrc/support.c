@@ -8,22 +8,23 @@
 #include "support.h"
 
 /*!
+ * This coroutine waits on the signal file descriptor and manages the 
+ * received signals.
  */
-void *signal_listener(void *d)
+int signal_listener(coroutine *co)
 {
-    game_data *data = (game_data*) d;
+    game_data *data = (game_data*) co->arg;
     struct signalfd_siginfo signal_info;
 
-    /* create poll to wait on signal file descriptor */
-    struct pollfd pfd[1];
-    pfd[0].fd = data->signal_fd;
-    pfd[0].events = POLLERR | POLLHUP | POLLIN;
+    CO_BEGIN(co);
 
     while (1)
     {
         /* wait for event on signal fd and then read signal from pipe */
-        poll(pfd, 1, 1);
-        read(data->signal_fd, &signal_info, sizeof (struct signalfd_siginfo));
+        CO_AWAIT_INPUT(co, data->signal_fd);
+        if (read(data->signal_fd, &signal_info, sizeof signal_info)
+                != sizeof signal_info)
+            continue;
 
         /* manage signal */
         switch (signal_info.ssi_signo)
@@ -36,17 +37,38 @@ void *signal_listener(void *d)
                 break;
 
             case SIGWINCH:
-                /* resize field (critical section) */
-                pthread_mutex_lock(&data->mut);
+                /* resize field */
                 resize_handler(data);
-                pthread_mutex_unlock(&data->mut);
                 break;
 
             default:
                 break;
         }
-        
     }
+
+    CO_END(co);
+}
+
+/*!
+ * The epoll descriptor of the spectator server is readable whenever one
+ * of its sockets needs attention or a flush is waiting, so one await
+ * covers them all; while spectators are behind, the slices follow on a
+ * timer.
+ */
+int spectator_handler(coroutine *co)
+{
+    game_data *data = (game_data*) co->arg;
+
+    CO_BEGIN(co);
+
+    while (1)
+    {
+        CO_AWAIT_INPUT(co, data->spec.epoll_fd);
+        while (spec_events(&data->spec))
+            CO_AWAIT_TIMER(co, SPEC_SLICE_US);
+    }
+
+    CO_END(co);
 }
 
 /*!
@@ -62,25 +84,31 @@ void resize_handler(game_data *data)
     endwin();
 
     /* update field size */
-    data->bottom_row = getmaxy(stdscr) - 1;
-    data->paddle_col = getmaxx(stdscr) - 1;
+    data->match.bottom_row = getmaxy(stdscr) - 1;
+    data->match.paddle_col = getmaxx(stdscr) - 1;
 
     /* ensure objects are inside the new field */
-    if (data->paddle_pos > data->bottom_row - PADDLE_WIDTH / 2)
-        data->paddle_pos = MAX(
-                data->bottom_row - PADDLE_WIDTH / 2,
+    if (data->match.paddle_pos > data->match.bottom_row - PADDLE_WIDTH / 2)
+        data->match.paddle_pos = MAX(
+                data->match.bottom_row - PADDLE_WIDTH / 2,
                 PADDLE_WIDTH / 2); /* avoid the paddle to go above top row */
-    if (data->ai_paddle_pos > data->bottom_row - PADDLE_WIDTH / 2)
-        data->ai_paddle_pos = MAX(
-                data->bottom_row - PADDLE_WIDTH / 2,
+    if (data->match.ai_paddle_pos > data->match.bottom_row - PADDLE_WIDTH / 2)
+        data->match.ai_paddle_pos = MAX(
+                data->match.bottom_row - PADDLE_WIDTH / 2,
                 PADDLE_WIDTH / 2);
-    if (data->ball_y > data->bottom_row)
-        data->ball_y = data->bottom_row;
-    if (data->ball_x > getmaxx(stdscr))
-        data->ball_y = getmaxx(stdscr) / 2;
+    if (data->match.ball_y > data->match.bottom_row)
+        data->match.ball_y = data->match.bottom_row;
+    if (data->match.ball_x > getmaxx(stdscr))
+        data->match.ball_y = getmaxx(stdscr) / 2;
+    if (data->ai_co)
+    {
+        data->ai_stale = 1;
+        sched_wake(data->ai_co);
+    }
 
-    /* update screen content */
-    clear();
+    /* update screen content, repainting the whole terminal */
+    clearok(stdscr, TRUE);
+    show_court(data);
     draw_paddle(data, AI_TAG);
     draw_paddle(data, KBD_TAG);
     draw_ball(data);
@@ -89,239 +117,450 @@ void resize_handler(game_data *data)
 
 /*!
  * This procedure is a listener for keyboard input during the game.
- * When a player press a key, the input triggers the related action and a 
- * message to the game main thread is sent throug the pipe.
+ * When a player press a key, the input triggers the related action and the
+ * paddle is marked for redraw in the next frame.
  */
-void *keyboard_handler(void *d)
+int keyboard_handler(coroutine *co)
 {
-    game_data *data = (game_data*) d;
-
-    // Don't mask any mouse events
-    mousemask(ALL_MOUSE_EVENTS | REPORT_MOUSE_POSITION, NULL);
+    game_data *data = (game_data*) co->arg;
+    int ch;
 
-    printf("\033[?1003h\n"); // Makes the terminal report mouse movement events
+    CO_BEGIN(co);
 
-    while (!data->termination_flag)
+    while (1)
     {
-        int ch;
-
-        /* get user input (critical section) */
-        pthread_mutex_lock(&data->mut);
-        ch = getch(); 
-        pthread_mutex_unlock(&data->mut);
-	
-	while(data->haltFlag != 0);
-        
-	switch (ch)
+        CO_AWAIT_INPUT(co, STDIN_FILENO);
+
+        /* the level banner owns the keyboard while the game is halted */
+        if (data->haltFlag != 0)
+            continue;
+
+        /* get all the pending user input */
+        if (input_closed())
+            data->exit_flag = 1;
+        while ((ch = getch()) != ERR)
         {
-            case KEY_UP:
-                /* move pad up when possible */
-                data->paddle_pos_old = data->paddle_pos;
-                if (data->paddle_pos > PADDLE_WIDTH / 2)
-                    data->paddle_pos--;
-                write(data->pipedes[1], KBD_TAG, TAG_SIZE);
-                break;
+            /* keep the position drawn in the last frame as old position */
+            if (!(data->redraw & REDRAW_KBD))
+                data->paddle_pos_old = data->match.paddle_pos;
 
-            case KEY_DOWN:
-                /* move pad down when possible */
-                data->paddle_pos_old = data->paddle_pos;
-                if (data->paddle_pos < data->bottom_row - PADDLE_WIDTH / 2)
-                    data->paddle_pos++;
-                write(data->pipedes[1], KBD_TAG, TAG_SIZE);
+            switch (ch)
+            {
+                case KEY_UP:
+                    /* move pad up when possible */
+                    pointer_release(&data->pointer);
+                    player_step(&data->match, -1);
+                    data->redraw |= REDRAW_KBD;
+                    break;
+
+                case KEY_DOWN:
+                    /* move pad down when possible */
+                    pointer_release(&data->pointer);
+                    player_step(&data->match, 1);
+                    data->redraw |= REDRAW_KBD;
+                    break;
+
+                case PLAY_KEY:
+                    /* set flag to play a new game */
+                    data->play_flag = 1;
+                    break;
+
+                case QUIT_KEY:
+                    /* set flag asking for game termination */
+                    data->exit_flag = 1;
+                    break;
+
+                default:
+                {
+                    MEVENT event;
+
+                    if (getmouse(&event) == OK)
+                    {
+                        /* move pad toward the pointer row */
+                        pointer_report(&data->pointer, event.y,
+                                sched_now());
+                        follow_pointer(data);
+                    }
+                }
                 break;
+            }
+        }
+    }
 
-            case PLAY_KEY:
-                /* set flag to play a new game */
-                data->play_flag = 1;
-                break;
+    CO_END(co);
+}
 
-            case QUIT_KEY:
-                /* set flag asking for game termination */
-                data->exit_flag = 1;
-                /* dummy write to unlock the controller thread, waiting
-                 * at the other pipe end */
-                write(data->pipedes[1], QUIT_TAG, TAG_SIZE);
-                break;
+/*!
+ * The paddle follows the pointer from its centre, so it can reach the
+ * rows between the half paddle and the field edges.
+ */
+void follow_pointer(game_data *data)
+{
+    int y;
+
+    if (!data->pointer.active)
+        return;
+    y = pointer_predict(&data->pointer, sched_now(), PADDLE_WIDTH / 2,
+            data->match.bottom_row - PADDLE_WIDTH / 2);
+    if (y == data->match.paddle_pos)
+        return;
+    if (!(data->redraw & REDRAW_KBD))
+        data->paddle_pos_old = data->match.paddle_pos;
+    data->match.paddle_pos = y;
+    data->redraw |= REDRAW_KBD;
+}
 
-            default:
-		{
-			MEVENT event;
-			
-			if (getmouse(&event) == OK) 
-			{
-				/* move pad up when possible */  	
-				data->paddle_pos_old = data->paddle_pos;
-		                data->paddle_pos = event.y;
-		                write(data->pipedes[1],  KBD_TAG, TAG_SIZE);
-	
-			}
-		
-		} 
-                break;
-        }
+/*!
+ * This procedure plays the player pad in autoplay with the predictive
+ * controller, at the pace of the ai, and marks it for redraw in the next
+ * frame.
+ */
+int autoplayer(coroutine *co)
+{
+    game_data *data = (game_data*) co->arg;
+    controller *player = ctl_predict();
+    ctl_view view;
+    int intent;
+
+    CO_BEGIN(co);
+
+    while (1)
+    {
+        if (!(data->redraw & REDRAW_KBD))
+            data->paddle_pos_old = data->match.paddle_pos;
+
+        ctl_view_of(&data->match, SIDE_PLAYER, &view);
+        player->decide_batch(player, &view, 1, &intent);
+        player_step(&data->match, intent);
+        data->redraw |= REDRAW_KBD;
+
+        CO_AWAIT_TIMER(co, TIME_GAP_AI);
     }
-    printf("\033[?1003l\n"); // Disable mouse movement events, as l = low
-    
-    return 0;
+
+    CO_END(co);
 }
 
 /*!
  * This procedure is responsible for ball movement. The ball position is 
- * updated every TIME_GAP_BALL microseconds, and then a message to the 
- * game main thread is sent throug the pipe.
+ * updated every TIME_GAP_BALL microseconds (scaled by the game level), and
+ * then the ball is marked for redraw in the next frame.
  */
-void *ball_handler(void *d)
+int ball_handler(coroutine *co)
 {
-    game_data *data = (game_data*) d;
-    
-    /* initialize */
-    data->gameLevel = 0;
-    data->hitCnt = 0;
-	
+    game_data *data = (game_data*) co->arg;
+    int c;
+
+    CO_BEGIN(co);
+
     while (1)
     {
-	while(data->haltFlag != 0);
-
         /* update ball coordinates */
-        data->ball_y_old = data->ball_y;
-        data->ball_x_old = data->ball_x;
-        data->ball_y += data->ball_diry;
-        data->ball_x += data->ball_dirx;
+        data->ball_y_old = data->match.ball_y;
+        data->ball_x_old = data->match.ball_x;
+        data->ball_ev = ball_step(&data->match);
+        if (data->ball_ev & BALL_HIT_PLAYER)
+            data->hits++;
+        if (data->ball_ev & (BALL_HIT_PLAYER | BALL_HIT_AI))
+            data->rally++;
+        if (data->ball_ev & BALL_TURN)
+            sched_wake(data->ai_co); /* the plan of the ai ends here */
+
+        if (data->ball_ev & BALL_LEVEL_UP)
+        {
+            print_level(stdscr, data->match.gameLevel);
+            send_menu(data, WIRE_MENU_LEVEL, data->match.gameLevel);
+
+            /* halt the game until the player press space */
+            data->haltFlag = 1;
+            while (!data->autoplay)
+            {
+                CO_AWAIT_INPUT(co, STDIN_FILENO);
+                c = getch();
+                if (c == QUIT_KEY || (c == ERR && input_closed()))
+                    termination_handler(); 
+                if (c == ' ')
+                    break;
+            }
+            show_court(data);
+            data->redraw = REDRAW_KBD | REDRAW_AI | REDRAW_BALL;
+            data->haltFlag = 0;
+            sched_wake(data->ai_co);
+        }
 
-        /* reflect ball on field top and bottom */
-        if (data->ball_y < FIELD_TOP || data->ball_y > data->bottom_row) 
+        if (data->ball_ev & BALL_OVER)
         {
-            data->ball_diry *= -1;
-            data->ball_y += 2 * data->ball_diry;
+            /* ball is out or last level cleared */
+            data->play_flag = 0;
+
+            /* 0 when the player wins, 1 when the ai wins */
+            data->winner = !!(data->ball_ev & BALL_AI_WINS);
+
+            /* coroutine termination */
+            CO_RETURN(co);
         }
 
-        /* reflect ball on player pad */
-        if (data->ball_x == data->paddle_col)
+        data->redraw |= REDRAW_BALL;
+
+        /* the last levels run the ball at full speed, as step() does */
+        CO_AWAIT_TIMER(co, MAX(BALL_DELAY(data->match.gameLevel), 0));
+    }
+
+    CO_END(co);
+}
+
+/*!
+ * Plans the ai pad from the move at data->ai_next on. Up to the next turn
+ * of the ball (ball_turn_steps) the ball moves in a straight line, on the
+ * timer of the ball coroutine, so the match the ai will see at each of its
+ * moves is known, but for the player pad: the moves that leave the ai pad
+ * where it is are skipped, the tuned ai aiming and walking through them as
+ * it would have, and data->ai_next is set to the first move that takes the
+ * pad somewhere. Returns 0 when there is none before the turn, with
+ * data->ai_next on the first move after it, and 1 otherwise, also when the
+ * plan can't be made and the ai has to look at the match at data->ai_next.
+ */
+static int ai_plan(game_data *data)
+{
+    const coroutine *ball = data->ball_co;
+    const ai_level *level = NULL;
+    int delay = MAX(BALL_DELAY(data->match.gameLevel), 0);
+    match_state m = data->match, before = m;
+    ctl_view view[AI_PLAN_SLOTS];
+    int intent[AI_PLAN_SLOTS];
+    long long step, turn, t;
+    int steps, n;
+
+    if (data->haltFlag || ball->wait == CO_DONE)
+        return 0; /* woken again when the ball moves */
+    if (delay == 0)
+        return 1; /* the ball steps at every pass, no time to plan */
+
+    /* a ball spawned with the ai takes its first step in this pass */
+    step = ball->wait == CO_READY ? sched_now() : ball->wake_at;
+    turn = step + (long long) (ball_turn_steps(&m) - 1) * delay;
+    if (data->levels)
+        level = &data->levels[MIN(m.gameLevel, MAX_LEVEL)];
+
+    /* the ai moves ahead of a ball step due at the same time */
+    for (n = 0, t = data->ai_next; t <= turn && n < AI_PLAN_SLOTS;
+            ++n, t += TIME_GAP_AI)
+    {
+        steps = t > step ? (t - step - 1) / delay + 1 : 0;
+        m.ball_y = data->match.ball_y + steps * data->match.ball_diry;
+        m.ball_x = data->match.ball_x + steps * data->match.ball_dirx;
+        before = m;
+        if (level)
+            ai_tuned_step(&m, level);
+        else if (data->ai == ctl_chase())
+            ai_step(&m);
+        else
         {
-            if (abs(data->paddle_pos - data->ball_y - -data->ball_diry) 
-                    <= PADDLE_WIDTH / 2)
-            {
-                /* ball is above the pad; consider one extra on length
-                 * because the ball is moving diagonally */
-                data->ball_dirx *= -1;
-                data->ball_x += 2 * data->ball_dirx;
-
-		if(data->hitCnt >= MAX_HITCNT)
-		{
-			data->gameLevel++;
-
-			data->hitCnt = 0;
-		        
-            		print_level(stdscr, data->gameLevel);
-			char c;
-	
-		        do { 
-			    data->haltFlag =1;
-		            c = getch();
-		            if (c == QUIT_KEY)
-		                /* safe because threads have not been created yet */
-			    	termination_handler(); 
-        		} while (c != ' ');
-			clear();
-			data->haltFlag=0;
-            	}
-		else
-			data->hitCnt++;
-			
-		if(data->gameLevel > MAX_LEVEL)
-		{
-			/* ball is out */
-	                data->play_flag = 0;
-	
-	                /* ai loses, player wins */
-	                data->winner = 0;
-	
-	                /* dummy write to unlock the controller waiting
-	                 * at the other pipe end */
-	
-	                write(data->pipedes[1], QUIT_TAG, TAG_SIZE);
-	
-	                /* thread termination */
-               		return 0;
-		}
+            ctl_view_of(&m, SIDE_AI, &view[n]);
+            continue;
+        }
+        if (m.ai_paddle_pos != data->match.ai_paddle_pos)
+            break;
+    }
 
-            } else {
-                /* ball is out */
-                data->play_flag = 0;
+    if (!level && data->ai != ctl_chase() && n > 0)
+    {
+        /* the controllers decide all the moves of the plan in one batch */
+        data->ai->decide_batch(data->ai, view, n, intent);
+        for (steps = 0; steps < n; ++steps)
+        {
+            ai_move(&m, intent[steps]);
+            if (m.ai_paddle_pos != data->match.ai_paddle_pos)
+                break;
+        }
+        t = data->ai_next + steps * TIME_GAP_AI;
+        n = steps;
+    }
+    else if (m.ai_paddle_pos != data->match.ai_paddle_pos)
+        m = before; /* the moving step is left to the ai */
+
+    /* the tuned ai aimed on the moves skipped */
+    data->match.ai_target = m.ai_target;
+    data->match.ai_wait = m.ai_wait;
+    data->match.rng = m.rng;
+    data->ai_next = t;
+    return t <= turn;
+}
+
+/*!
+ * This procedure controls the ai pad. Movements are decided by the tuned 
+ * ai of the level table, or by the ai controller, every TIME_GAP_AI 
+ * microseconds, and then the pad is marked for redraw in the next frame.
+ * The moves are planned (ai_plan), so the coroutine only runs for the ones
+ * that take the pad somewhere, and sleeps through the rest: until the ball
+ * turns and the ball handler wakes it up to plan again when the pad stands
+ * still up to there. The plan also starts over when the player pad moves,
+ * which the ai controllers see, and when the screen is resized.
+ */
+int ai_handler(coroutine *co)
+{
+    game_data *data = (game_data*) co->arg;
+    
+    CO_BEGIN(co);
 
-                /* player loses, ai wins */
-                data->winner = 1;
+    data->ai_next = sched_now();
+    data->ai_last = data->ai_next - TIME_GAP_AI;
+    data->ai_stale = 0;
+    while (1)
+    {	
+        if (!ai_plan(data))
+        {
+            CO_AWAIT_WAKE(co);
 
-                /* dummy write to unlock the controller waiting
-                 * at the other pipe end */
-                write(data->pipedes[1], QUIT_TAG, TAG_SIZE);
+            /* back on the grid, past the moves of a halt */
+            if (data->ai_next < sched_now())
+                data->ai_next += (sched_now() - data->ai_next
+                        + TIME_GAP_AI - 1) / TIME_GAP_AI * TIME_GAP_AI;
+        }
+        else if (data->ai_next > sched_now())
+            CO_AWAIT_WAKE_UNTIL(co, data->ai_next);
 
-                /* thread termination */
-                return 0;
-            }
+        if (data->ai_stale)
+        {
+            /* plan again from the move due now, if not taken yet */
+            data->ai_stale = 0;
+            data->ai_next -= (data->ai_next - sched_now())
+                / TIME_GAP_AI * TIME_GAP_AI;
+            data->ai_next = MAX(data->ai_next, data->ai_last + TIME_GAP_AI);
         }
+        if (data->ai_next > sched_now())
+            continue; /* woken ahead of the move, the plan goes on */
 
-        /* reflect ball on AI pad */
-        if (data->ball_x == data->ai_paddle_col)
+        /* the ai stands still while the game is halted */
+        if (data->haltFlag == 0)
         {
-            if (abs(data->ai_paddle_pos - data->ball_y - -data->ball_diry) 
-                    <= PADDLE_WIDTH / 2)
+            ctl_view view;
+            int intent;
+
+            if (!(data->redraw & REDRAW_AI))
+                data->ai_paddle_pos_old = data->match.ai_paddle_pos;
+
+            if (data->levels)
             {
-                /* ball is above the pad; consider one extra on length
-                 * because the ball is moving diagonally */
-                data->ball_dirx *= -1;
-                data->ball_x += 2 * data->ball_dirx;
+                /* tuned built-in ai */
+                ai_tuned_step(
+                        &data->match,
+                        &data->levels[MIN(data->match.gameLevel, MAX_LEVEL)]);
+            } else if (data->ai == ctl_chase()) {
+                /* chasing built-in ai */
+                ai_step(&data->match);
             } else {
-                /* ball is out */
-                data->play_flag = 0;
+                /* ask the ai controller for a move */
+                ctl_view_of(&data->match, SIDE_AI, &view);
+                data->ai->decide_batch(data->ai, &view, 1, &intent);
+                ai_move(&data->match, intent);
+            }
 
-                /* ai loses, player wins */
-                data->winner = 0;
+            data->redraw |= REDRAW_AI;
+        }
 
-                /* dummy write to unlock the controller waiting
-                 * at the other pipe end */
+        /* next move on the grid, without bursts after a stall */
+        data->ai_last = data->ai_next;
+        data->ai_next = MAX(data->ai_next + TIME_GAP_AI, sched_now());
+    }
+    
+    CO_END(co);
+}
 
-                write(data->pipedes[1], QUIT_TAG, TAG_SIZE);
+/*!
+ * This procedure composes the static layer when the screen size changed
+ * and copies it onto the screen, so that only moving objects are drawn on
+ * top of it during the game.
+ */
+void show_court(game_data *data)
+{
+    char score[SCORE_MAX + 1];
 
-                /* thread termination */
-                return 0;
-            }
-        }
+    court_compose(&data->court);
+    snprintf(score, sizeof score, " level %d  %d:%d ",
+            data->match.gameLevel, data->won, data->lost);
+    court_score(&data->court, score);
+    court_show(&data->court);
 
-        write(data->pipedes[1], BALL_TAG, TAG_SIZE);
+    /* the thin client lays out its own court */
+    wire_court(&data->wire, data->court.rows, data->court.cols);
+    wire_score(&data->wire, data->match.gameLevel, data->won, data->lost);
+}
 
-        usleep(TIME_GAP_BALL*(MAX_LEVEL-1 - data->gameLevel));
-    }
+/*!
+ * Only the objects that moved go out, with the messages queued since the
+ * last frame.
+ */
+void send_objects(game_data *data)
+{
+    wire_objects o;
+
+    if (!wire_active(&data->wire))
+        return;
+    o.player = data->match.paddle_pos;
+    o.ai = data->match.ai_paddle_pos;
+    o.ball_y = data->match.ball_y;
+    o.ball_x = data->match.ball_x;
+    wire_frame(&data->wire, &o);
+    if (wire_flush(&data->wire) != 0)
+        data->exit_flag = 1; /* the client is gone */
 }
 
 /*!
- * This procedure controls the ai pad. Movements are generated every 
- * TIME_GAP_AI microseconds, and then a message is sent to the game main
- * thread throug the pipe.
  */
-void *ai_handler(void *d)
+void send_menu(game_data *data, int menu, int arg)
 {
-    game_data *data = (game_data*) d;
-    
-    while (!data->termination_flag)
-    {	
-	while(data->haltFlag != 0);
-        
-        int diff = data->ball_y - data->ai_paddle_pos;
-        int new = data->ai_paddle_pos + diff / (diff == 0 ? 1 : abs(diff));
+    wire_menu(&data->wire, menu, arg);
+    if (wire_flush(&data->wire) != 0)
+        data->exit_flag = 1; /* the client is gone */
+}
 
-        data->ai_paddle_pos_old = data->ai_paddle_pos;
+/*!
+ * Fill a sprite image with a color inside a rounded rectangle of radius
+ * r pixels, transparent outside.
+ */
+static void fill_sprite(unsigned char *rgba, int w, int h, int r,
+        unsigned rgb)
+{
+    int y, x;
 
-        if (new >= PADDLE_WIDTH / 2 
-                && new <= data->bottom_row - PADDLE_WIDTH / 2)
-            data->ai_paddle_pos = new;
+    for (y = 0; y < h; ++y)
+        for (x = 0; x < w; ++x)
+        {
+            /* distance from the rounded corners */
+            int dx = MAX(MAX(r - x, x - (w - 1 - r)), 0);
+            int dy = MAX(MAX(r - y, y - (h - 1 - r)), 0);
+            unsigned char *px = rgba + 4 * (y * w + x);
+
+            px[0] = rgb >> 16;
+            px[1] = rgb >> 8;
+            px[2] = rgb;
+            px[3] = dx * dx + dy * dy <= r * r ? 255 : 0;
+        }
+}
 
-        write(data->pipedes[1], AI_TAG, TAG_SIZE);
-        
-        usleep(TIME_GAP_AI);
-    }
-    
-    return 0;
+/*!
+ * This procedure draws the sprite images: a red ball one cell wide, and
+ * paddles two cells wide in the colors of their color pairs. A cell is
+ * about twice as high as wide, so it takes SPRITE_PX x 2 * SPRITE_PX
+ * pixels.
+ */
+int load_sprites(game_data *data)
+{
+    static unsigned char ball[SPRITE_PX * 2 * SPRITE_PX * 4];
+    static unsigned char pad[2 * SPRITE_PX * 2 * SPRITE_PX * PADDLE_WIDTH * 4];
+    int pad_w = 2 * SPRITE_PX, pad_h = 2 * SPRITE_PX * PADDLE_WIDTH;
+
+    fill_sprite(ball, SPRITE_PX, 2 * SPRITE_PX, SPRITE_PX / 2 - 1, 0xe02020);
+    if (frame_upload(&data->frame, term_fd, SPRITE_BALL, SPRITE_PX,
+                2 * SPRITE_PX, ball, 1, 1) != 0)
+        return -1;
+    fill_sprite(pad, pad_w, pad_h, SPRITE_PX / 2, 0x2040e0);
+    if (frame_upload(&data->frame, term_fd, SPRITE_PLAYER, pad_w, pad_h,
+                pad, 2, PADDLE_WIDTH) != 0)
+        return -1;
+    fill_sprite(pad, pad_w, pad_h, SPRITE_PX / 2, 0xe0c020);
+    return frame_upload(&data->frame, term_fd, SPRITE_AI, pad_w, pad_h,
+            pad, 2, PADDLE_WIDTH);
 }
 
 /*!
@@ -336,18 +575,15 @@ void delete_paddle(game_data *data, char *tag)
     int row = (type ? data->paddle_pos_old : data->ai_paddle_pos_old)
         - PADDLE_WIDTH / 2; /* base row */
 
-    /* delete all points from base row for all the paddle length */
+    int col = type ? data->match.paddle_col : data->match.ai_paddle_col;
+    int col2 = type ? col - 1 : col + 1;
+
+    /* restore the background of the paddle length */
     for (i = 0; i < PADDLE_WIDTH ; ++i)
     {
-        mvaddch(
-               row + i,
-               type ? data->paddle_col : data->ai_paddle_col,
-               ' ');
-	 mvaddch(
-               row + i,
-               type ? data->paddle_col-1 : data->ai_paddle_col+1,
-               ' ');
-     }
+        mvaddch(row + i, col, court_cell(&data->court, row + i, col));
+        mvaddch(row + i, col2, court_cell(&data->court, row + i, col2));
+    }
 }
 
 /*!
@@ -359,20 +595,28 @@ void draw_paddle(game_data *data, char *tag)
 {
     int i;
     int type = !strcmp(tag, KBD_TAG); /* 1 for player, 0 for ai */
-    int row = (type ? data->paddle_pos : data->ai_paddle_pos) 
+    int row = (type ? data->match.paddle_pos : data->match.ai_paddle_pos) 
         - PADDLE_WIDTH / 2; /* base row */
 
+    /* sprites replace the cells */
+    if (data->frame.sprites)
+    {
+        frame_sprite(&data->frame, type ? SPRITE_PLAYER : SPRITE_AI, row,
+                type ? data->match.paddle_col - 1 : data->match.ai_paddle_col);
+        return;
+    }
+
     /* delete all points from base row for all the paddle length */
     for (i = 0; i < PADDLE_WIDTH ; ++i)
     {
         attron(COLOR_PAIR(type ? PADDLE_COLOR : AI_COLOR));
         mvaddch(
                 row + i,
-                type ? data->paddle_col : data->ai_paddle_col,
+                type ? data->match.paddle_col : data->match.ai_paddle_col,
 	                ' ');
 	mvaddch(
                 row + i,
-                type ? data->paddle_col-1 : data->ai_paddle_col+1,
+                type ? data->match.paddle_col-1 : data->match.ai_paddle_col+1,
 	                ' ');
         attroff(COLOR_PAIR(type ? PADDLE_COLOR : AI_COLOR));
     }
@@ -380,16 +624,35 @@ void draw_paddle(game_data *data, char *tag)
 
 void delete_ball(game_data *data)
 {
-    mvaddch(data->ball_y_old, data->ball_x_old, ' '); 
+    mvaddch(data->ball_y_old, data->ball_x_old,
+            court_cell(&data->court, data->ball_y_old, data->ball_x_old));
 }
 
 void draw_ball(game_data *data)
 {
+    if (data->frame.sprites)
+    {
+        frame_sprite(&data->frame, SPRITE_BALL, data->match.ball_y,
+                data->match.ball_x);
+        return;
+    }
     attron(COLOR_PAIR(BALL_COLOR));
-    mvaddch(data->ball_y, data->ball_x, 'o');
+    mvaddch(data->match.ball_y, data->match.ball_x, 'o');
     attroff(COLOR_PAIR(BALL_COLOR));
 }
 
+/*!
+ * Input is readable with nothing to read only at its end.
+ */
+int input_closed(void)
+{
+    struct pollfd p = { STDIN_FILENO, POLLIN, 0 };
+    int n;
+
+    return poll(&p, 1, 0) > 0
+        && ioctl(STDIN_FILENO, FIONREAD, &n) == 0 && n == 0;
+}
+
 /*!
  * This procedure restores the xorg typematic settings as they were 
  * before the game start.
@@ -397,6 +660,10 @@ void draw_ball(game_data *data)
 void restore_key_rate()
 {
     char command[25]; /* string to hold system commands */
+
+    /* nothing to restore if the settings were never changed */
+    if (del[0] == '\0')
+        return;
     sprintf(command, "xset r rate %s %s", del, rate);
     system(command);
 }
@@ -404,90 +671,78 @@ void restore_key_rate()
 /*!
  * This procedure permits to handle signals for program kill or termination,
  * ensuring the keyboard system settings are restored and the ncurses
- * window is terminated before the program exit.
+ * window is terminated before the program exit. The sprites of a running
+ * game are freed first, while the game screen they live on is still up.
  */
 void termination_handler()
 {
+    if (game_frame)
+        frame_free(game_frame, term_fd);
     restore_key_rate();
     endwin();
     exit(1);
 }
 
+/*!
+ * The menus and the level banner are laid out once per terminal size (and
+ * message or level) and then shown with a single write, see render.h.
+ */
 void print_intro_menu(WINDOW *win)
 {
-    /* print in the center of the window */
-    int y = getmaxy(win) / 2;
-    int x = getmaxx(win) / 2;
-    const char *msg = "PONG";
-    const char *msg2 = "use up and down arrow keys to control the pad";
-    const char *msg3 = "press space to start, q to quit";
-
-    attron(COLOR_PAIR(TITLE_COLOR));
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg) / 2,
-            msg);
-    y++; /* newline */
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg2) / 2,
-            msg2);
-    y++; /* newline */
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg3) / 2,
-            msg3);
-    attroff(COLOR_PAIR(TITLE_COLOR));
+    static banner menu;
 
-    refresh();
+    if (banner_begin(&menu, 0))
+    {
+        /* print in the center of the window */
+        int y = getmaxy(win) / 2;
+
+        banner_center(&menu, y, "PONG", COLOR_PAIR(TITLE_COLOR));
+        banner_center(&menu, y + 1,
+                "use up and down arrow keys to control the pad",
+                COLOR_PAIR(TITLE_COLOR));
+        banner_center(&menu, y + 2, "press space to start, q to quit",
+                COLOR_PAIR(TITLE_COLOR));
+        banner_end(&menu);
+    }
+    banner_show(&menu, win, term_fd);
 }
 
+/*!
+ */
 void print_intra_menu(WINDOW *win, const char *msg)
 {
-    /* print in the center of the window */
-    int x = getmaxx(win) / 2;
-    int y = getmaxy(win) / 2;
-    const char *msg2 = "press space to restart, q to quit";
-    attron(COLOR_PAIR(TITLE_COLOR));
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg) / 2,
-            msg);
-    y++; /* newline */
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg2) / 2,
-            msg2);
-    attroff(COLOR_PAIR(TITLE_COLOR));
+    static banner menu;
+
+    if (banner_begin(&menu, banner_key(msg)))
+    {
+        /* print in the center of the window */
+        int y = getmaxy(win) / 2;
+
+        banner_center(&menu, y, msg, COLOR_PAIR(TITLE_COLOR));
+        banner_center(&menu, y + 1, "press space to restart, q to quit",
+                COLOR_PAIR(TITLE_COLOR));
+        banner_end(&menu);
+    }
+    banner_show(&menu, win, term_fd);
 }
 
+/*!
+ */
 void print_level(WINDOW *win, int level)
 {
-    /* print in the center of the window */
-    int x = 60;
-    int y = 0;
-    const char *msg2 = "press space to restart, q to quit";
-    
-    char buffer[40];
-    size_t max_size = sizeof(buffer);
-    snprintf(buffer, max_size, "Congratulation you have cleared level %d ", level);
-    
-    attron(COLOR_PAIR(TITLE_COLOR));
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(buffer) / 2,
-            buffer);
-  	    y++; /* newline */
-    mvwaddstr(
-            win,
-            y,
-            x - strlen(msg2) / 2,
-            msg2);
-    attroff(COLOR_PAIR(TITLE_COLOR));
+    static banner menu;
+
+    if (banner_begin(&menu, level))
+    {
+        char buffer[48];
+
+        /* print at the top, centered */
+        snprintf(buffer, sizeof buffer,
+                "Congratulation you have cleared level %d ", level);
+        banner_center(&menu, 0, buffer, COLOR_PAIR(TITLE_COLOR));
+        banner_center(&menu, 1, "press space to restart, q to quit",
+                COLOR_PAIR(TITLE_COLOR));
+        banner_end(&menu);
+    }
+    banner_show(&menu, win, term_fd);
 }
@@ -9,78 +9,101 @@
 #include <ncurses.h>
 #include <sys/ioctl.h>
 #include <sys/signalfd.h>
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
-#include <pthread.h>
 #include <string.h>
 #include <stdio.h>
-#include <poll.h>
+#include "sched.h"
+#include "rules.h"
+#include "controller.h"
+#include "render.h"
+#include "pointer.h"
+#include "wire.h"
+#include "spectate.h"
+#include "leaderboard.h"
+#include "scores.h"
 
-#define TIME_GAP_BALL 25000 /*!< time in us between ball position update */
-#define TIME_GAP_AI 25000 /*!< time in us between ai position update */
-#define FIELD_TOP 0 /*!< top row for the playing field */
-#define AI_COL 1 /*!< column for the ai paddle */
-#define PADDLE_WIDTH 5 /*!< width of the paddles, must be an odd number */
 #define PADDLE_COLOR 1 /*!< color pair identifier for player paddle */
 #define BALL_COLOR 2 /*!< color pair identifier for ball */
 #define AI_COLOR 3 /*!< color pair identifier for ai paddle */
 #define TITLE_COLOR 4 /*!< color pair identifier for title writing */
-#define KBD_TAG "k" /*!< tag describing data from keyboadrd thread */
-#define MUS_TAG "m" /*!< tag describing data from keyboadrd thread */
-#define AI_TAG "a" /*!< tag describing data from ai thread */
-#define BALL_TAG "b" /*!< tag describing data from ball thread */
-#define QUIT_TAG "	q" /*!< tag describing quit request */
-#define TAG_SIZE sizeof "k"  /*!< size of tags */
+#define SPRITE_BALL 1 /*!< sprite id of the ball */
+#define SPRITE_PLAYER 2 /*!< sprite id of the player paddle */
+#define SPRITE_AI 3 /*!< sprite id of the ai paddle */
+#define SPRITE_PX 16 /*!< sprite pixels per cell column */
+#define KBD_TAG "k" /*!< tag describing the player paddle */
+#define AI_TAG "a" /*!< tag describing the ai paddle */
+#define REDRAW_KBD 1 /*!< player paddle moved since last frame */
+#define REDRAW_AI 2 /*!< ai paddle moved since last frame */
+#define REDRAW_BALL 4 /*!< ball moved since last frame */
 #define QUIT_KEY 'q' /*!< key for game termination */
 #define PLAY_KEY ' ' /*!< key for game start */
-
-#define MAX_HITCNT 1 /*!< max hit count of each level */
-#define MAX_LEVEL 3 /*!< max number of game levels */
-
-#define MAX(a,b) ((a) > (b) ? (a) : (b)) /*!< return maximum of 2 values */
-#define MIN(a,b) ((a) < (b) ? (a) : (b)) /*!< return minimum of 2 values */
+#define AI_PLAN_SLOTS 64 /*!< ai moves looked ahead by a plan, at most */
 
 /* global variables for keyboard delay and rate settings */
 extern char del[4]; /*!< delay time for repetition after key press */
 extern char rate[3]; /*!< rate (press/s) for a repeated key */
+extern int term_fd; /*!< file descriptor of the terminal output */
+extern frame_out *game_frame; /*!< frame of the running game, if any */
 
         
 /*!
- * Game data shared between threads 
+ * Game data shared between coroutines
  */
 typedef struct {
-    int paddle_pos; /*!< player paddle's current vertical position */
-    int paddle_col; /*!< player paddle's column */
-    int ai_paddle_pos; /*!< ai paddle's current position */
-    int ai_paddle_col; /*!< ai paddle's column */
-    int ball_x; /*!< current ball x (column) coord */
-    int ball_y; /*!< current ball y (row) coord */
+    match_state match; /*!< paddles, ball and level of the current game */
     int paddle_pos_old; /*!< player paddle's last vertical position */
     int ai_paddle_pos_old; /*!< ai paddle's last vertical position */
     int ball_x_old; /*!< last ball x coord */
     int ball_y_old; /*!< last ball y coord */
     int exit_flag; /*!< allow game termination */
     int play_flag; /*!< allow game prosecution */
-    int ball_dirx; /*!< current ball x speed component */
-    int ball_diry; /*!< current ball y speed component */
-    int pipedes[2]; /*!< pipe file descriptors */
-    pthread_mutex_t mut; /*!< mutex for ncurses actions */
-    int termination_flag; /*!< request child threads termination */
+    int redraw; /*!< objects to redraw in the next frame (REDRAW_*) */
     int winner; /*!< 0 for player, 1 for ai */
+    int ball_ev; /*!< BALL_* flags of the last ball step */
+    long long ai_next; /*!< sched_now() time of the next ai move, or of
+                         the first one not planned yet */
+    long long ai_last; /*!< sched_now() time of the last ai move */
+    int ai_stale; /*!< the ai plan missed a change of the match */
+    int autoplay; /*!< games left to autoplay, 0 when a user plays */
+    int won; /*!< games won by the player */
+    int lost; /*!< games lost by the player */
+    int hits; /*!< player paddle hits of the current game */
+    int rally; /*!< paddle hits since the serve of the current game */
     int signal_fd; /*!< file descriptor for signal info pipe */
-    int bottom_row; /*!< last row of the gaming field = getmaxy(stdscr) */
-    int gameLevel; /*!< current game level (MAX_LEVEL) */
-    int hitCnt; /*!< hit count of the current game level (MAX_HITCNT) */
-    int haltFlag;
+    int haltFlag; /*!< non-zero while the level banner waits for a key */
+    controller *ai; /*!< controller driving the ai paddle */
+    const ai_level *levels; /*!< tuned ai parameters, NULL to use ai */
+    ai_level level_table[MAX_LEVEL + 1]; /*!< storage for levels */
+    court court; /*!< static background layer of the screen */
+    frame_out frame; /*!< encoder of the game frames */
+    pointer pointer; /*!< predictor of the mouse pointer */
+    wire_out wire; /*!< frame-delta stream for a thin client (wire.h) */
+    spectators spec; /*!< viewers of the wire stream, when listening */
+    leaderboard board; /*!< best game of each player */
+    lb_writer *board_in; /*!< writer of the games to the board */
+    score_store scores; /*!< high scores kept across runs, if open */
+    scheduler sched; /*!< scheduler running all the game coroutines */
+    coroutine *kbd_co; /*!< keyboard coroutine of the current game */
+    coroutine *ai_co; /*!< ai coroutine of the current game */
+    coroutine *ball_co; /*!< ball coroutine of the current game */
 } game_data;
 
 /*!
- * \brief Thread function for the signal listener thread.
+ * \brief Coroutine for the signal listener.
  *
- * @param d shared game_data structure
+ * @param co coroutine, its argument is the shared game_data structure
  */
-void *signal_listener(void*);
+int signal_listener(coroutine *co);
+
+/*!
+ * \brief Coroutine serving the spectators of the game.
+ *
+ * @param co coroutine, its argument is the shared game_data structure
+ */
+int spectator_handler(coroutine *co);
 
 /*!
  * \brief Manage window resize.
@@ -90,34 +113,87 @@ void *signal_listener(void*);
 void resize_handler(game_data *data);
 
 /*!
- * \brief Thread function for keyboard input handling.
+ * \brief Coroutine for keyboard input handling.
+ *
+ * The coroutine runs until the game controller cancels it.
+ *
+ * @param co coroutine, its argument is the shared game_data structure
+ */
+int keyboard_handler(coroutine *co);
+
+/*!
+ * \brief Move the player paddle where the pointer predictor expects the
+ * pointer for the next frame, while the mouse drives it.
  *
- * The thread terminates itself when the termination_flag into game_data
- * structure is set to non-zero.
+ * @param data shared game_data structure
+ */
+void follow_pointer(game_data *data);
+
+/*!
+ * \brief Coroutine moving the player paddle in autoplay, in place of the
+ * keyboard handler.
  *
- * @param d shared game_data structure
+ * The coroutine runs until the game controller cancels it.
+ *
+ * @param co coroutine, its argument is the shared game_data structure
  */
-void *keyboard_handler(void*);
+int autoplayer(coroutine *co);
 
 /*!
- * \brief Thread function for ball position handling.
+ * \brief Coroutine for ball position handling.
  *
- * The thread terminates itself when the ball reaches an invalid 
+ * The coroutine terminates itself when the ball reaches an invalid 
  * position 
  *
- * @param d shared game_data structure
+ * @param co coroutine, its argument is the shared game_data structure
  */
-void *ball_handler(void*);
+int ball_handler(coroutine *co);
 
 /*!
- * \brief Thread function for ball position generation.
+ * \brief Coroutine for ai position generation.
  *
- * The thread terminates itself when the termination_flag into game_data
- * structure is set to non-zero.
+ * The coroutine runs until the game controller cancels it.
  *
- * @param d shared game_data structure
+ * @param co coroutine, its argument is the shared game_data structure
  */
-void *ai_handler(void*);
+int ai_handler(coroutine *co);
+
+/*!
+ * \brief Repaint the screen with the static court layer, composing it
+ * again after a resize and updating the score frame.
+ *
+ * @param data shared game_data structure
+ */
+void show_court(game_data *data);
+
+/*!
+ * \brief Send the moving objects to the thin client, in wire mode.
+ *
+ * A failed write means the client is gone: the game ends.
+ *
+ * @param data shared game_data structure
+ */
+void send_objects(game_data *data);
+
+/*!
+ * \brief Send a menu to the thin client, in wire mode.
+ *
+ * A failed write means the client is gone: the game ends.
+ *
+ * @param data shared game_data structure
+ * @param menu WIRE_MENU_* menu
+ * @param arg menu argument
+ */
+void send_menu(game_data *data, int menu, int arg);
+
+/*!
+ * \brief Upload the ball and paddle sprites, so that they are drawn with
+ * the terminal graphics protocol from then on.
+ *
+ * @param data shared game_data structure
+ * @return 0 on success, -1 if the sprites can't be uploaded
+ */
+int load_sprites(game_data *data);
 
 /*!
  * \brief Delete the paddle from the old position described in the shared
@@ -153,6 +229,12 @@ void delete_ball(game_data*);
  */
 void draw_ball(game_data*);
 
+/*!
+ * \brief Return non-zero if the keyboard input reached its end, as when
+ * the thin client of wire mode hangs up.
+ */
+int input_closed(void);
+
 /*!
  * \brief Restore the key settings of the system before the game start.
  */
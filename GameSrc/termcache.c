@@ -0,0 +1,248 @@
+/*!
+ * \file termcache.c
+ *
+ * \brief This file implements the terminal feature cache declared in
+ * termcache.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <term.h>
+#include "termout.h"
+#include "termcache.h"
+
+#define TC_MAGIC "PTC1" /*!< first bytes of a cache file */
+
+/*!
+ * Cached features of a terminal
+ */
+typedef struct {
+    char key[TC_KEY_MAX]; /*!< $TERM and terminal version */
+    uint32_t stamp; /*!< hash of the terminfo entry */
+    int32_t features; /*!< TERM_* flags */
+} tc_record;
+
+/*!
+ * Cache file, read and written as a whole
+ */
+typedef struct {
+    char magic[4]; /*!< TC_MAGIC */
+    uint32_t count; /*!< records in use */
+    tc_record rec[TC_RECORDS]; /*!< records, the most recent first */
+} tc_file;
+
+/*!
+ * Build the path of the cache file, return -1 if there's no home.
+ */
+static int cache_path(char *path, size_t size, int create)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+
+    if (xdg && *xdg)
+        n = snprintf(path, size, "%s", xdg);
+    else if (home && *home)
+        n = snprintf(path, size, "%s/.cache", home);
+    else
+        return -1;
+    if (n < 0 || (size_t) n >= size)
+        return -1;
+    if (create)
+        mkdir(path, 0755); /* usually there already */
+    size -= n;
+    n = snprintf(path + n, size, "/%s", TC_FILE);
+    return n < 0 || (size_t) n >= size ? -1 : 0;
+}
+
+/*!
+ * Variables naming the terminal emulator, or its version, where $TERM
+ * doesn't: xterm, Konsole, iTerm2 (also forwarded by its ssh), JetBrains
+ * terminals.
+ */
+static const char *const key_vars[] = {
+    "TERM_PROGRAM", "TERM_PROGRAM_VERSION", "VTE_VERSION", "XTERM_VERSION",
+    "KONSOLE_VERSION", "LC_TERMINAL", "LC_TERMINAL_VERSION",
+    "TERMINAL_EMULATOR",
+};
+
+/*!
+ * Variables whose value changes with every window, only their presence
+ * tells the terminal: kitty, Windows Terminal, Alacritty.
+ */
+static const char *const key_flags[] = {
+    "KITTY_WINDOW_ID", "WT_SESSION", "ALACRITTY_SOCKET",
+};
+
+/*!
+ * Build the record key, return -1 if $TERM is unset. named is set when
+ * the environment names the terminal emulator, beyond $TERM.
+ */
+static int cache_key(char *key, int *named)
+{
+    const char *term = getenv("TERM");
+    const char *v;
+    size_t i, n;
+
+    if (term == NULL || *term == '\0')
+        return -1;
+    memset(key, 0, TC_KEY_MAX);
+    *named = 0;
+    n = snprintf(key, TC_KEY_MAX, "%s", term);
+    for (i = 0; i < sizeof key_vars / sizeof key_vars[0]; ++i)
+    {
+        v = getenv(key_vars[i]);
+        *named |= v != NULL;
+        if (n < TC_KEY_MAX)
+            n += snprintf(key + n, TC_KEY_MAX - n, "|%s", v ? v : "");
+    }
+    for (i = 0; i < sizeof key_flags / sizeof key_flags[0]; ++i)
+    {
+        v = getenv(key_flags[i]);
+        *named |= v != NULL;
+        if (n < TC_KEY_MAX)
+            n += snprintf(key + n, TC_KEY_MAX - n, "|%d", v != NULL);
+    }
+    return 0;
+}
+
+/*!
+ * Fold a string into a FNV-1a hash.
+ */
+static uint32_t fnv(uint32_t h, const char *s)
+{
+    if (s == NULL || s == (char *) -1)
+        s = "";
+    for (; *s; ++s)
+        h = (h ^ (unsigned char) *s) * 16777619u;
+    return (h ^ 0xff) * 16777619u; /* separator */
+}
+
+/*!
+ * Hash the capabilities the probe and the encoder depend on.
+ */
+static uint32_t cache_stamp(void)
+{
+    char colors[16];
+    uint32_t h = 2166136261u;
+
+    snprintf(colors, sizeof colors, "%d", max_colors);
+    h = fnv(h, curses_version());
+    h = fnv(h, colors);
+    h = fnv(h, repeat_char);
+    h = fnv(h, erase_chars);
+    h = fnv(h, cursor_address);
+    h = fnv(h, save_cursor);
+    h = fnv(h, restore_cursor);
+    h = fnv(h, back_color_erase ? "bce" : "");
+    return h;
+}
+
+/*!
+ * Read the cache file, an empty cache if missing or malformed.
+ */
+static void cache_read(tc_file *c)
+{
+    char path[4096];
+    ssize_t n = -1;
+    int fd;
+
+    if (cache_path(path, sizeof path, 0) == 0
+            && (fd = open(path, O_RDONLY)) >= 0)
+    {
+        n = read(fd, c, sizeof *c);
+        close(fd);
+    }
+    if (n < (ssize_t) offsetof(tc_file, rec)
+            || memcmp(c->magic, TC_MAGIC, 4) != 0
+            || c->count > TC_RECORDS
+            || (size_t) n < offsetof(tc_file, rec)
+                + c->count * sizeof(tc_record))
+    {
+        memcpy(c->magic, TC_MAGIC, 4);
+        c->count = 0;
+    }
+}
+
+/*!
+ * Write the cache file, replaced at once so readers never see it half
+ * written.
+ */
+static void cache_write(const tc_file *c)
+{
+    char path[4096], tmp[4096 + 8];
+    size_t size = offsetof(tc_file, rec) + c->count * sizeof(tc_record);
+    int fd, err;
+
+    if (cache_path(path, sizeof path, 1) != 0)
+        return;
+    snprintf(tmp, sizeof tmp, "%s.%d", path, (int) getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    err = write(fd, c, size) != (ssize_t) size;
+    err |= close(fd) != 0;
+    if (err || rename(tmp, path) != 0)
+        unlink(tmp);
+}
+
+/*!
+ * Records are looked up linearly: there are a handful of them. The record
+ * of the terminal moves to the front, so the least recently used one is
+ * dropped when the cache is full.
+ *
+ * A terminal reached through ssh often leaves no trace in the environment,
+ * so several terminals can share a key. A record with the kitty graphics
+ * protocol is always probed again, since images sent to another terminal
+ * would show up as garbage. So is a record with REP or ECH when only $TERM
+ * keys it: a terminal without them would draw a repeated run as one cell,
+ * or leave stale cells where blanks go. Only a wrong sync flag costs just
+ * bytes.
+ */
+int tc_probe(int in, int out, int refresh, int *cached)
+{
+    tc_file c;
+    tc_record r;
+    uint32_t i;
+    int named;
+    int unsure;
+
+    *cached = 0;
+    if (in < 0 || cache_key(r.key, &named) != 0)
+        return tb_probe(in, out);
+    unsure = TERM_KITTY | (named ? 0 : TERM_REP | TERM_ECH);
+    r.stamp = cache_stamp();
+
+    cache_read(&c);
+    for (i = 0; i < c.count; ++i)
+        if (memcmp(c.rec[i].key, r.key, TC_KEY_MAX) == 0)
+            break;
+
+    if (i < c.count && c.rec[i].stamp == r.stamp && !refresh
+            && !(c.rec[i].features & unsure))
+    {
+        *cached = 1;
+        r.features = c.rec[i].features;
+        if (i == 0)
+            return r.features; /* nothing to reorder */
+    } else
+    {
+        r.features = tb_probe(in, out);
+        if (i == c.count && c.count < TC_RECORDS)
+            c.count++;
+        else if (i == c.count)
+            i--;
+    }
+
+    memmove(&c.rec[1], &c.rec[0], i * sizeof(tc_record));
+    c.rec[0] = r;
+    cache_write(&c);
+    return r.features;
+}
@@ -0,0 +1,43 @@
+/*!
+ * \file termcache.h
+ *
+ * \brief Cache of the terminal features found by tb_probe.
+ *
+ * Probing the terminal costs a round trip to it at every start, up to
+ * TB_PROBE_MS on a slow link. The features found are kept in a small
+ * binary file, one fixed size record per terminal, so that later starts on
+ * the same terminal read them back instead of probing.
+ *
+ * A record is keyed by $TERM and the name and version the terminal
+ * advertises in the environment ($TERM_PROGRAM, $VTE_VERSION,
+ * $XTERM_VERSION, $KONSOLE_VERSION, $KITTY_WINDOW_ID...), and stamped with
+ * a hash of the terminfo entry and of the ncurses version: a record whose
+ * stamp doesn't match is probed again. Terminals found with the kitty
+ * graphics protocol are always probed again, as a key can't tell apart
+ * terminals that don't advertise themselves, over ssh for one; so are
+ * terminals found with REP or ECH that advertise nothing beyond $TERM.
+ *
+ * The file is $XDG_CACHE_HOME/pong-terminals, or ~/.cache/pong-terminals.
+ */
+
+#ifndef TERMCACHE_H
+#define TERMCACHE_H
+
+#define TC_FILE "pong-terminals" /*!< name of the cache file */
+#define TC_KEY_MAX 120 /*!< max length of a record key */
+#define TC_RECORDS 32 /*!< terminals kept, the least recent are dropped */
+
+/*!
+ * \brief Return the features of the terminal, from the cache or probed.
+ *
+ * Must be called once the terminal is set up, on a clean screen.
+ *
+ * @param in terminal input, as for tb_probe
+ * @param out terminal output
+ * @param refresh probe even if the terminal is cached
+ * @param cached set to 1 if the features come from the cache, else 0
+ * @return TERM_* flags
+ */
+int tc_probe(int in, int out, int refresh, int *cached);
+
+#endif
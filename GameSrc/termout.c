@@ -0,0 +1,601 @@
+/*!
+ * \file termout.c
+ *
+ * \brief This file implements the output encoder declared in termout.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <term.h>
+#include "termout.h"
+
+#define ATTR_UNKNOWN ((attr_t) -1) /*!< terminal attributes not known */
+#define ATTR_MASK (A_BOLD | A_DIM | A_REVERSE | A_UNDERLINE | A_ALTCHARSET \
+        | A_COLOR) /*!< attributes the encoder supports */
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b)) /*!< return maximum of 2 values */
+#define MIN(a,b) ((a) < (b) ? (a) : (b)) /*!< return minimum of 2 values */
+#define KITTY_QUERY "\033_Gi=31,s=1,v=1,a=q,t=d,f=24;AAAA\033\\" /*!< probe */
+#define SYNC_QUERY "\033[?2026$p" /*!< mode report of synchronized output */
+#define SYNC_BEGIN "\033[?2026h" /*!< start of a synchronized update */
+#define SYNC_END "\033[?2026l" /*!< end of a synchronized update */
+#define COST_INF 100000 /*!< cost of a motion the terminal can't do */
+
+static tbuf *target; /*!< buffer receiving the output of tputs */
+static int features; /*!< TERM_* features enabled */
+
+/*!
+ * Cursor motion costs, in bytes, for the current terminal size
+ */
+static struct {
+    int rows; /*!< terminal rows */
+    int cols; /*!< terminal columns */
+    int *cup; /*!< absolute motion to each cell, rows x cols */
+    int *hpa; /*!< column addressing to each column */
+    int *up; /*!< relative motions by a distance, up to max(rows, cols) */
+    int *down; /*!< idem */
+    int *left; /*!< idem */
+    int *right; /*!< idem */
+    int nl; /*!< bytes a newline takes on the wire */
+} mv;
+
+/*!
+ * Character output function of tputs, appending to target.
+ */
+static int put_target(int c)
+{
+    char ch = c;
+
+    tb_put(target, &ch, 1);
+    return c;
+}
+
+/*!
+ * Return non-zero if the terminal has a string capability.
+ */
+static int has_cap(const char *cap)
+{
+    return cap != NULL && cap != (char *) -1;
+}
+
+/*!
+ * Return the length of a capability, COST_INF if absent.
+ */
+static int cap_len(const char *cap)
+{
+    if (!has_cap(cap))
+        return COST_INF;
+    return strlen(cap);
+}
+
+/*!
+ * Return the cost of a relative motion by n, with the parametrized
+ * capability or by repeating the single step one.
+ */
+static int rel_cost(const char *parm, const char *one, int n)
+{
+    int c = has_cap(parm) ? cap_len(tparm(parm, n)) : COST_INF;
+
+    return MIN(c, n * cap_len(one));
+}
+
+/*!
+ * Return the cursor down capability, unless it is a newline: newlines may
+ * be translated to carriage return and newline by the tty.
+ */
+static const char *down_one(void)
+{
+    return has_cap(cursor_down) && strcmp(cursor_down, "\n") != 0
+        ? cursor_down : NULL;
+}
+
+/*!
+ * Append a relative motion by n, the cheaper of the parametrized and the
+ * repeated form.
+ */
+static void put_rel(tbuf *b, const char *parm, const char *one, int n)
+{
+    if (n == 0)
+        return;
+    if (has_cap(parm) && cap_len(tparm(parm, n)) <= n * cap_len(one))
+        tb_cap(b, tparm(parm, n));
+    else
+        while (n--)
+            tb_cap(b, one);
+}
+
+/*!
+ * Return the cost of writing through the cells of row y from column x0 up
+ * to x1 excluded, COST_INF unless they all have the current attributes.
+ */
+static int through_cost(const tbuf *b, WINDOW *scr, int y, int x0, int x1)
+{
+    int x;
+
+    if (x1 - x0 > 8) /* never cheaper than a short relative motion */
+        return COST_INF;
+    for (x = x0; x < x1; ++x)
+        if ((mvwinch(scr, y, x) & ATTR_MASK) != b->attr)
+            return COST_INF;
+    return x1 - x0;
+}
+
+/*!
+ */
+int tb_geometry(int rows, int cols, int fd)
+{
+    struct termios tio;
+    int n = MAX(rows, cols) + 1;
+    int y, x;
+
+    if (rows == mv.rows && cols == mv.cols && mv.cup)
+        return 0;
+    if (!has_cap(cursor_address))
+        return -1;
+
+    free(mv.cup);
+    free(mv.hpa);
+    free(mv.up);
+    mv.cup = malloc(rows * cols * sizeof *mv.cup);
+    mv.hpa = malloc(cols * sizeof *mv.hpa);
+    mv.up = malloc(4 * n * sizeof *mv.up);
+    if (mv.cup == NULL || mv.hpa == NULL || mv.up == NULL)
+    {
+        perror("allocation error");
+        exit(EXIT_FAILURE);
+    }
+    mv.down = mv.up + n;
+    mv.left = mv.down + n;
+    mv.right = mv.left + n;
+    mv.rows = rows;
+    mv.cols = cols;
+
+    for (y = 0; y < rows; ++y)
+        for (x = 0; x < cols; ++x)
+            mv.cup[y * cols + x] = cap_len(tparm(cursor_address, y, x));
+    for (x = 0; x < cols; ++x)
+        mv.hpa[x] = has_cap(column_address)
+            ? cap_len(tparm(column_address, x)) : COST_INF;
+    for (y = 0; y < n; ++y)
+    {
+        mv.up[y] = y ? rel_cost(parm_up_cursor, cursor_up, y) : 0;
+        mv.down[y] = y ? rel_cost(parm_down_cursor, down_one(), y) : 0;
+        mv.left[y] = y ? rel_cost(parm_left_cursor, cursor_left, y) : 0;
+        mv.right[y] = y ? rel_cost(parm_right_cursor, cursor_right, y) : 0;
+    }
+
+    /* with output processing each newline goes out as \r\n */
+    mv.nl = (tcgetattr(fd, &tio) == 0 && !((tio.c_oflag & OPOST)
+                && (tio.c_oflag & ONLCR))) ? 1 : 2;
+    return 0;
+}
+
+/*!
+ * Return the cost of the vertical motion from row y0 to row y1, when the
+ * column is already 0 newlines are allowed.
+ */
+static int vert_cost(int y0, int y1, int at_col0)
+{
+    if (y1 < y0)
+        return mv.up[y0 - y1];
+    if (at_col0)
+        return MIN(mv.down[y1 - y0], (y1 - y0) * mv.nl);
+    return mv.down[y1 - y0];
+}
+
+/*!
+ * Return the cost of the horizontal motion on row y from column x0 to x1,
+ * and the way to do it: 0 relative, 1 column address, 2 write through.
+ */
+static int horiz_cost(const tbuf *b, WINDOW *scr, int y, int x0, int x1,
+        int *how)
+{
+    int c = x1 >= x0 ? mv.right[x1 - x0] : mv.left[x0 - x1];
+    int t;
+
+    *how = 0;
+    if (mv.hpa[x1] < c)
+    {
+        c = mv.hpa[x1];
+        *how = 1;
+    }
+    if (x1 > x0 && (t = through_cost(b, scr, y, x0, x1)) < c)
+    {
+        c = t;
+        *how = 2;
+    }
+    return c;
+}
+
+/*!
+ */
+void tb_move(tbuf *b, WINDOW *scr, int y, int x)
+{
+    size_t start = b->len;
+    int cost, c, how, cr_how = 0, rel_how = 0;
+    enum { CUP, REL, CR } best = CUP;
+
+    b->naive += mv.cup[y * mv.cols + x];
+    if (b->y == y && b->x == x)
+        return;
+
+    cost = mv.cup[y * mv.cols + x];
+    if (b->y >= 0)
+    {
+        /* relative motion, column addressing or write through */
+        c = vert_cost(b->y, y, 0) + horiz_cost(b, scr, y, b->x, x, &how);
+        if (c < cost)
+        {
+            cost = c;
+            best = REL;
+            rel_how = how;
+        }
+
+        /* carriage return, then down or up, then right */
+        c = 1 + vert_cost(b->y, y, 1) + horiz_cost(b, scr, y, 0, x, &how);
+        if (c < cost)
+        {
+            cost = c;
+            best = CR;
+            cr_how = how;
+        }
+    }
+
+    switch (best)
+    {
+        case CUP:
+            tb_cup(b, y, x);
+            break;
+
+        case REL:
+        case CR:
+            if (best == CR)
+            {
+                tb_put(b, "\r", 1);
+                b->x = 0;
+                how = cr_how;
+                if (y > b->y && (y - b->y) * mv.nl <= mv.down[y - b->y])
+                {
+                    for (; b->y < y; b->y++)
+                        tb_put(b, "\n", 1);
+                }
+            } else
+                how = rel_how;
+            if (y < b->y)
+                put_rel(b, parm_up_cursor, cursor_up, b->y - y);
+            else if (y > b->y)
+                put_rel(b, parm_down_cursor, down_one(), y - b->y);
+            if (how == 1)
+                tb_cap(b, tparm(column_address, x));
+            else if (how == 2)
+                while (b->x < x)
+                {
+                    char ch = mvwinch(scr, y, b->x) & A_CHARTEXT;
+
+                    tb_put(b, &ch, 1);
+                    b->x++;
+                }
+            else if (x > b->x)
+                put_rel(b, parm_right_cursor, cursor_right, x - b->x);
+            else if (x < b->x)
+                put_rel(b, parm_left_cursor, cursor_left, b->x - x);
+            break;
+    }
+
+    b->y = y;
+    b->x = x;
+    b->motion += b->len - start;
+}
+
+/*!
+ */
+void tb_char(tbuf *b, chtype ch)
+{
+    char c = ch & A_CHARTEXT;
+
+    tb_attr(b, ch & A_ATTRIBUTES);
+    tb_put(b, &c, 1);
+
+    /* past the last column the terminal may or may not have wrapped */
+    if (++b->x >= mv.cols)
+        b->y = -1;
+}
+
+/*!
+ */
+void tb_run(tbuf *b, chtype ch, int n)
+{
+    char c = ch & A_CHARTEXT;
+    int blank = c == ' ' && !(ch & A_ATTRIBUTES & ~A_COLOR)
+        && (PAIR_NUMBER(ch) == 0 || back_color_erase);
+
+    int k;
+
+    for (k = 1; k < n && b->y >= 0 && b->x + k < mv.cols; ++k)
+        b->naive += mv.cup[b->y * mv.cols + b->x + k];
+    tb_attr(b, ch & A_ATTRIBUTES);
+
+    /* blanks: erase, with the current background, and stay */
+    if ((features & TERM_ECH) && blank
+            && cap_len(tparm(erase_chars, n)) < n)
+    {
+        tb_cap(b, tparm(erase_chars, n));
+        return;
+    }
+
+    /* one cell, repeated */
+    if ((features & TERM_REP) && n > 1
+            && cap_len(tparm(repeat_char, c, n)) < n)
+    {
+        tb_cap(b, tparm(repeat_char, c, n));
+        b->x += n;
+        if (b->x >= mv.cols)
+            b->y = -1;
+        return;
+    }
+
+    while (n--)
+        tb_char(b, ch);
+}
+
+/*!
+ * Return non-zero once the replies hold the primary device attributes
+ * (ESC [ ? ... c), the last reply of a probe.
+ */
+static int has_da1(const char *reply)
+{
+    const char *p = reply;
+
+    while ((p = strstr(p, "\033[?")) != NULL)
+    {
+        p += 3;
+        while ((*p >= '0' && *p <= '9') || *p == ';')
+            p++;
+        if (*p == 'c')
+            return 1;
+    }
+    return 0;
+}
+
+/*!
+ * Read the replies of a probe, until the device attributes arrive or
+ * TB_PROBE_MS pass without input.
+ */
+static void read_replies(int in, char *reply, size_t size)
+{
+    struct pollfd p = { in, POLLIN, 0 };
+    size_t len = 0;
+    ssize_t n;
+
+    reply[0] = '\0';
+    while (len < size - 1 && poll(&p, 1, TB_PROBE_MS) > 0)
+    {
+        n = read(in, reply + len, size - 1 - len);
+        if (n <= 0)
+            break;
+        len += n;
+        reply[len] = '\0';
+        if (has_da1(reply))
+            break;
+    }
+}
+
+/*!
+ */
+int tb_probe(int in, int out)
+{
+    struct termios saved, raw;
+    char reply[256];
+    const char *p;
+    tbuf q = { 0 };
+    int found = 0;
+    int row, col, mode;
+
+    if (has_cap(erase_chars))
+        found |= TERM_ECH;
+    if (in < 0)
+        return found | (has_cap(repeat_char) ? TERM_REP : 0);
+
+    /* read the replies without echo or line buffering */
+    if (tcgetattr(in, &saved) != 0)
+        return found;
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(in, TCSANOW, &raw);
+
+    /* three cells from column 1 with a repeat, then ask the position */
+    tb_reset(&q);
+    if (has_cap(repeat_char))
+    {
+        tb_put(&q, "\r", 1);
+        tb_cap(&q, tparm(repeat_char, 'x', 3));
+        tb_put(&q, "\033[6n", 4);
+    }
+    /* a 1x1 image query, answered by terminals with the kitty protocol */
+    tb_put(&q, KITTY_QUERY, strlen(KITTY_QUERY));
+    /* mode 2026 is known (set or reset) where updates can be synchronized */
+    tb_put(&q, SYNC_QUERY, strlen(SYNC_QUERY));
+    /* device attributes, answered by all terminals, end the replies */
+    tb_put(&q, "\033[c", 3);
+    tb_put(&q, "\r\033[K", 4);
+
+    if (tb_write(&q, out) == 0)
+    {
+        read_replies(in, reply, sizeof reply);
+        for (p = reply; (p = strstr(p, "\033[")) != NULL; p++)
+            if (sscanf(p, "\033[%d;%dR", &row, &col) == 2 && col == 4)
+                found |= TERM_REP;
+        if (strstr(reply, "\033_Gi=31;OK"))
+            found |= TERM_KITTY;
+        p = strstr(reply, "\033[?2026;");
+        if (p && sscanf(p, "\033[?2026;%d$y", &mode) == 1
+                && (mode == 1 || mode == 2))
+            found |= TERM_SYNC;
+    }
+    tb_free(&q);
+
+    tcsetattr(in, TCSANOW, &saved);
+    return found;
+}
+
+/*!
+ */
+void tb_enable(int f)
+{
+    features = f;
+}
+
+/*!
+ */
+void tb_reset(tbuf *b)
+{
+    b->len = 0;
+    b->attr = ATTR_UNKNOWN;
+    b->y = -1;
+}
+
+/*!
+ */
+void tb_put(tbuf *b, const char *s, size_t n)
+{
+    if (b->len + n > b->cap)
+    {
+        size_t cap = MAX(2 * b->cap, b->len + n + 256);
+        char *buf = realloc(b->buf, cap);
+
+        if (buf == NULL)
+        {
+            perror("allocation error");
+            exit(EXIT_FAILURE);
+        }
+        b->buf = buf;
+        b->cap = cap;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+/*!
+ */
+void tb_cap(tbuf *b, const char *cap)
+{
+    if (!has_cap(cap))
+        return;
+    target = b;
+    tputs(cap, 1, put_target);
+}
+
+/*!
+ */
+void tb_cup(tbuf *b, int y, int x)
+{
+    tb_cap(b, tparm(cursor_address, y, x));
+    b->y = y;
+    b->x = x;
+}
+
+/*!
+ */
+void tb_attr(tbuf *b, attr_t attr)
+{
+    short fg, bg;
+
+    attr &= ATTR_MASK;
+    if (attr == b->attr)
+        return;
+
+    /* start from plain attributes, then add the requested ones */
+    tb_cap(b, exit_attribute_mode);
+    if (attr & A_BOLD)
+        tb_cap(b, enter_bold_mode);
+    if (attr & A_DIM)
+        tb_cap(b, enter_dim_mode);
+    if (attr & A_REVERSE)
+        tb_cap(b, enter_reverse_mode);
+    if (attr & A_UNDERLINE)
+        tb_cap(b, enter_underline_mode);
+    if (attr & A_ALTCHARSET)
+        tb_cap(b, enter_alt_charset_mode);
+    else if ((b->attr & A_ALTCHARSET) && has_cap(exit_alt_charset_mode)
+            && !(has_cap(exit_attribute_mode)
+                && strstr(exit_attribute_mode, exit_alt_charset_mode)))
+        tb_cap(b, exit_alt_charset_mode); /* sgr0 may keep the charset */
+    if (PAIR_NUMBER(attr) != 0
+            && pair_content(PAIR_NUMBER(attr), &fg, &bg) == OK)
+    {
+        tb_cap(b, tparm(set_a_foreground, fg));
+        tb_cap(b, tparm(set_a_background, bg));
+    }
+    b->attr = attr;
+}
+
+/*!
+ */
+void tb_sync(tbuf *b, size_t from)
+{
+    size_t n = strlen(SYNC_BEGIN);
+
+    if (!(features & TERM_SYNC) || from >= b->len)
+        return;
+    tb_put(b, SYNC_BEGIN, n); /* room for the start */
+    memmove(b->buf + from + n, b->buf + from, b->len - n - from);
+    memcpy(b->buf + from, SYNC_BEGIN, n);
+    tb_put(b, SYNC_END, strlen(SYNC_END));
+}
+
+/*!
+ */
+int tb_save(tbuf *b)
+{
+    if (!has_cap(save_cursor) || !has_cap(restore_cursor))
+        return -1;
+    tb_cap(b, save_cursor);
+    return 0;
+}
+
+/*!
+ */
+void tb_restore(tbuf *b)
+{
+    tb_cap(b, restore_cursor);
+    b->attr = ATTR_UNKNOWN;
+    b->y = -1;
+}
+
+/*!
+ */
+int tb_write(const tbuf *b, int fd)
+{
+    size_t done = 0;
+
+    while (done < b->len)
+    {
+        ssize_t n = write(fd, b->buf + done, b->len - done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/*!
+ */
+void tb_free(tbuf *b)
+{
+    free(b->buf);
+    b->buf = NULL;
+    b->len = b->cap = 0;
+}
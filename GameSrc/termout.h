@@ -0,0 +1,207 @@
+/*!
+ * \file termout.h
+ *
+ * \brief Encoder of terminal output into byte strings.
+ *
+ * Output is encoded with the terminfo capabilities of the current terminal
+ * into a growable byte buffer, to be sent later with a single write.
+ * Nothing here touches the ncurses screen state, so encoded output meant
+ * to go around ncurses must leave the cursor and the attributes as it
+ * found them (see tb_save and tb_restore).
+ *
+ * Cursor motions are chosen by cost: for every target cell the encoder
+ * compares an absolute motion with relative motions, carriage return and
+ * newlines, column addressing and writing through the cells in between,
+ * using cost tables precomputed for the terminal size (tb_geometry).
+ *
+ * Runs of identical cells go out as one cell and a repeat (REP), and runs
+ * of blanks as an erase (ECH), on terminals where tb_probe found them.
+ * Large updates can be wrapped in a synchronized output block, so that
+ * the terminal shows them at once instead of while they arrive.
+ */
+
+#ifndef TERMOUT_H
+#define TERMOUT_H
+
+#include <stddef.h>
+#include <ncurses.h>
+
+#define TERM_REP 1 /*!< repeat the previous character (REP) */
+#define TERM_ECH 2 /*!< erase characters (ECH) */
+#define TERM_KITTY 4 /*!< kitty graphics protocol */
+#define TERM_SYNC 8 /*!< synchronized output (private mode 2026) */
+
+#define TB_PROBE_MS 200 /*!< max wait for the reply to a terminal probe */
+
+/*!
+ * Byte buffer of encoded output
+ */
+typedef struct {
+    char *buf; /*!< encoded bytes */
+    size_t len; /*!< bytes used */
+    size_t cap; /*!< bytes allocated */
+    attr_t attr; /*!< attributes set so far, all ones if unknown */
+    int y; /*!< cursor row after the encoded bytes, -1 if unknown */
+    int x; /*!< cursor column after the encoded bytes */
+    long long motion; /*!< bytes spent in cursor motions */
+    long long naive; /*!< bytes an absolute motion per cell would take */
+} tbuf;
+
+/*!
+ * \brief Empty the buffer, keeping its storage.
+ *
+ * The attributes and the cursor position of the terminal are taken as
+ * unknown, so the first tb_attr call always sets them and the first
+ * motion is absolute. The motion statistics are kept.
+ *
+ * @param b buffer
+ */
+void tb_reset(tbuf *b);
+
+/*!
+ * \brief Append bytes.
+ *
+ * @param b buffer
+ * @param s bytes to append
+ * @param n number of bytes
+ */
+void tb_put(tbuf *b, const char *s, size_t n);
+
+/*!
+ * \brief Append a terminfo string capability, with its padding.
+ *
+ * @param b buffer
+ * @param cap capability, ignored when NULL or absent
+ */
+void tb_cap(tbuf *b, const char *cap);
+
+/*!
+ * \brief Append an absolute cursor motion.
+ *
+ * @param b buffer
+ * @param y row
+ * @param x column
+ */
+void tb_cup(tbuf *b, int y, int x);
+
+/*!
+ * \brief Precompute the cursor motion costs for a terminal size.
+ *
+ * @param rows terminal rows
+ * @param cols terminal columns
+ * @param fd terminal output, to know whether it translates newlines
+ * @return 0 on success, -1 if the terminal can't address the cursor
+ */
+int tb_geometry(int rows, int cols, int fd);
+
+/*!
+ * \brief Append the cheapest cursor motion to a cell.
+ *
+ * Cells in between can be written through when the screen holds them with
+ * the current attributes.
+ *
+ * @param b buffer
+ * @param scr new screen content, ending up on the terminal
+ * @param y row
+ * @param x column
+ */
+void tb_move(tbuf *b, WINDOW *scr, int y, int x);
+
+/*!
+ * \brief Append a cell at the cursor, with its attributes.
+ *
+ * @param b buffer
+ * @param ch cell
+ */
+void tb_char(tbuf *b, chtype ch);
+
+/*!
+ * \brief Append a run of identical cells at the cursor.
+ *
+ * The run is sent as an erase or a repeat when the enabled features make
+ * it shorter; after an erase the cursor stays at the start of the run.
+ *
+ * @param b buffer
+ * @param ch cell
+ * @param n number of cells, on one row
+ */
+void tb_run(tbuf *b, chtype ch, int n);
+
+/*!
+ * \brief Detect the optional features of the terminal.
+ *
+ * Features are taken from terminfo. REP is then checked on the terminal
+ * itself, since many terminals claim a terminfo entry they don't fully
+ * implement: a repeat is written at the start of the current line and the
+ * cursor position is read back. The kitty graphics protocol, which has no
+ * terminfo entry, is detected by its answer to an image query, and
+ * synchronized output by the reply to a mode report request (DECRQM). The
+ * probe ends with a device attributes request, that every terminal answers,
+ * waits for the replies at most TB_PROBE_MS, and leaves the line blank.
+ *
+ * @param in terminal input, -1 to trust terminfo
+ * @param out terminal output
+ * @return TERM_* flags
+ */
+int tb_probe(int in, int out);
+
+/*!
+ * \brief Enable optional terminal features in the encoder.
+ *
+ * @param features TERM_* flags, as returned by tb_probe
+ */
+void tb_enable(int features);
+
+/*!
+ * \brief Wrap the bytes appended since an offset in a synchronized output
+ * block, when the terminal supports it.
+ *
+ * @param b buffer
+ * @param from offset of the first byte to wrap
+ */
+void tb_sync(tbuf *b, size_t from);
+
+/*!
+ * \brief Append the sequences switching to the given attributes.
+ *
+ * Bold, dim, reverse, underline, the alternate character set and the
+ * colors of the pair are supported. Nothing is appended when the
+ * attributes are already set.
+ *
+ * @param b buffer
+ * @param attr attributes and color pair, as in a chtype
+ */
+void tb_attr(tbuf *b, attr_t attr);
+
+/*!
+ * \brief Append a save of the cursor position and attributes.
+ *
+ * @param b buffer
+ * @return 0 on success, -1 if the terminal can't save the cursor
+ */
+int tb_save(tbuf *b);
+
+/*!
+ * \brief Append the restore of the state saved by tb_save.
+ *
+ * @param b buffer
+ */
+void tb_restore(tbuf *b);
+
+/*!
+ * \brief Write the buffer with a single write, retried on short writes.
+ *
+ * @param b buffer
+ * @param fd output file descriptor
+ * @return 0 on success, -1 on error
+ */
+int tb_write(const tbuf *b, int fd);
+
+/*!
+ * \brief Release the buffer storage.
+ *
+ * @param b buffer
+ */
+void tb_free(tbuf *b);
+
+#endif
@@ -0,0 +1,124 @@
+/*!
+ * \file tick.c
+ *
+ * \brief This file implements the frame tick sources declared in tick.h.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "tick.h"
+
+/*!
+ * Re-enable the UIO interrupt; drivers without interrupt control keep it
+ * enabled anyway, so errors are ignored.
+ */
+static void uio_enable(int fd)
+{
+    int32_t on = 1;
+
+    if (write(fd, &on, sizeof on) != sizeof on)
+        errno = 0;
+}
+
+/*!
+ */
+int tick_open(tick_source *t, const char *spec)
+{
+    memset(t, 0, sizeof t[0]);
+
+    if (spec[0] == '/')
+    {
+        /* vsync interrupt through UIO */
+        char path[256];
+        char *rate;
+        long hz = TICK_HZ;
+
+        strncpy(path, spec, sizeof path - 1);
+        path[sizeof path - 1] = '\0';
+        if ((rate = strchr(path, ':')) != NULL)
+        {
+            *rate++ = '\0';
+            hz = atol(rate);
+        }
+        if (hz <= 0 || hz > 1000000)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        t->fd = open(path, O_RDWR | O_NONBLOCK);
+        if (t->fd < 0)
+            return -1;
+        t->uio = 1;
+        t->period = 1000000 / hz;
+        uio_enable(t->fd);
+    } else {
+        /* timer stand-in */
+        long hz = atol(spec);
+        struct itimerspec its;
+
+        if (hz <= 0 || hz > 1000000)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (t->fd < 0)
+            return -1;
+        t->period = 1000000 / hz;
+        its.it_interval.tv_sec = t->period / 1000000;
+        its.it_interval.tv_nsec = t->period % 1000000 * 1000;
+        its.it_value = its.it_interval;
+        if (timerfd_settime(t->fd, 0, &its, NULL) != 0)
+        {
+            close(t->fd);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * The UIO count is cumulative, so frames are the difference with the
+ * previous count; the first interrupt counts as one frame.
+ */
+long tick_frames(void *ctx)
+{
+    tick_source *t = ctx;
+    long frames = 0;
+
+    if (t->uio)
+    {
+        uint32_t count;
+
+        if (read(t->fd, &count, sizeof count) == sizeof count)
+        {
+            frames = t->started ? (long) (count - t->count) : 1;
+            t->count = count;
+            t->started = 1;
+            uio_enable(t->fd);
+        }
+    } else {
+        uint64_t expirations;
+
+        if (read(t->fd, &expirations, sizeof expirations)
+                == sizeof expirations)
+            frames = expirations;
+    }
+
+    return frames;
+}
+
+/*!
+ */
+void tick_close(tick_source *t)
+{
+    close(t->fd);
+}
@@ -0,0 +1,56 @@
+/*!
+ * \file tick.h
+ *
+ * \brief Frame tick sources for the scheduler frame clock.
+ *
+ * On the board the FPGA raises the Xillybus Lite user_irq line once per
+ * vsync, and the interrupt is exposed through UIO: a read of the device
+ * blocks until the next interrupt and returns the total interrupt count,
+ * and writing 1 re-enables the interrupt. Off the board a timerfd at the
+ * same rate stands in for the device.
+ */
+
+#ifndef TICK_H
+#define TICK_H
+
+#define TICK_HZ 60 /*!< default frame rate, vsync of the VGA output */
+
+/*!
+ * Frame tick source
+ */
+typedef struct {
+    int fd; /*!< readable on every new frame */
+    int uio; /*!< 1 for a UIO device, 0 for a timerfd */
+    unsigned count; /*!< last interrupt count read from the UIO device */
+    int started; /*!< count holds a valid interrupt count */
+    long long period; /*!< frame period in us */
+} tick_source;
+
+/*!
+ * \brief Open a frame tick source.
+ *
+ * @param t tick source to initialize
+ * @param spec "/dev/uioN" or "/dev/uioN:hz" for the vsync interrupt, or a
+ * frame rate in Hz for the timer stand-in; rates go from 1 Hz to 1 MHz,
+ * where the period still counts whole microseconds
+ * @return 0 on success, -1 on error with errno set (EINVAL for a rate
+ * out of range)
+ */
+int tick_open(tick_source *t, const char *spec);
+
+/*!
+ * \brief Return the frames elapsed since the last call, once the source
+ * is readable.
+ *
+ * @param ctx tick source
+ */
+long tick_frames(void *ctx);
+
+/*!
+ * \brief Close a frame tick source.
+ *
+ * @param t tick source
+ */
+void tick_close(tick_source *t);
+
+#endif
@@ -0,0 +1,67 @@
+/*!
+ * \file bench_env.c
+ *
+ * \brief Throughput benchmark of the batched environment (pong_env.h).
+ *
+ * Steps K matches for N batch steps with a player chasing the ball and
+ * prints env-steps per second.
+ *
+ * Build: gcc -O2 -I.. bench_env.c ../pong_env.c ../rules.c -o bench_env
+ * Usage: bench_env [K] [N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pong_env.h"
+
+int main(int argc, char **argv)
+{
+    int k = argc > 1 ? atoi(argv[1]) : 1024; /* matches per batch */
+    int n = argc > 2 ? atoi(argv[2]) : 20000; /* batch steps */
+    pong_env *env = pong_env_create(k, 24, 80, 1);
+    float *obs = malloc(k * PONG_OBS_SIZE * sizeof *obs);
+    float *rewards = malloc(k * sizeof *rewards);
+    unsigned char *done = malloc(k);
+    int *actions = malloc(k * sizeof *actions);
+    struct timespec t0, t1;
+    long long episodes = 0;
+    double secs;
+    int i, j;
+
+    if (env == NULL || !obs || !rewards || !done || !actions)
+    {
+        perror("allocation error");
+        return EXIT_FAILURE;
+    }
+
+    pong_env_reset(env, obs);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (j = 0; j < n; ++j)
+    {
+        /* player chases the ball row */
+        for (i = 0; i < k; ++i)
+        {
+            const float *o = obs + i * PONG_OBS_SIZE;
+            float diff = o[PONG_OBS_BALL_Y] - o[PONG_OBS_PADDLE];
+
+            actions[i] = (diff > 0) - (diff < 0);
+        }
+        pong_env_step(env, actions, obs, rewards, done);
+        for (i = 0; i < k; ++i)
+            episodes += done[i];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%d matches x %d steps in %.3f s: %.1f M env-steps/s, "
+            "%lld episodes\n",
+            k, n, secs, (double) k * n / secs / 1e6, episodes);
+
+    pong_env_destroy(env);
+    free(obs);
+    free(rewards);
+    free(done);
+    free(actions);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*!
+ * \file bench_lanes.c
+ *
+ * \brief Check and benchmark of the lane-per-match simulator (lanes.h).
+ *
+ * The same matches are played by the scalar match_step loop and by
+ * lanes_step, with a player chasing the ball and served again when over.
+ * First both run in lockstep and every state and event is compared bit for
+ * bit, then each runs alone and the speedup is reported.
+ *
+ * Build: gcc -O2 -mavx2 -I.. bench_lanes.c ../lanes.c ../rules.c \
+ *            -o bench_lanes
+ * Usage: bench_lanes [blocks] [steps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lanes.h"
+
+/*!
+ * Return the ball chasing move of the player.
+ */
+static int chase(const match_state *m)
+{
+    int diff = m->ball_y - m->paddle_pos;
+
+    return (diff > 0) - (diff < 0);
+}
+
+/*!
+ * Serve a match, alternating the ball direction at each serve.
+ */
+static void serve(match_state *m, int *serves)
+{
+    match_serve(m, 24, 80, (++*serves & 1) ? 1 : -1);
+}
+
+/*!
+ * Advance the scalar matches by one step.
+ */
+static void scalar_step(match_state *m, int *serves, int *ev, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+    {
+        ev[i] = match_step(&m[i], chase(&m[i]));
+        if (ev[i] & BALL_OVER)
+            match_serve(&m[i], m[i].bottom_row + 1, m[i].paddle_col + 1,
+                    (++serves[i] & 1) ? 1 : -1);
+    }
+}
+
+/*!
+ * Advance the lanes by one step.
+ */
+static void lanes_round(match_lanes *l, lane_vec *serves, lane_vec *ev,
+        int blocks)
+{
+    lane_vec zero = {0};
+    int b;
+
+    for (b = 0; b < blocks; ++b)
+    {
+        lane_vec diff = l[b].ball_y - l[b].paddle_pos;
+        lane_vec over;
+
+        ev[b] = lanes_step(&l[b], (diff < 0) - (diff > 0));
+        over = (ev[b] & BALL_OVER) != zero;
+        serves[b] -= over;
+        lanes_serve(&l[b], over, ((serves[b] & 1) << 1) - 1);
+    }
+}
+
+/*!
+ * Return the elapsed seconds since t0.
+ */
+static double elapsed(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int blocks = argc > 1 ? atoi(argv[1]) : 128; /* vectors of matches */
+    int steps = argc > 2 ? atoi(argv[2]) : 20000; /* steps of the run */
+    int n = blocks * LANES; /* number of matches */
+    match_state *m = malloc(n * sizeof *m);
+    match_state *check = malloc(LANES * sizeof *check);
+    match_lanes *l = aligned_alloc(64, blocks * sizeof *l);
+    int *serves = calloc(n, sizeof *serves);
+    int *ev = malloc(n * sizeof *ev);
+    lane_vec *lserves = aligned_alloc(64, blocks * sizeof *lserves);
+    lane_vec *lev = aligned_alloc(64, blocks * sizeof *lev);
+    struct timespec t0;
+    double scalar_secs, lanes_secs;
+    int i, b, s;
+
+    if (!m || !check || !l || !serves || !ev || !lserves || !lev)
+    {
+        perror("allocation error");
+        return EXIT_FAILURE;
+    }
+
+    /* lockstep check */
+    for (i = 0; i < n; ++i)
+        serve(&m[i], &serves[i]);
+    for (b = 0; b < blocks; ++b)
+    {
+        lanes_load(&l[b], &m[b * LANES]);
+        for (i = 0; i < LANES; ++i)
+            lserves[b][i] = serves[b * LANES + i];
+    }
+    for (s = 0; s < steps / 10; ++s)
+    {
+        scalar_step(m, serves, ev, n);
+        lanes_round(l, lserves, lev, blocks);
+        for (b = 0; b < blocks; ++b)
+        {
+            /* fields outside the lanes are copied from the scalar run */
+            memcpy(check, &m[b * LANES], LANES * sizeof *check);
+            lanes_store(&l[b], check);
+            for (i = 0; i < LANES; ++i)
+            {
+                if (memcmp(&check[i], &m[b * LANES + i], sizeof *check)
+                        || lev[b][i] != ev[b * LANES + i])
+                {
+                    fprintf(stderr, "mismatch at step %d, match %d\n",
+                            s, b * LANES + i);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+    printf("lockstep check: %d matches x %d steps identical\n",
+            n, steps / 10);
+
+    /* timed runs */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (s = 0; s < steps; ++s)
+        scalar_step(m, serves, ev, n);
+    scalar_secs = elapsed(&t0);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (s = 0; s < steps; ++s)
+        lanes_round(l, lserves, lev, blocks);
+    lanes_secs = elapsed(&t0);
+
+    printf("scalar: %.1f M steps/s\n", (double) n * steps / scalar_secs / 1e6);
+    printf("lanes (%d): %.1f M steps/s\n",
+            LANES, (double) n * steps / lanes_secs / 1e6);
+    printf("speedup: %.2fx\n", scalar_secs / lanes_secs);
+
+    free(m);
+    free(check);
+    free(l);
+    free(serves);
+    free(ev);
+    free(lserves);
+    free(lev);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*!
+ * \file bench_mlp.c
+ *
+ * \brief Latency benchmark of the network controller (mlp.h).
+ *
+ * Times single decisions and batched decisions over random views and
+ * checks that the two paths agree with the chase controller when loaded
+ * with weights/chase.mlp.
+ *
+ * Build: gcc -O2 -mavx2 -I.. bench_mlp.c ../mlp.c ../controller.c \
+ *            ../rules.c -o bench_mlp
+ * Usage: bench_mlp [weights] [views]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "mlp.h"
+
+/*!
+ * Return the elapsed nanoseconds since t0.
+ */
+static double elapsed_ns(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "../weights/chase.mlp";
+    int n = argc > 2 ? atoi(argv[2]) : 1 << 16; /* views per run */
+    controller *mlp = mlp_load(path);
+    controller *chase = ctl_chase();
+    ctl_view *view = malloc(n * sizeof *view);
+    int *single = malloc(n * sizeof *single);
+    int *batch = malloc(n * sizeof *batch);
+    int *ref = malloc(n * sizeof *ref);
+    struct timespec t0;
+    double single_ns, batch_ns;
+    int i, agree = 0, same = 0;
+
+    if (mlp == NULL)
+    {
+        fprintf(stderr, "cannot load weights from %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (!view || !single || !batch || !ref)
+    {
+        perror("allocation error");
+        return EXIT_FAILURE;
+    }
+
+    /* random views on a 24x80 field */
+    srand(1);
+    for (i = 0; i < n; ++i)
+    {
+        match_state m;
+
+        match_serve(&m, 24, 80, 1);
+        m.ball_x = 1 + rand() % 78;
+        m.ball_y = rand() % 24;
+        m.ball_dirx = rand() % 2 ? 1 : -1;
+        m.ball_diry = rand() % 2 ? 1 : -1;
+        m.ai_paddle_pos = 2 + rand() % 20;
+        m.paddle_pos = 2 + rand() % 20;
+        m.gameLevel = rand() % (MAX_LEVEL + 1);
+        ctl_view_of(&m, SIDE_AI, &view[i]);
+    }
+
+    /* one view per call, as the game ai does */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; ++i)
+        mlp->decide_batch(mlp, &view[i], 1, &single[i]);
+    single_ns = elapsed_ns(&t0) / n;
+
+    /* all the views in one call */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    mlp->decide_batch(mlp, view, n, batch);
+    batch_ns = elapsed_ns(&t0) / n;
+
+    chase->decide_batch(chase, view, n, ref);
+    for (i = 0; i < n; ++i)
+    {
+        same += single[i] == batch[i];
+        agree += single[i] == ref[i];
+    }
+
+    printf("single: %.1f ns/decision\n", single_ns);
+    printf("batch (%d lanes): %.1f ns/decision\n", MLP_BATCH, batch_ns);
+    printf("single/batch agreement: %d/%d\n", same, n);
+    printf("agreement with chase: %d/%d\n", agree, n);
+
+    ctl_destroy(mlp);
+    free(view);
+    free(single);
+    free(batch);
+    free(ref);
+    return 0;
+}
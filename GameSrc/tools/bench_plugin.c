@@ -0,0 +1,105 @@
+/*!
+ * \file bench_plugin.c
+ *
+ * \brief Call overhead benchmark of the plugin controllers (plugin.h).
+ *
+ * Times the built-in chase controller against a plugin build of the same
+ * ai (plugins/chase_plugin.c) over random views, with batches from one
+ * view per call, as the game ai does, up to the whole set in one call,
+ * and checks that both give the same decisions.
+ *
+ * Build: gcc -O2 -I.. bench_plugin.c ../plugin.c ../controller.c \
+ *            ../rules.c -ldl -o bench_plugin
+ * Usage: bench_plugin [plugin] [views]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "plugin.h"
+
+/*!
+ * Return the elapsed nanoseconds since t0.
+ */
+static double elapsed_ns(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec);
+}
+
+/*!
+ * Return the nanoseconds per decision of c over the views, batch views
+ * per call.
+ */
+static double time_batches(controller *c, const ctl_view *view, int n,
+        int batch, int *intent)
+{
+    struct timespec t0;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; i += batch)
+        c->decide_batch(c, &view[i], MIN(batch, n - i), &intent[i]);
+    return elapsed_ns(&t0) / n;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "../plugins/chase.so";
+    int n = argc > 2 ? atoi(argv[2]) : 1 << 20; /* views per run */
+    controller *plugin = plugin_load(path);
+    controller *chase = ctl_chase();
+    ctl_view *view = malloc(n * sizeof *view);
+    int *ref = malloc(n * sizeof *ref);
+    int *intent = malloc(n * sizeof *intent);
+    int i, batch, same = 0;
+
+    if (plugin == NULL)
+    {
+        fprintf(stderr, "cannot load plugin %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (!view || !ref || !intent)
+    {
+        perror("allocation error");
+        return EXIT_FAILURE;
+    }
+
+    /* random views on a 24x80 field */
+    srand(1);
+    for (i = 0; i < n; ++i)
+    {
+        match_state m;
+
+        match_serve(&m, 24, 80, 1);
+        m.ball_x = 1 + rand() % 78;
+        m.ball_y = rand() % 24;
+        m.ball_dirx = rand() % 2 ? 1 : -1;
+        m.ball_diry = rand() % 2 ? 1 : -1;
+        m.ai_paddle_pos = 2 + rand() % 20;
+        m.paddle_pos = 2 + rand() % 20;
+        m.gameLevel = rand() % (MAX_LEVEL + 1);
+        ctl_view_of(&m, SIDE_AI, &view[i]);
+    }
+
+    printf("%8s %16s %16s\n", "batch", "built-in ns", "plugin ns");
+    for (batch = 1; batch <= n; batch *= 16)
+    {
+        double builtin_ns = time_batches(chase, view, n, batch, ref);
+        double plugin_ns = time_batches(plugin, view, n, batch, intent);
+
+        printf("%8d %16.2f %16.2f\n", batch, builtin_ns, plugin_ns);
+    }
+
+    for (i = 0; i < n; ++i)
+        same += ref[i] == intent[i];
+    printf("agreement: %d/%d\n", same, n);
+
+    ctl_destroy(plugin);
+    free(view);
+    free(ref);
+    free(intent);
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*!
+ * \file leaderboard_bench.c
+ *
+ * \brief Insert rate of the leaderboard (leaderboard.h) under contention.
+ *
+ * Writer threads insert random match results as fast as they can, each
+ * through its own writer, while reader threads copy the board in a loop
+ * and the merge thread of the board drains the writers. A result refused
+ * on a full ring is retried after a short sleep, so that none is lost.
+ *
+ * In the uniform mode scores are drawn at random and most results fall
+ * below the board once it fills up. In the rising mode scores grow with
+ * the results, so that nearly every result enters the board: the worst
+ * case, where everything goes through the rings and the merge step.
+ *
+ * At the end the board is compared with the top players computed from all
+ * the results, and the rate of inserts, the share of results filtered by
+ * the writers and the time readers took to copy the board are reported.
+ *
+ * Build: gcc -O2 -pthread -I.. leaderboard_bench.c ../leaderboard.c \
+ *            -o leaderboard-bench
+ * Usage: leaderboard-bench [-w writers] [-r readers] [-n results]
+ *                          [-k players_kept] [-p players] [-R]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "leaderboard.h"
+
+#define MAX_THREADS 64 /*!< max writers or readers */
+
+/*!
+ * Writer or reader thread
+ */
+typedef struct {
+    int id; /*!< thread index, seeds the results of a writer */
+    pthread_t thread; /*!< the thread */
+    long long retries; /*!< inserts retried on a full ring */
+    long long filtered; /*!< results below the board */
+    long long reads; /*!< copies of the board */
+    long long read_ns; /*!< total time of the copies */
+    long long read_max; /*!< longest copy in ns */
+    int bad; /*!< boards out of order seen */
+} worker;
+
+static leaderboard board; /*!< board under test */
+static long results = 2000000; /*!< results per writer */
+static unsigned players = 100000; /*!< distinct player ids */
+static int rising; /*!< scores grow with the results */
+static volatile int readers_stop; /*!< the writers are done */
+
+/*!
+ * \brief Monotonic time in ns.
+ */
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*!
+ * \brief Result i of writer id, the same at every call.
+ */
+static void result(int id, long i, lb_result *r)
+{
+    unsigned long long x = (id + 1) * 0x9e3779b97f4a7c15ULL + i;
+
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    r->player = x % players;
+    r->score = rising ? (int) (i / 16 + (x >> 20) % 1000)
+        : (int) ((x >> 20) % 1000000);
+    r->level = (x >> 40) % 4;
+    r->rally = (x >> 44) % 100;
+}
+
+/*!
+ * \brief Ranking of a result, as the board orders them.
+ */
+static unsigned long long rank(const lb_result *r)
+{
+    return (unsigned long long) r->score << 32 | r->level << 24 | r->rally;
+}
+
+/*!
+ */
+static void *writer_run(void *arg)
+{
+    worker *wk = arg;
+    lb_writer *w = lb_writer_open(&board);
+    lb_result r;
+    long i;
+
+    if (!w)
+    {
+        fprintf(stderr, "writer %d: no writer left\n", wk->id);
+        return NULL;
+    }
+    for (i = 0; i < results; i++)
+    {
+        result(wk->id, i, &r);
+        while (lb_insert(&board, w, &r) != 0)
+            usleep(10);
+    }
+    wk->retries = w->full;
+    wk->filtered = w->filtered;
+    return NULL;
+}
+
+/*!
+ */
+static void *reader_run(void *arg)
+{
+    worker *wk = arg;
+    static __thread lb_board b;
+    unsigned long long version = 0;
+    long long t, dt;
+    int i;
+
+    while (!readers_stop)
+    {
+        t = now_ns();
+        lb_read(&board, &b);
+        dt = now_ns() - t;
+        wk->reads++;
+        wk->read_ns += dt;
+        if (dt > wk->read_max)
+            wk->read_max = dt;
+        for (i = 1; i < b.count; i++)
+            if (rank(&b.top[i - 1]) < rank(&b.top[i]))
+                wk->bad++;
+        if (b.version < version)
+            wk->bad++;
+        version = b.version;
+    }
+    return NULL;
+}
+
+/*!
+ * \brief Count the entries of the board that differ from the reference.
+ *
+ * The reference is the best result of every player, from all the results.
+ */
+static int check(const lb_board *b, int writers, int k)
+{
+    unsigned long long *best = calloc(players, sizeof *best);
+    unsigned long long *top = calloc(k, sizeof *top);
+    lb_result r;
+    long i;
+    int w, j, n = 0, bad = 0;
+    unsigned p;
+
+    for (w = 0; w < writers; w++)
+        for (i = 0; i < results; i++)
+        {
+            result(w, i, &r);
+            if (rank(&r) + 1 > best[r.player])
+                best[r.player] = rank(&r) + 1;
+        }
+
+    /* the k best players, best first */
+    for (p = 0; p < players; p++)
+    {
+        if (!best[p] || (n == k && best[p] <= top[n - 1]))
+            continue;
+        if (n < k)
+            n++;
+        for (j = n - 1; j > 0 && top[j - 1] < best[p]; j--)
+            top[j] = top[j - 1];
+        top[j] = best[p];
+    }
+
+    if (b->count != n)
+        bad++;
+    for (j = 0; j < b->count && j < n; j++)
+        if (rank(&b->top[j]) + 1 != top[j]
+                || best[b->top[j].player] != top[j])
+            bad++;
+    free(best);
+    free(top);
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    static worker writers[MAX_THREADS], readers[MAX_THREADS];
+    int nw = 4, nr = 1, k = 10;
+    long long t, retries = 0, filtered = 0, reads = 0, read_ns = 0;
+    long long read_max = 0;
+    double s;
+    lb_board b;
+    int c, i, bad = 0;
+
+    while ((c = getopt(argc, argv, "w:r:n:k:p:R")) != -1)
+    {
+        switch (c)
+        {
+            case 'w': nw = atoi(optarg); break;
+            case 'r': nr = atoi(optarg); break;
+            case 'n': results = atol(optarg); break;
+            case 'k': k = atoi(optarg); break;
+            case 'p': players = atoi(optarg); break;
+            case 'R': rising = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-w writers] [-r readers] "
+                        "[-n results] [-k players_kept] [-p players] [-R]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (nw < 1 || nw > MAX_THREADS || nr < 0 || nr > MAX_THREADS
+            || results < 1 || players < 1 || lb_init(&board, k) != 0)
+    {
+        fprintf(stderr, "%s: bad arguments\n", argv[0]);
+        return 1;
+    }
+    if (lb_start(&board) != 0)
+    {
+        perror("merge thread");
+        return 1;
+    }
+
+    for (i = 0; i < nr; i++)
+    {
+        readers[i].id = i;
+        pthread_create(&readers[i].thread, NULL, reader_run, &readers[i]);
+    }
+    t = now_ns();
+    for (i = 0; i < nw; i++)
+    {
+        writers[i].id = i;
+        pthread_create(&writers[i].thread, NULL, writer_run, &writers[i]);
+    }
+    for (i = 0; i < nw; i++)
+    {
+        pthread_join(writers[i].thread, NULL);
+        retries += writers[i].retries;
+        filtered += writers[i].filtered;
+    }
+    s = (now_ns() - t) / 1e9;
+    readers_stop = 1;
+    for (i = 0; i < nr; i++)
+    {
+        pthread_join(readers[i].thread, NULL);
+        reads += readers[i].reads;
+        read_ns += readers[i].read_ns;
+        read_max = readers[i].read_max > read_max ? readers[i].read_max
+            : read_max;
+        bad += readers[i].bad;
+    }
+
+    /* last merge and publication */
+    lb_destroy(&board);
+    lb_read(&board, &b);
+
+    printf("%d writers, %d readers, %ld results each, %s scores\n",
+            nw, nr, results, rising ? "rising" : "uniform");
+    printf("inserts: %.0f/s in %.3f s, %.1f%% below the board, "
+            "%lld retried\n", nw * results / s, s,
+            100.0 * filtered / (nw * results), retries);
+    printf("merged: %lld results, %llu boards published\n",
+            b.merged, b.version);
+    if (reads)
+        printf("reads: %lld, %.0f ns mean, %lld ns max\n",
+                reads, (double) read_ns / reads, read_max);
+    bad += check(&b, nw, k);
+    printf("board: %d players, best %d/%d/%d, %s\n", b.count,
+            b.count ? b.top[0].score : 0, b.count ? b.top[0].level : 0,
+            b.count ? b.top[0].rally : 0, bad ? "WRONG" : "matches");
+    return bad != 0;
+}
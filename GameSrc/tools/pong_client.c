@@ -0,0 +1,363 @@
+/*!
+ * \file pong_client.c
+ *
+ * \brief Thin client of the game in wire mode (wire.h).
+ *
+ * The client runs the game command with its standard input and output on
+ * pipes, asking for wire mode with the size of the local terminal
+ * (-W colsxrows is appended to the command). The game sends the frame
+ * deltas on its output, and the client lays out the court, the moving
+ * objects and the menus on the local terminal with ncurses, so that only
+ * the deltas cross the link. The keys go back to the game on its input.
+ *
+ * With -v the client attaches instead to the spectator socket of a game
+ * started with -v path (spectate.h), and shows the game without playing.
+ *
+ * On exit the client prints the bytes it received from the game.
+ *
+ * Build: gcc -O2 -I.. pong_client.c ../wire.c -lncurses -o pong-client
+ * Usage: pong-client [command [args...]]   (default ./pong)
+ *        pong-client ssh host ./pong
+ *        pong-client -v path
+ */
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "rules.h"
+#include "wire.h"
+
+#define PADDLE_COLOR 1 /*!< color pair of the player paddle, as the game */
+#define BALL_COLOR 2 /*!< color pair of the ball */
+#define AI_COLOR 3 /*!< color pair of the ai paddle */
+#define TITLE_COLOR 4 /*!< color pair of the menus */
+#define COURT_COLOR 5 /*!< color pair of the court lines */
+#define PADDLE_MARGIN 2 /*!< columns kept free for each paddle */
+
+/*!
+ * What the game told the client so far
+ */
+typedef struct {
+    int rows; /*!< court rows, 0 before the first game */
+    int cols; /*!< court columns */
+    int level; /*!< game level */
+    int won; /*!< games won by the player */
+    int lost; /*!< games lost by the player */
+    int playing; /*!< objects were sent since the court */
+    int menu; /*!< WIRE_MENU_* menu on screen, -1 for none */
+    int arg; /*!< menu argument */
+    wire_objects o; /*!< moving objects */
+} scene;
+
+/*!
+ * Print a line centered on a row.
+ */
+static void center(int y, const char *text)
+{
+    int len = strlen(text);
+
+    attron(COLOR_PAIR(TITLE_COLOR));
+    mvaddstr(y, MAX((COLS - len) / 2, 0), text);
+    attroff(COLOR_PAIR(TITLE_COLOR));
+}
+
+/*!
+ * Draw a paddle from its centre row, two columns wide from col.
+ */
+static void paddle(int row, int col, int pair)
+{
+    int i;
+
+    attron(COLOR_PAIR(pair));
+    for (i = 0; i < PADDLE_WIDTH; ++i)
+    {
+        mvaddch(row - PADDLE_WIDTH / 2 + i, col, ' ');
+        mvaddch(row - PADDLE_WIDTH / 2 + i, col + 1, ' ');
+    }
+    attroff(COLOR_PAIR(pair));
+}
+
+/*!
+ * Lay out the whole scene; ncurses sends only what changed.
+ */
+static void draw(const scene *s)
+{
+    char text[64];
+    int y, len;
+
+    erase();
+    if (s->rows > 0)
+    {
+        /* court lines and score frame, as the game composes them */
+        attron(COLOR_PAIR(COURT_COLOR));
+        mvhline(0, PADDLE_MARGIN, ACS_HLINE, s->cols - 2 * PADDLE_MARGIN);
+        mvhline(s->rows - 1, PADDLE_MARGIN, ACS_HLINE,
+                s->cols - 2 * PADDLE_MARGIN);
+        for (y = 1; y < s->rows - 1; y += 2)
+            mvaddch(y, s->cols / 2, ACS_VLINE);
+        attron(A_BOLD);
+        len = snprintf(text, sizeof text, " level %d  %d:%d ",
+                s->level, s->won, s->lost);
+        mvaddch(0, (s->cols - len - 2) / 2, ACS_RTEE);
+        addstr(text);
+        addch(ACS_LTEE);
+        attroff(COLOR_PAIR(COURT_COLOR) | A_BOLD);
+    }
+    if (s->playing)
+    {
+        paddle(s->o.player, s->cols - 2, PADDLE_COLOR);
+        paddle(s->o.ai, AI_COL, AI_COLOR);
+        attron(COLOR_PAIR(BALL_COLOR));
+        mvaddch(s->o.ball_y, s->o.ball_x, 'o');
+        attroff(COLOR_PAIR(BALL_COLOR));
+    }
+
+    y = LINES / 2;
+    switch (s->menu)
+    {
+        case WIRE_MENU_INTRO:
+            center(y, "PONG");
+            center(y + 1, "use up and down arrow keys to control the pad");
+            center(y + 2, "press space to start, q to quit");
+            break;
+
+        case WIRE_MENU_WON:
+        case WIRE_MENU_LOST:
+            center(y, s->menu == WIRE_MENU_WON ? "GAME WON" : "GAME LOST");
+            center(y + 1, "press space to restart, q to quit");
+            break;
+
+        case WIRE_MENU_LEVEL:
+            snprintf(text, sizeof text,
+                    "Congratulation you have cleared level %d ", s->arg);
+            center(0, text);
+            center(1, "press space to restart, q to quit");
+            break;
+
+        default:
+            break;
+    }
+    refresh();
+}
+
+/*!
+ * Apply a message to the scene.
+ */
+static void apply(scene *s, const wire_msg *m)
+{
+    switch (m->type)
+    {
+        case WIRE_COURT:
+            s->rows = m->v[0];
+            s->cols = m->v[1];
+            s->playing = 0;
+            s->menu = -1;
+            break;
+
+        case WIRE_SCORE:
+            s->level = m->v[0];
+            s->won = m->v[1];
+            s->lost = m->v[2];
+            break;
+
+        case WIRE_FRAME:
+            s->playing = 1;
+            break;
+
+        case WIRE_MENU:
+            s->menu = m->v[0];
+            s->arg = m->v[1];
+            break;
+    }
+}
+
+/*!
+ * Send a key to the game, as an xterm in keypad mode would.
+ */
+static void send_key(int fd, int ch)
+{
+    char c = ch;
+    ssize_t n = 0;
+
+    if (fd < 0)
+        return; /* spectators don't play */
+    if (ch == KEY_UP)
+        n = write(fd, "\033OA", 3);
+    else if (ch == KEY_DOWN)
+        n = write(fd, "\033OB", 3);
+    else if (ch >= 0 && ch < 256)
+        n = write(fd, &c, 1);
+    (void) n; /* a gone game shows up on its output */
+}
+
+/*!
+ * Run the game command on pipes, return its pid.
+ */
+static pid_t start_game(char **cmd, int *in, int *out)
+{
+    int to_game[2], from_game[2];
+    pid_t pid;
+
+    if (pipe(to_game) != 0 || pipe(from_game) != 0)
+        return -1;
+    pid = fork();
+    if (pid == 0)
+    {
+        dup2(to_game[0], STDIN_FILENO);
+        dup2(from_game[1], STDOUT_FILENO);
+        close(to_game[0]);
+        close(to_game[1]);
+        close(from_game[0]);
+        close(from_game[1]);
+        execvp(cmd[0], cmd);
+        perror(cmd[0]);
+        _exit(127);
+    }
+    close(to_game[0]);
+    close(from_game[1]);
+    *in = to_game[1];
+    *out = from_game[0];
+    return pid;
+}
+
+/*!
+ * Connect to the spectator socket of a game, return the socket.
+ */
+static int watch_game(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    char size[32];
+    char **cmd = calloc(argc + 3, sizeof *cmd);
+    unsigned char buf[4096];
+    size_t len = 0;
+    long long received = 0;
+    struct timespec t0, t1;
+    double secs;
+    struct pollfd p[2];
+    scene s = { 0 };
+    wire_msg m;
+    int game_in, game_out, status, i, n;
+    pid_t pid;
+
+    signal(SIGPIPE, SIG_IGN); /* a gone game shows up as EOF */
+
+    initscr();
+    noecho();
+    curs_set(0);
+    keypad(stdscr, TRUE);
+    timeout(0);
+    start_color();
+    init_pair(PADDLE_COLOR, COLOR_WHITE, COLOR_BLUE);
+    init_pair(BALL_COLOR, COLOR_RED, COLOR_BLACK);
+    init_pair(TITLE_COLOR, COLOR_GREEN, COLOR_BLACK);
+    init_pair(AI_COLOR, COLOR_WHITE, COLOR_YELLOW);
+    init_pair(COURT_COLOR, COLOR_GREEN, COLOR_BLACK);
+
+    /* the game command, with the court size of this terminal */
+    n = 0;
+    if (argc > 1)
+        for (i = 1; i < argc; ++i)
+            cmd[n++] = argv[i];
+    else
+        cmd[n++] = "./pong";
+    snprintf(size, sizeof size, "%dx%d", COLS, LINES);
+    cmd[n++] = "-W";
+    cmd[n++] = size;
+    cmd[n] = NULL;
+
+    if (argc == 3 && strcmp(argv[1], "-v") == 0)
+    {
+        pid = 0;
+        game_in = -1;
+        game_out = watch_game(argv[2]);
+        if (game_out < 0)
+        {
+            endwin();
+            perror(argv[2]);
+            return EXIT_FAILURE;
+        }
+    } else
+        pid = start_game(cmd, &game_in, &game_out);
+    if (pid < 0)
+    {
+        endwin();
+        perror("cannot start the game");
+        return EXIT_FAILURE;
+    }
+
+    s.menu = -1;
+    n = 0;
+    p[0].fd = game_out;
+    p[0].events = POLLIN;
+    p[1].fd = STDIN_FILENO;
+    p[1].events = POLLIN;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (poll(p, 2, -1) >= 0)
+    {
+        if (p[1].revents & POLLIN)
+            while ((i = getch()) != ERR)
+            {
+                if (game_in < 0 && i == 'q')
+                    goto done; /* a spectator leaves */
+                send_key(game_in, i);
+            }
+
+        if (p[0].revents & (POLLIN | POLLHUP))
+        {
+            n = read(game_out, buf + len, sizeof buf - len);
+            if (n <= 0)
+                break; /* the game ended */
+            received += n;
+            len += n;
+
+            /* apply the complete messages, keep the rest for later */
+            for (i = 0; (n = wire_decode(buf + i, len - i, &m, &s.o)) > 0;
+                    i += n)
+                apply(&s, &m);
+            if (n < 0)
+                break;
+            memmove(buf, buf + i, len - i);
+            len -= i;
+            draw(&s);
+        }
+    }
+done:
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    endwin();
+    if (pid > 0)
+    {
+        close(game_in);
+        waitpid(pid, &status, 0);
+    } else
+        close(game_out);
+    if (n < 0)
+        fprintf(stderr, "malformed stream from the game\n");
+    fprintf(stderr, "received %lld bytes in %.1f s: %.1f bytes/s\n",
+            received, secs, received / secs);
+    free(cmd);
+    return n < 0 ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,551 @@
+/*!
+ * \file pong_load.c
+ *
+ * \brief Synthetic players for the socket mode of the game (lobby.h).
+ *
+ * The load generator starts the game in socket mode (-S path is appended
+ * to the command) and, for every client count of the list, connects that
+ * many scripted players, each getting a game of its own. The players use
+ * the vocabulary of the keyboard handler: they start and restart games
+ * with the space key and chase the ball with the arrow keys or, for a
+ * share of the inputs, with a mouse report on the ball row, at a human
+ * rate with jitter.
+ *
+ * Three latencies are measured on every client, and reported as
+ * percentiles over all the clients of a count:
+ *
+ *  - frame lateness: how much later than BALL_DELAY of the level a frame
+ *    moving the ball arrives after the previous one
+ *  - input acknowledge: time from an input that moves the paddle to the
+ *    first frame where the paddle moved
+ *  - server cpu: cpu time of the server and its games during the
+ *    measurement, in percent of a core
+ *
+ * The load generator runs on the same host, so its own cpu time is shown
+ * too. Each count prints one line, for plotting scaling curves.
+ *
+ * Build: gcc -O2 -I.. pong_load.c ../wire.c -o pong-load
+ * Usage: pong-load [-c counts] [-d secs] [-w secs] [-r rate] [-j jitter]
+ *                  [-m mouse%] [command [args...]]   (default ./pong)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "rules.h"
+#include "wire.h"
+
+#define MAX_COUNTS 16 /*!< max client counts in a run */
+#define MENU_DELAY 300000 /*!< us a player takes to answer a menu */
+#define START_US 30000000 /*!< time allowed for all the games to start */
+#define LINE 4096 /*!< bytes of a /proc stat line */
+
+/*!
+ * Scripted player
+ */
+typedef struct {
+    int fd; /*!< connection to its game */
+    unsigned char buf[1024]; /*!< received bytes not decoded yet */
+    size_t len; /*!< bytes in buf */
+    wire_objects o; /*!< objects of the game */
+    int rows; /*!< court rows */
+    int cols; /*!< court columns */
+    int level; /*!< game level */
+    int menu; /*!< menu on screen, -1 while playing */
+    int started; /*!< the intro menu arrived */
+    long long next; /*!< time of the next input */
+    long long key_at; /*!< time of the oldest input not acknowledged */
+    long long ball_at; /*!< arrival of the last frame moving the ball */
+} player;
+
+/*!
+ * Growing array of latencies in us
+ */
+typedef struct {
+    long long *v; /*!< samples */
+    size_t n; /*!< samples used */
+    size_t cap; /*!< samples allocated */
+} samples;
+
+static int measuring; /*!< samples are kept */
+static samples late; /*!< frame lateness samples */
+static samples ack; /*!< input acknowledge samples */
+static long frames; /*!< frames received while measuring */
+
+/*!
+ * Return the monotonic time in us.
+ */
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*!
+ * Keep a sample while measuring.
+ */
+static void add(samples *s, long long v)
+{
+    if (!measuring)
+        return;
+    if (s->n == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 4096;
+        s->v = realloc(s->v, s->cap * sizeof *s->v);
+        if (s->v == NULL)
+        {
+            perror("allocation error");
+            exit(EXIT_FAILURE);
+        }
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long*) a, y = *(const long long*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * Return the p-th percentile in ms, the samples being sorted.
+ */
+static double pct(const samples *s, double p)
+{
+    size_t i;
+
+    if (s->n == 0)
+        return 0;
+    i = (size_t) (p / 100 * (s->n - 1) + 0.5);
+    return s->v[i] / 1000.0;
+}
+
+/*!
+ * Return the cpu time in ns of a process and of the live processes it
+ * started, from the scheduler statistics, finer than the clock ticks of
+ * the process times.
+ */
+static long long tree_cpu(pid_t root)
+{
+    DIR *d = opendir("/proc");
+    struct dirent *e;
+    char path[300], line[LINE];
+    long long total = 0;
+
+    while (d && (e = readdir(d)) != NULL)
+    {
+        FILE *f;
+        char *p;
+        long ppid = 0;
+        long long ns;
+
+        if (e->d_name[0] < '0' || e->d_name[0] > '9')
+            continue;
+        snprintf(path, sizeof path, "/proc/%s/stat", e->d_name);
+        if ((f = fopen(path, "r")) == NULL)
+            continue;
+
+        /* the parent follows the command name, which may hold spaces */
+        if (fgets(line, sizeof line, f) && (p = strrchr(line, ')')) != NULL)
+            sscanf(p + 2, "%*c %ld", &ppid);
+        fclose(f);
+        if (ppid != root && atol(e->d_name) != root)
+            continue;
+
+        snprintf(path, sizeof path, "/proc/%s/schedstat", e->d_name);
+        if ((f = fopen(path, "r")) == NULL)
+            continue;
+        if (fscanf(f, "%lld", &ns) == 1)
+            total += ns;
+        fclose(f);
+    }
+    if (d)
+        closedir(d);
+    return total;
+}
+
+/*!
+ * Send bytes to the game; a game gone shows up on its output.
+ */
+static void send_input(player *p, const char *bytes, size_t len)
+{
+    ssize_t n = write(p->fd, bytes, len);
+
+    (void) n;
+}
+
+/*!
+ * Next input time: the mean gap, give or take jitter of it.
+ */
+static long long next_gap(double rate, double jitter)
+{
+    double u = 2.0 * rand() / RAND_MAX - 1;
+
+    return (long long) (1e6 / rate * (1 + jitter * u));
+}
+
+/*!
+ * Play an input: answer a menu, or chase the ball.
+ */
+static void play(player *p, long long now, double rate, double jitter,
+        int mouse)
+{
+    int top = PADDLE_WIDTH / 2, bottom = p->rows - 1 - PADDLE_WIDTH / 2;
+    int target = MIN(MAX(p->o.ball_y, top), bottom);
+    char report[32];
+
+    if (p->menu >= 0)
+    {
+        send_input(p, " ", 1);
+        p->menu = -1;
+        p->ball_at = 0;
+        p->next = now + MENU_DELAY;
+        return;
+    }
+    p->next = now + next_gap(rate, jitter);
+    if (p->rows == 0 || target == p->o.player)
+        return;
+
+    if (rand() % 100 < mouse)
+    {
+        /* pointer on the ball row, 1-based as the terminal reports it */
+        int n = snprintf(report, sizeof report, "\033[<35;%d;%dM",
+                p->cols / 2, target + 1);
+
+        send_input(p, report, n);
+    } else
+        send_input(p, target < p->o.player ? "\033OA" : "\033OB", 3);
+    if (p->key_at == 0)
+        p->key_at = now;
+}
+
+/*!
+ * Read and apply what the game sent, return -1 if it is gone.
+ */
+static int receive(player *p, long long now)
+{
+    wire_msg m;
+    ssize_t n = read(p->fd, p->buf + p->len, sizeof p->buf - p->len);
+    size_t i = 0;
+    int used;
+
+    if (n <= 0)
+        return n < 0 && errno == EAGAIN ? 0 : -1;
+    p->len += n;
+    while ((used = wire_decode(p->buf + i, p->len - i, &m, &p->o)) > 0)
+    {
+        i += used;
+        switch (m.type)
+        {
+            case WIRE_COURT:
+                p->rows = m.v[0];
+                p->cols = m.v[1];
+                p->menu = -1;
+                p->ball_at = 0;
+                break;
+
+            case WIRE_SCORE:
+                p->level = m.v[0];
+                break;
+
+            case WIRE_MENU:
+                if (!p->started)
+                    p->started = 1;
+                p->menu = m.v[0];
+                p->ball_at = 0;
+                p->key_at = 0;
+                p->next = now + MENU_DELAY;
+                break;
+
+            case WIRE_FRAME:
+                if (measuring)
+                    frames++;
+                if ((m.v[0] & WIRE_PLAYER) && p->key_at)
+                {
+                    add(&ack, now - p->key_at);
+                    p->key_at = 0;
+                }
+                if (m.v[0] & WIRE_BALL)
+                {
+                    if (p->ball_at && BALL_DELAY(p->level) > 0)
+                        add(&late, MAX(now - p->ball_at
+                                    - BALL_DELAY(p->level), 0));
+                    p->ball_at = now;
+                }
+                break;
+        }
+    }
+    if (used < 0)
+        return -1;
+    memmove(p->buf, p->buf + i, p->len - i);
+    p->len -= i;
+    return 0;
+}
+
+/*!
+ * Connect a player to the socket of the game.
+ */
+static int join(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/*!
+ * Run the players for a time, return the number still connected.
+ */
+static int run(player *pl, int n, int ep, long long until, double rate,
+        double jitter, int mouse)
+{
+    struct epoll_event ev[256];
+    int i, k, alive = n;
+
+    while (now_us() < until)
+    {
+        long long now;
+
+        k = epoll_wait(ep, ev, 256, 1);
+        now = now_us();
+        for (i = 0; i < k; ++i)
+        {
+            player *p = &pl[ev[i].data.u32];
+
+            if (p->fd >= 0 && receive(p, now) != 0)
+            {
+                close(p->fd);
+                p->fd = -1;
+                alive--;
+            }
+        }
+        for (i = 0; i < n; ++i)
+            if (pl[i].fd >= 0 && pl[i].started && now >= pl[i].next)
+                play(&pl[i], now, rate, jitter, mouse);
+    }
+    return alive;
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-c counts] [-d secs] [-w secs] [-r rate] "
+            "[-j jitter] [-m mouse%%] [command [args...]]\n"
+            "  -c  client counts, comma separated (default 1,10,100,1000)\n"
+            "  -d  seconds measured for each count (default 10)\n"
+            "  -w  seconds of warm-up before measuring (default 2)\n"
+            "  -r  inputs per second of a player (default 8)\n"
+            "  -j  jitter of the input gaps, 0 to 1 (default 0.5)\n"
+            "  -m  percent of the inputs made with the mouse (default 20)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    int counts[MAX_COUNTS], ncounts = 0;
+    double secs = 10, warm = 2, rate = 8, jitter = 0.5;
+    int mouse = 20;
+    char path[64], *list = "1,10,100,1000", *tok;
+    char **cmd;
+    struct rlimit rl;
+    pid_t server;
+    int c, i, n, opt;
+
+    while ((opt = getopt(argc, argv, "+c:d:w:r:j:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                list = optarg;
+                break;
+
+            case 'd':
+                secs = atof(optarg);
+                break;
+
+            case 'w':
+                warm = atof(optarg);
+                break;
+
+            case 'r':
+                rate = atof(optarg);
+                break;
+
+            case 'j':
+                jitter = atof(optarg);
+                break;
+
+            case 'm':
+                mouse = atoi(optarg);
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    for (tok = strtok(list, ","); tok && ncounts < MAX_COUNTS;
+            tok = strtok(NULL, ","))
+        if ((counts[ncounts++] = atoi(tok)) < 1)
+            ncounts = MAX_COUNTS + 1;
+    if (ncounts < 1 || ncounts > MAX_COUNTS || secs <= 0 || warm < 0
+            || rate <= 0 || jitter < 0 || jitter > 1 || mouse < 0
+            || mouse > 100)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* a socket per player */
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    signal(SIGPIPE, SIG_IGN);
+    srand(1);
+
+    /* the game command, in socket mode */
+    snprintf(path, sizeof path, "/tmp/pong-load.%d", (int) getpid());
+    cmd = calloc(argc - optind + 4, sizeof *cmd);
+    n = 0;
+    if (optind < argc)
+        for (i = optind; i < argc; ++i)
+            cmd[n++] = argv[i];
+    else
+        cmd[n++] = "./pong";
+    cmd[n++] = "-S";
+    cmd[n++] = path;
+    cmd[n] = NULL;
+    server = fork();
+    if (server == 0)
+    {
+        execvp(cmd[0], cmd);
+        perror(cmd[0]);
+        _exit(127);
+    }
+    while (access(path, F_OK) != 0)
+    {
+        if (waitpid(server, NULL, WNOHANG) != 0)
+        {
+            fprintf(stderr, "the game didn't start\n");
+            return EXIT_FAILURE;
+        }
+        usleep(10000);
+    }
+
+    printf("%8s %9s %29s %29s %8s %8s\n", "", "",
+            "frame lateness ms", "input acknowledge ms", "", "");
+    printf("%8s %9s %7s %7s %7s %7s %7s %7s %7s %7s %8s %8s\n",
+            "clients", "frames/s", "p50", "p90", "p99", "max",
+            "p50", "p90", "p99", "max", "server%", "load%");
+
+    for (c = 0; c < ncounts; ++c)
+    {
+        struct epoll_event ev;
+        struct rusage r0, r1;
+        player *pl = calloc(counts[c], sizeof *pl);
+        int ep = epoll_create1(0);
+        long long t0, cpu0, cpu1, start, load;
+        int ready, alive;
+
+        n = counts[c];
+        if ((rlim_t) n + 16 > rl.rlim_cur)
+        {
+            fprintf(stderr, "open file limit %ld is too low for %d players\n",
+                    (long) rl.rlim_cur, n);
+            break;
+        }
+
+        /* the players join and wait for their intro menu */
+        for (i = 0; i < n; ++i)
+        {
+            pl[i].fd = join(path);
+            pl[i].menu = -1;
+            if (pl[i].fd < 0)
+            {
+                perror("connect");
+                return EXIT_FAILURE;
+            }
+            ev.events = EPOLLIN;
+            ev.data.u32 = i;
+            epoll_ctl(ep, EPOLL_CTL_ADD, pl[i].fd, &ev);
+        }
+        start = now_us();
+        do
+        {
+            run(pl, n, ep, now_us() + 10000, rate, jitter, mouse);
+            for (i = ready = 0; i < n; ++i)
+                ready += pl[i].started;
+        } while (ready < n && now_us() - start < START_US);
+
+        /* warm up, then measure */
+        run(pl, n, ep, now_us() + (long long) (warm * 1e6), rate, jitter,
+                mouse);
+        late.n = ack.n = 0;
+        frames = 0;
+        measuring = 1;
+        getrusage(RUSAGE_SELF, &r0);
+        cpu0 = tree_cpu(server);
+        t0 = now_us();
+        alive = run(pl, n, ep, t0 + (long long) (secs * 1e6), rate, jitter,
+                mouse);
+        t0 = now_us() - t0;
+        cpu1 = tree_cpu(server);
+        getrusage(RUSAGE_SELF, &r1);
+        measuring = 0;
+        load = (r1.ru_utime.tv_sec - r0.ru_utime.tv_sec
+                + r1.ru_stime.tv_sec - r0.ru_stime.tv_sec) * 1000000LL
+            + r1.ru_utime.tv_usec - r0.ru_utime.tv_usec
+            + r1.ru_stime.tv_usec - r0.ru_stime.tv_usec;
+
+        qsort(late.v, late.n, sizeof *late.v, cmp_ll);
+        qsort(ack.v, ack.n, sizeof *ack.v, cmp_ll);
+        printf("%8d %9.0f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f "
+                "%8.1f %8.1f", n, frames * 1e6 / t0,
+                pct(&late, 50), pct(&late, 90), pct(&late, 99),
+                pct(&late, 100), pct(&ack, 50), pct(&ack, 90),
+                pct(&ack, 99), pct(&ack, 100),
+                (cpu1 - cpu0) / 10.0 / t0,
+                100.0 * load / t0);
+        if (ready < n || alive < n)
+            printf("  (%d started, %d left)", ready, n - alive);
+        printf("\n");
+        fflush(stdout);
+
+        /* the players leave, their games end */
+        for (i = 0; i < n; ++i)
+            if (pl[i].fd >= 0)
+                close(pl[i].fd);
+        close(ep);
+        free(pl);
+        usleep(500000);
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    unlink(path);
+    free(cmd);
+    return 0;
+}
@@ -0,0 +1,502 @@
+/*!
+ * \file pong_tournament.c
+ *
+ * \brief Round-robin tournament of paddle controllers with Elo ratings.
+ *
+ * Every pair of controllers plays a duel on each seed of the seed list,
+ * once from each side. A seed fixes the field size and the serve, so the
+ * results depend only on the seed list, not on the number of threads.
+ * Duels run in batches of matches in lockstep, each controller deciding
+ * for the whole batch in one decide_batch call, and the batches are
+ * fanned out over all the cores while the progress streams on stderr.
+ *
+ * In a duel both paddles move at most one row every period ball steps,
+ * the game levels don't apply and the first miss loses; a duel lasting
+ * MAX_STEPS ball steps is a draw. Ratings are the maximum likelihood Elo
+ * fit of all the results (a draw counts half a win for each side) with
+ * mean 1500, and the 95% confidence intervals come from resampling the
+ * seeds.
+ *
+ * Build: gcc -O2 -pthread -I.. pong_tournament.c ../controller.c ../mlp.c \
+ *            ../plugin.c ../rules.c -lm -ldl -o pong-tournament
+ * Usage: pong-tournament [-m weights]... [-P plugin]... [-n seeds] [-s seed]
+ *                        [-S seed_file] [-p period] [-j threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "controller.h"
+#include "mlp.h"
+#include "plugin.h"
+
+#define MAX_CTL 32 /*!< max controllers in a tournament */
+#define MAX_THREADS 256 /*!< max worker threads */
+#define CHUNK 64 /*!< seeds per work item */
+#define MAX_STEPS 5000 /*!< ball steps before a duel is a draw */
+#define BOOTSTRAP 200 /*!< resamples of the confidence intervals */
+
+/*!
+ * Tournament, shared by the worker threads
+ */
+typedef struct {
+    controller *ctl[MAX_CTL]; /*!< competitors */
+    int nctl; /*!< number of competitors */
+    int (*pair)[2]; /*!< competitors of each pairing */
+    int npairs; /*!< number of pairings */
+    const unsigned *seed; /*!< seed list */
+    int nseeds; /*!< number of seeds */
+    int period; /*!< ball steps per paddle move */
+    int next; /*!< next work item, taken atomically */
+    int done; /*!< duels played, updated atomically */
+    unsigned char *score; /*!< doubled score of pair[0], per pairing seed */
+} tournament;
+
+/*!
+ * Return a well mixed 32 bit hash of x.
+ */
+static unsigned mix(unsigned x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+/*!
+ * Serve the duel of a seed: the seed picks the field size and the serve.
+ */
+static void serve(match_state *m, unsigned seed)
+{
+    unsigned h = mix(seed);
+
+    match_serve(m, 16 + h % 33, 40 + (h >> 8) % 121, (h >> 16) & 1 ? 1 : -1);
+}
+
+/*!
+ * Play the duels of n seeds between a on the ai side and b on the player
+ * side, in lockstep; store in score[i] the doubled score of a.
+ */
+static void duel_batch(tournament *t, controller *a, controller *b,
+        const unsigned *seed, int n, int *score)
+{
+    match_state m[CHUNK];
+    ctl_view view[CHUNK];
+    int intent_a[CHUNK], intent_b[CHUNK];
+    int live[CHUNK];
+    int nlive = n;
+    int i, s;
+
+    for (i = 0; i < n; ++i)
+    {
+        serve(&m[i], seed[i]);
+        score[i] = 1;
+        live[i] = i;
+    }
+
+    for (s = 0; s < MAX_STEPS && nlive > 0; ++s)
+    {
+        int moving = s % t->period == 0;
+        int k = 0;
+
+        if (moving)
+        {
+            for (i = 0; i < nlive; ++i)
+                ctl_view_of(&m[live[i]], SIDE_AI, &view[i]);
+            a->decide_batch(a, view, nlive, intent_a);
+            for (i = 0; i < nlive; ++i)
+                ctl_view_of(&m[live[i]], SIDE_PLAYER, &view[i]);
+            b->decide_batch(b, view, nlive, intent_b);
+        }
+
+        for (i = 0; i < nlive; ++i)
+        {
+            match_state *mi = &m[live[i]];
+            int ev;
+
+            if (moving)
+            {
+                ai_move(mi, intent_a[i]);
+                player_step(mi, intent_b[i]);
+            }
+            ev = ball_step(mi);
+
+            /* no levels in a duel: only a miss ends it */
+            mi->gameLevel = 0;
+            mi->hitCnt = 0;
+            if ((ev & BALL_AI_WINS) || ((ev & BALL_PLAYER_WINS)
+                        && !(ev & BALL_HIT_PLAYER)))
+                score[live[i]] = (ev & BALL_AI_WINS) ? 2 : 0;
+            else
+                live[k++] = live[i];
+        }
+        nlive = k;
+    }
+}
+
+/*!
+ * Worker thread: play work items until none is left.
+ */
+static void *worker(void *arg)
+{
+    tournament *t = arg;
+    int chunks = (t->nseeds + CHUNK - 1) / CHUNK;
+    int item;
+
+    while ((item = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED))
+            < t->npairs * chunks)
+    {
+        int p = item / chunks;
+        int first = (item % chunks) * CHUNK;
+        int n = MIN(CHUNK, t->nseeds - first);
+        controller *a = t->ctl[t->pair[p][0]];
+        controller *b = t->ctl[t->pair[p][1]];
+        int left[CHUNK], right[CHUNK];
+        int i;
+
+        /* each seed is played from both sides */
+        duel_batch(t, a, b, &t->seed[first], n, left);
+        duel_batch(t, b, a, &t->seed[first], n, right);
+        for (i = 0; i < n; ++i)
+            t->score[p * t->nseeds + first + i] = left[i] + 2 - right[i];
+
+        __atomic_fetch_add(&t->done, 2 * n, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/*!
+ * Fit the Elo ratings of the results of the given seeds (the seed indices
+ * may repeat) by minorization-maximization of the Bradley-Terry
+ * likelihood.
+ */
+static void fit_elo(const tournament *t, const int *use, double *elo)
+{
+    double wins[MAX_CTL], games[MAX_CTL][MAX_CTL];
+    double gamma[MAX_CTL];
+    double mean = 0.0;
+    int p, i, j, it;
+
+    memset(wins, 0, sizeof wins);
+    memset(games, 0, sizeof games);
+    for (p = 0; p < t->npairs; ++p)
+    {
+        int a = t->pair[p][0], b = t->pair[p][1];
+
+        for (i = 0; i < t->nseeds; ++i)
+        {
+            /* two duels, score in quarters of a win */
+            double s = t->score[p * t->nseeds + use[i]] / 2.0;
+
+            wins[a] += s;
+            wins[b] += 2.0 - s;
+            games[a][b] += 2.0;
+            games[b][a] += 2.0;
+        }
+    }
+
+    /* half a draw against a virtual peer keeps the fit finite */
+    for (i = 0; i < t->nctl; ++i)
+    {
+        wins[i] += 0.5;
+        gamma[i] = 1.0;
+    }
+
+    for (it = 0; it < 500; ++it)
+    {
+        for (i = 0; i < t->nctl; ++i)
+        {
+            double den = 1.0 / (gamma[i] + 1.0);
+
+            for (j = 0; j < t->nctl; ++j)
+                if (j != i && games[i][j] > 0.0)
+                    den += games[i][j] / (gamma[i] + gamma[j]);
+            gamma[i] = wins[i] / den;
+        }
+    }
+
+    for (i = 0; i < t->nctl; ++i)
+    {
+        elo[i] = 400.0 * log10(gamma[i]);
+        mean += elo[i] / t->nctl;
+    }
+    for (i = 0; i < t->nctl; ++i)
+        elo[i] += 1500.0 - mean;
+}
+
+/*!
+ */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * Print the ratings with their bootstrap confidence intervals.
+ */
+static void report(const tournament *t)
+{
+    static double boot[MAX_CTL][BOOTSTRAP];
+    double elo[MAX_CTL], e[MAX_CTL];
+    int *use = malloc(t->nseeds * sizeof *use);
+    int order[MAX_CTL];
+    unsigned rng = 12345;
+    int i, j, r;
+
+    if (use == NULL)
+    {
+        perror("allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < t->nseeds; ++i)
+        use[i] = i;
+    fit_elo(t, use, elo);
+
+    for (r = 0; r < BOOTSTRAP; ++r)
+    {
+        for (i = 0; i < t->nseeds; ++i)
+            use[i] = (rng = mix(rng + 1)) % t->nseeds;
+        fit_elo(t, use, e);
+        for (i = 0; i < t->nctl; ++i)
+            boot[i][r] = e[i];
+    }
+    free(use);
+
+    for (i = 0; i < t->nctl; ++i)
+    {
+        qsort(boot[i], BOOTSTRAP, sizeof boot[i][0], cmp_double);
+        order[i] = i;
+    }
+    for (i = 1; i < t->nctl; ++i)
+        for (j = i; j > 0 && elo[order[j]] > elo[order[j - 1]]; --j)
+        {
+            int tmp = order[j];
+
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+
+    printf("%-4s %-24s %7s %17s\n", "rank", "controller", "elo", "95% ci");
+    for (i = 0; i < t->nctl; ++i)
+    {
+        int c = order[i];
+
+        printf("%-4d %-24s %7.0f  [%6.0f, %6.0f]\n", i + 1, t->ctl[c]->name,
+                elo[c], boot[c][BOOTSTRAP * 25 / 1000],
+                boot[c][BOOTSTRAP * 975 / 1000]);
+    }
+
+    printf("\n%-24s %-24s %8s\n", "controller", "opponent", "score");
+    for (i = 0; i < t->npairs; ++i)
+    {
+        double s = 0.0;
+
+        for (j = 0; j < t->nseeds; ++j)
+            s += t->score[i * t->nseeds + j];
+        printf("%-24s %-24s %7.1f%%\n", t->ctl[t->pair[i][0]]->name,
+                t->ctl[t->pair[i][1]]->name, 100.0 * s / (4.0 * t->nseeds));
+    }
+}
+
+/*!
+ * Read the seed list from a file, one number per line.
+ */
+static unsigned *read_seeds(const char *path, int *n)
+{
+    FILE *f = fopen(path, "r");
+    unsigned *seed = NULL;
+    unsigned long v;
+    int cap = 0;
+
+    *n = 0;
+    if (f == NULL)
+        return NULL;
+    while (fscanf(f, "%lu", &v) == 1)
+    {
+        if (*n == cap)
+        {
+            unsigned *s = realloc(seed, (cap = 2 * cap + 1024) * sizeof *s);
+
+            if (s == NULL)
+                break;
+            seed = s;
+        }
+        seed[(*n)++] = v;
+    }
+    fclose(f);
+    return seed;
+}
+
+/*!
+ * Return the elapsed seconds since t0.
+ */
+static double elapsed(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-m weights]... [-P plugin]... [-n seeds] [-s seed]\n"
+            "          [-S seed_file]\n"
+            "          [-p period] [-j threads]\n"
+            "  -m weights    add a network controller (mlp.h)\n"
+            "  -P plugin     add a plugin controller (pong_plugin.h)\n"
+            "  -n seeds      seeds per pairing (default 5000)\n"
+            "  -s seed       first seed of the list (default 1)\n"
+            "  -S seed_file  read the seed list from a file instead\n"
+            "  -p period     ball steps per paddle move (default 2)\n"
+            "  -j threads    worker threads (default: all cores)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    static tournament t;
+    const char *seed_file = NULL;
+    unsigned first_seed = 1;
+    unsigned *seed;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t tid[MAX_THREADS];
+    struct timespec t0;
+    int total, opt, i, j;
+
+    t.ctl[t.nctl++] = ctl_chase();
+    t.ctl[t.nctl++] = ctl_predict();
+    t.nseeds = 5000;
+    t.period = 2;
+
+    /* one thread per cpu by default, up to MAX_THREADS */
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    while ((opt = getopt(argc, argv, "m:P:n:s:S:p:j:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm':
+                if (t.nctl == MAX_CTL)
+                {
+                    fprintf(stderr, "too many controllers\n");
+                    return EXIT_FAILURE;
+                }
+                if ((t.ctl[t.nctl] = mlp_load(optarg)) == NULL)
+                {
+                    fprintf(stderr, "cannot load weights from %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                t.ctl[t.nctl++]->name = optarg;
+                break;
+
+            case 'P':
+                if (t.nctl == MAX_CTL)
+                {
+                    fprintf(stderr, "too many controllers\n");
+                    return EXIT_FAILURE;
+                }
+                if ((t.ctl[t.nctl++] = plugin_load(optarg)) == NULL)
+                {
+                    fprintf(stderr, "cannot load plugin %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'n':
+                t.nseeds = atoi(optarg);
+                break;
+
+            case 's':
+                first_seed = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'S':
+                seed_file = optarg;
+                break;
+
+            case 'p':
+                t.period = atoi(optarg);
+                break;
+
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (seed_file)
+        seed = read_seeds(seed_file, &t.nseeds);
+    else if ((seed = malloc(MAX(t.nseeds, 1) * sizeof *seed)) != NULL)
+        for (i = 0; i < t.nseeds; ++i)
+            seed[i] = first_seed + i;
+    if (seed == NULL || t.nseeds < 1 || t.period < 1
+            || nthreads < 1 || nthreads > MAX_THREADS)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    t.seed = seed;
+
+    t.pair = malloc(t.nctl * t.nctl * sizeof *t.pair);
+    for (i = 0; t.pair && i < t.nctl; ++i)
+        for (j = i + 1; j < t.nctl; ++j)
+        {
+            t.pair[t.npairs][0] = i;
+            t.pair[t.npairs++][1] = j;
+        }
+    t.score = malloc(t.npairs * t.nseeds * sizeof *t.score);
+    if (t.pair == NULL || t.score == NULL)
+    {
+        perror("allocation error");
+        return EXIT_FAILURE;
+    }
+
+    total = 2 * t.npairs * t.nseeds;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < nthreads; ++i)
+        pthread_create(&tid[i], NULL, worker, &t);
+
+    /* stream the progress while the workers play */
+    for (;;)
+    {
+        int done = __atomic_load_n(&t.done, __ATOMIC_RELAXED);
+        double secs = elapsed(&t0);
+
+        fprintf(stderr, "\r%d/%d duels, %.0f duels/s", done, total,
+                secs > 0.0 ? done / secs : 0.0);
+        if (done == total)
+            break;
+        nanosleep(&(struct timespec) { 0, 200000000 }, NULL);
+    }
+    fprintf(stderr, "\n");
+
+    for (i = 0; i < nthreads; ++i)
+        pthread_join(tid[i], NULL);
+
+    report(&t);
+
+    for (i = 0; i < t.nctl; ++i)
+        ctl_destroy(t.ctl[i]);
+    free(t.pair);
+    free(t.score);
+    free(seed);
+    return 0;
+}
@@ -0,0 +1,420 @@
+/*!
+ * \file pong_tune.c
+ *
+ * \brief Evolutionary tuner of the ai difficulty.
+ *
+ * For each game level a genetic algorithm searches the tuned ai parameters
+ * (reaction, error, speed; see ai_level in rules.h) whose win rate against
+ * a model of a human player is closest to the target of the level. Every
+ * generation plays population x matches headless matches, fanned out over
+ * all the cores; all the candidates of a generation play the same seeded
+ * matches, so they are compared on equal ground.
+ *
+ * The human model aims at the ball every reaction ball steps, off by up to
+ * error rows, and moves one row per ball step. A match evaluating level L
+ * starts at level L and counts as a player win when the player clears the
+ * level or the ai misses, as an ai win when the player misses.
+ *
+ * The result is a level table (levels.h) the game loads at startup.
+ *
+ * Build: gcc -O2 -pthread -I.. pong_tune.c ../rules.c ../levels.c \
+ *            -o pong-tune
+ * Usage: pong-tune [-t targets] [-g generations] [-p population]
+ *                  [-n matches] [-j threads] [-H reaction,error] [-s seed]
+ *                  [-o levels]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "rules.h"
+#include "levels.h"
+
+#define MAX_POP 1024 /*!< max population size */
+#define MAX_THREADS 256 /*!< max worker threads */
+#define CHUNK 64 /*!< matches per work item */
+#define MAX_STEPS 20000 /*!< ball steps before a match is a draw */
+
+#define REACTION_MAX 12 /*!< search range of ai_level.reaction */
+#define ERROR_MAX 6 /*!< search range of ai_level.error */
+#define SPEED_MAX 3 /*!< search range of ai_level.speed */
+
+/*!
+ * Human player model
+ */
+typedef struct {
+    int reaction; /*!< ball steps between two aims */
+    int error; /*!< max rows of error of an aim */
+} human;
+
+/*!
+ * Evaluation of a generation, shared by the worker threads
+ */
+typedef struct {
+    const ai_level *pop; /*!< candidates */
+    int npop; /*!< number of candidates */
+    int level; /*!< level under evaluation */
+    int matches; /*!< matches per candidate */
+    unsigned seed; /*!< seed of the generation */
+    human player; /*!< player model */
+    int next; /*!< next work item, taken atomically */
+    int *wins; /*!< doubled player wins per work item (draw = 1) */
+} evaluation;
+
+/*!
+ * Return a well mixed 32 bit hash of x, never zero.
+ */
+static unsigned mix(unsigned x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x ? x : 1;
+}
+
+/*!
+ * Return the next xorshift random number.
+ */
+static unsigned next_rand(unsigned *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/*!
+ * Play one match at the given level; return 2 on player win, 1 on draw,
+ * 0 on ai win.
+ */
+static int play(const ai_level *p, int level, const human *h, unsigned seed)
+{
+    ai_level table[MAX_LEVEL + 1];
+    match_state m;
+    unsigned rng = mix(seed ^ 0x5bd1e995); /* human model random state */
+    int aim = 0, wait = 0;
+    int i;
+
+    for (i = 0; i <= MAX_LEVEL; ++i)
+        table[i] = *p;
+
+    match_serve(&m, 24, 80, (seed & 1) ? 1 : -1);
+    m.gameLevel = level;
+    m.rng = mix(seed);
+
+    for (i = 0; i < MAX_STEPS; ++i)
+    {
+        int ev;
+
+        /* human model */
+        if (--wait <= 0)
+        {
+            aim = m.ball_y;
+            if (h->error > 0)
+                aim += (int) (next_rand(&rng) % (2 * h->error + 1))
+                    - h->error;
+            wait = h->reaction;
+        }
+
+        ev = match_step_tuned(&m, (aim > m.paddle_pos) - (aim < m.paddle_pos),
+                table);
+        if (ev & (BALL_LEVEL_UP | BALL_PLAYER_WINS))
+            return 2;
+        if (ev & BALL_AI_WINS)
+            return 0;
+    }
+    return 1;
+}
+
+/*!
+ * Worker thread: play work items until none is left.
+ */
+static void *worker(void *arg)
+{
+    evaluation *e = arg;
+    int chunks = (e->matches + CHUNK - 1) / CHUNK;
+    int item;
+
+    while ((item = __atomic_fetch_add(&e->next, 1, __ATOMIC_RELAXED))
+            < e->npop * chunks)
+    {
+        int c = item / chunks;
+        int first = (item % chunks) * CHUNK;
+        int last = MIN(first + CHUNK, e->matches);
+        int wins = 0;
+        int j;
+
+        for (j = first; j < last; ++j)
+            wins += play(&e->pop[c], e->level, &e->player,
+                    mix(e->seed + j));
+        e->wins[item] = wins;
+    }
+    return NULL;
+}
+
+/*!
+ * Compute the player win rate of every candidate on nthreads threads.
+ */
+static void evaluate(evaluation *e, int nthreads, double *rate)
+{
+    pthread_t tid[MAX_THREADS];
+    int chunks = (e->matches + CHUNK - 1) / CHUNK;
+    int i, c;
+
+    e->next = 0;
+    for (i = 0; i < nthreads; ++i)
+        pthread_create(&tid[i], NULL, worker, e);
+    for (i = 0; i < nthreads; ++i)
+        pthread_join(tid[i], NULL);
+
+    for (c = 0; c < e->npop; ++c)
+    {
+        int wins = 0;
+
+        for (i = 0; i < chunks; ++i)
+            wins += e->wins[c * chunks + i];
+        rate[c] = wins / (2.0 * e->matches);
+    }
+}
+
+/*!
+ * Return a random candidate inside the search ranges.
+ */
+static ai_level random_level(unsigned *rng)
+{
+    ai_level p;
+
+    p.reaction = 1 + next_rand(rng) % REACTION_MAX;
+    p.error = next_rand(rng) % (ERROR_MAX + 1);
+    p.speed = 1 + next_rand(rng) % SPEED_MAX;
+    return p;
+}
+
+/*!
+ * Move a gene by one step with probability 1/3, inside [lo, hi].
+ */
+static int mutate(int gene, int lo, int hi, unsigned *rng)
+{
+    switch (next_rand(rng) % 6)
+    {
+        case 0:
+            return MAX(gene - 1, lo);
+        case 1:
+            return MIN(gene + 1, hi);
+        default:
+            return gene;
+    }
+}
+
+/*!
+ * Return the index of the better of two random candidates.
+ */
+static int select_parent(const double *fit, int npop, unsigned *rng)
+{
+    int a = next_rand(rng) % npop;
+    int b = next_rand(rng) % npop;
+
+    return fit[a] <= fit[b] ? a : b;
+}
+
+/*!
+ * Run the genetic algorithm for one level and return the best candidate.
+ */
+static ai_level tune_level(int level, double target, int generations,
+        int npop, int matches, int nthreads, const human *player,
+        unsigned seed)
+{
+    static ai_level pop[MAX_POP], next[MAX_POP];
+    double rate[MAX_POP], fit[MAX_POP];
+    evaluation e;
+    unsigned rng = mix(seed ^ level);
+    ai_level best = AI_LEVEL_CHASE;
+    double best_fit = 2.0, best_rate = 0.0;
+    int g, i;
+
+    e.pop = pop;
+    e.npop = npop;
+    e.level = level;
+    e.matches = matches;
+    e.player = *player;
+    e.wins = malloc(npop * ((matches + CHUNK - 1) / CHUNK) * sizeof *e.wins);
+    if (e.wins == NULL)
+    {
+        perror("allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < npop; ++i)
+        pop[i] = random_level(&rng);
+
+    for (g = 0; g < generations; ++g)
+    {
+        int elite = 0;
+        double lo = 1.0, hi = 0.0;
+
+        /* same matches for all the candidates of a generation */
+        e.seed = mix(seed + 7919 * g + 104729 * level);
+        evaluate(&e, nthreads, rate);
+
+        for (i = 0; i < npop; ++i)
+        {
+            fit[i] = rate[i] > target ? rate[i] - target : target - rate[i];
+            if (fit[i] < fit[elite])
+                elite = i;
+            lo = MIN(lo, rate[i]);
+            hi = MAX(hi, rate[i]);
+        }
+        if (fit[elite] < best_fit)
+        {
+            best = pop[elite];
+            best_fit = fit[elite];
+            best_rate = rate[elite];
+        }
+
+        fprintf(stderr, "level %d gen %3d: best %d/%d/%d win %.3f "
+                "(target %.3f, population %.3f-%.3f)\n",
+                level, g, pop[elite].reaction, pop[elite].error,
+                pop[elite].speed, rate[elite], target, lo, hi);
+
+        /* next generation: elite plus mutated uniform crossovers */
+        next[0] = pop[elite];
+        for (i = 1; i < npop; ++i)
+        {
+            const ai_level *a = &pop[select_parent(fit, npop, &rng)];
+            const ai_level *b = &pop[select_parent(fit, npop, &rng)];
+            unsigned pick = next_rand(&rng);
+
+            next[i].reaction = mutate((pick & 1) ? a->reaction : b->reaction,
+                    1, REACTION_MAX, &rng);
+            next[i].error = mutate((pick & 2) ? a->error : b->error,
+                    0, ERROR_MAX, &rng);
+            next[i].speed = mutate((pick & 4) ? a->speed : b->speed,
+                    1, SPEED_MAX, &rng);
+        }
+        memcpy(pop, next, npop * sizeof *pop);
+    }
+
+    if (best_fit > 0.05)
+        fprintf(stderr, "level %d: target %.3f not reached, best win %.3f%s\n",
+                level, target, best_rate,
+                BALL_DELAY(level) <= 0
+                ? " (ball runs unthrottled, the ai cannot move)" : "");
+
+    free(e.wins);
+    return best;
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-t targets] [-g generations] [-p population]\n"
+            "          [-n matches] [-j threads] [-H reaction,error]\n"
+            "          [-s seed] [-o levels]\n"
+            "  -t targets  player win rate per level, comma separated\n"
+            "  -g          generations per level (default 30)\n"
+            "  -p          candidates per generation (default 64)\n"
+            "  -n          matches per candidate (default 2000)\n"
+            "  -j          worker threads (default: all cores)\n"
+            "  -H          human model (default 3,1)\n"
+            "  -s          random seed (default 1)\n"
+            "  -o          output level table (default " LEVELS_FILE ")\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    double target[MAX_LEVEL + 1] = { 0.8, 0.65, 0.5, 0.35 };
+    ai_level levels[MAX_LEVEL + 1];
+    human player = { 3, 1 };
+    const char *out = LEVELS_FILE;
+    int generations = 30, npop = 64, matches = 2000;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned seed = 1;
+    int opt, i;
+
+    /* one thread per cpu by default, up to MAX_THREADS */
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    while ((opt = getopt(argc, argv, "t:g:p:n:j:H:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+            {
+                char *s = optarg;
+
+                for (i = 0; i <= MAX_LEVEL && *s; ++i)
+                {
+                    target[i] = strtod(s, &s);
+                    if (*s == ',')
+                        s++;
+                }
+                break;
+            }
+
+            case 'g':
+                generations = atoi(optarg);
+                break;
+
+            case 'p':
+                npop = atoi(optarg);
+                break;
+
+            case 'n':
+                matches = atoi(optarg);
+                break;
+
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+
+            case 'H':
+                if (sscanf(optarg, "%d,%d", &player.reaction, &player.error)
+                        != 2)
+                {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'o':
+                out = optarg;
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (npop < 2 || npop > MAX_POP || matches < 1 || generations < 1
+            || nthreads < 1 || nthreads > MAX_THREADS || player.reaction < 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i <= MAX_LEVEL; ++i)
+        levels[i] = tune_level(i, target[i], generations, npop, matches,
+                nthreads, &player, seed);
+
+    if (levels_save(out, levels) != 0)
+    {
+        perror(out);
+        return EXIT_FAILURE;
+    }
+    printf("level table written to %s\n", out);
+
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*!
+ * \file spectate_bench.c
+ *
+ * \brief Cost of the spectator fan-out (spectate.h) with many viewers.
+ *
+ * The parent process is the game: it opens the spectator socket, and once
+ * all the spectators joined it plays a headless match, publishing a wire
+ * frame at every ball step at the given rate. A child process opens the
+ * spectator connections and reads all of them with epoll, except for a
+ * share of slow spectators that never read, so that their queues fill up,
+ * get downgraded and finally dropped. The stream of the first spectator is
+ * decoded to check it stays well formed.
+ *
+ * The parent runs the fan-out as the game does, a slice of spectators at a
+ * time, and reports how long a slice holds the game and its cpu time per
+ * frame; the child reports how often each spectator gets an update.
+ *
+ * Build: gcc -O2 -I.. spectate_bench.c ../spectate.c ../wire.c \
+ *            ../rules.c ../sched.c -o spectate-bench
+ * Usage: spectate-bench [-n spectators] [-s slow%] [-f frames] [-r hz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "rules.h"
+#include "sched.h"
+#include "spectate.h"
+
+#define ROWS 24 /*!< court rows */
+#define COLS 80 /*!< court columns */
+#define JOIN_US 30000000 /*!< time allowed for all the spectators to join */
+
+/*!
+ * Return the cpu time of the process in us.
+ */
+static long long cpu_now(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL
+        + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/*!
+ * Connect to the spectator socket.
+ */
+static int join(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/*!
+ * The spectators: connect them all, then read the fast ones until the
+ * game closes them. Return non-zero if the checked stream is malformed.
+ */
+static int watch(const char *path, int n, int slow)
+{
+    struct epoll_event ev, events[256];
+    unsigned char buf[4096], stream[4096];
+    size_t len = 0;
+    long long received = 0, reads = 0, first = 0;
+    wire_objects o = { 0 };
+    wire_msg m;
+    int *fd = malloc(n * sizeof *fd);
+    int ep = epoll_create1(0);
+    int i, k, r, open_fds = 0, fds, bad = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        fd[i] = join(path);
+        if (fd[i] < 0)
+        {
+            perror("connect");
+            exit(EXIT_FAILURE);
+        }
+
+        /* every slow-th spectator never reads */
+        if (slow > 0 && i % slow == slow - 1)
+            continue;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd[i], &ev);
+        open_fds++;
+    }
+    fds = open_fds;
+
+    while (open_fds > 0 && (k = epoll_wait(ep, events, 256, -1)) > 0)
+        for (i = 0; i < k; ++i)
+        {
+            int s = events[i].data.u32;
+
+            r = read(fd[s], s == 0 ? stream + len : buf,
+                    s == 0 ? sizeof stream - len : sizeof buf);
+            if (r <= 0)
+            {
+                close(fd[s]);
+                open_fds--;
+                continue;
+            }
+            received += r;
+            reads++;
+            if (first == 0)
+                first = sched_now();
+            if (s == 0)
+            {
+                int off = 0, used;
+
+                len += r;
+                while ((used = wire_decode(stream + off, len - off, &m,
+                                &o)) > 0)
+                    off += used;
+                bad |= used < 0;
+                memmove(stream, stream + off, len - off);
+                len -= off;
+            }
+        }
+    printf("spectators: %lld bytes received, %.1f updates/s each, "
+            "first stream %s\n", received,
+            reads * 1e6 / (sched_now() - first) / (fds ? fds : 1),
+            bad ? "MALFORMED" : "well formed");
+    return bad;
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n spectators] [-s slow%%] [-f frames] [-r hz]\n"
+            "  -n  spectators (default 10000)\n"
+            "  -s  percent of spectators that never read (default 1)\n"
+            "  -f  frames to publish (default 900)\n"
+            "  -r  frame rate in hz (default 60)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    int n = 10000, slow_pct = 1, frames = 900, hz = 60;
+    char path[64];
+    struct rlimit rl;
+    spectators sp;
+    wire_out w;
+    wire_objects o;
+    match_state m;
+    long long t, start, cpu, worst = 0, busy = 0, next, slice_at = -1;
+    long slices = 0;
+    int f, opt, status;
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "n:s:f:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                n = atoi(optarg);
+                break;
+
+            case 's':
+                slow_pct = atoi(optarg);
+                break;
+
+            case 'f':
+                frames = atoi(optarg);
+                break;
+
+            case 'r':
+                hz = atoi(optarg);
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (n < 1 || slow_pct < 0 || slow_pct > 100 || frames < 1 || hz < 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* a socket per spectator on both sides */
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < (rlim_t) n + 16)
+    {
+        fprintf(stderr, "open file limit %ld is too low for %d spectators\n",
+                (long) rl.rlim_cur, n);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(path, sizeof path, "/tmp/spectate-bench.%d", (int) getpid());
+    wire_init(&w, -1);
+    if (spec_open(&sp, path, &w) != 0)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    match_serve(&m, ROWS, COLS, 1);
+    wire_court(&w, ROWS, COLS);
+    wire_score(&w, m.gameLevel, 0, 0);
+    wire_flush(&w);
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        close(sp.listen_fd);
+        close(sp.epoll_fd);
+        exit(watch(path, n,
+                    slow_pct ? 100 / slow_pct : 0) ? EXIT_FAILURE : 0);
+    }
+
+    /* everybody joins and gets the keyframe */
+    start = sched_now();
+    while (sp.joined < n && sched_now() - start < JOIN_US)
+        spec_events(&sp);
+    if (sp.joined < n)
+    {
+        fprintf(stderr, "only %ld spectators joined\n", sp.joined);
+        kill(pid, SIGKILL);
+        return EXIT_FAILURE;
+    }
+    printf("%d spectators joined in %.2f s\n", n,
+            (sched_now() - start) / 1e6);
+
+    /* the match, a frame per period, and the fan-out as the spectator
+     * coroutine of the game runs it */
+    cpu = cpu_now();
+    next = sched_now();
+    for (f = 0; f < frames; )
+    {
+        struct pollfd p = { sp.epoll_fd, POLLIN, 0 };
+        long long now = sched_now();
+        long long at = slice_at >= 0 && slice_at < next ? slice_at : next;
+
+        if (poll(&p, 1, at > now ? (at - now + 999) / 1000 : 0) > 0
+                || (slice_at >= 0 && sched_now() >= slice_at))
+        {
+            t = sched_now();
+            slice_at = spec_events(&sp) ? t + SPEC_SLICE_US : -1;
+            t = sched_now() - t;
+            busy += t;
+            worst = t > worst ? t : worst;
+            slices++;
+        }
+        if (sched_now() < next)
+            continue;
+
+        if (match_step(&m, (m.ball_y > m.paddle_pos)
+                    - (m.ball_y < m.paddle_pos)) & BALL_OVER)
+            match_serve(&m, ROWS, COLS, 1);
+        o.player = m.paddle_pos;
+        o.ai = m.ai_paddle_pos;
+        o.ball_y = m.ball_y;
+        o.ball_x = m.ball_x;
+        wire_frame(&w, &o);
+        wire_flush(&w);
+        next += 1000000 / hz;
+        f++;
+    }
+    cpu = cpu_now() - cpu;
+
+    printf("%d frames at %d hz: %ld slices of %.0f us (max %lld us), "
+            "cpu %.1f us/frame, %.1f%% of a core\n", frames, hz, slices,
+            slices ? (double) busy / slices : 0.0, worst,
+            (double) cpu / frames, 100.0 * cpu * hz / frames / 1e6);
+    spec_report(&sp, stdout);
+    fflush(stdout);
+    spec_close(&sp);
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
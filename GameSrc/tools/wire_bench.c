@@ -0,0 +1,189 @@
+/*!
+ * \file wire_bench.c
+ *
+ * \brief Bytes on the wire of the thin client stream (wire.h) against the
+ * ncurses escape stream.
+ *
+ * Headless matches are played with a player chasing the ball. At every
+ * ball step the moving objects are drawn with ncurses and refresh(), as
+ * the game did before it had its own encoder, on a terminal whose output
+ * goes to a temporary file; the same step is encoded as a wire frame. Each
+ * match starts with the court painted on a cleared screen on the ncurses
+ * side, and with a court and a score message on the wire side. Game time
+ * counts BALL_DELAY of the current level for every ball step.
+ *
+ * Build: gcc -O2 -I.. wire_bench.c ../wire.c ../rules.c -lncurses \
+ *            -o wire-bench
+ * Usage: wire-bench [-g games] [-r rows] [-c cols] [-t term]
+ */
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "rules.h"
+#include "wire.h"
+
+#define PADDLE_MARGIN 2 /*!< columns kept free for each paddle */
+#define MAX_STEPS 20000 /*!< ball steps before a match is stopped */
+
+/*!
+ * Draw or clear a paddle from its centre row, two columns wide from col.
+ */
+static void paddle(int row, int col, chtype pair)
+{
+    int i;
+
+    for (i = 0; i < PADDLE_WIDTH; ++i)
+    {
+        mvaddch(row - PADDLE_WIDTH / 2 + i, col, ' ' | pair);
+        mvaddch(row - PADDLE_WIDTH / 2 + i, col + 1, ' ' | pair);
+    }
+}
+
+/*!
+ * Clear the screen and paint the court lines.
+ */
+static void court(int rows, int cols)
+{
+    int y;
+
+    clear();
+    attron(COLOR_PAIR(2));
+    mvhline(0, PADDLE_MARGIN, ACS_HLINE, cols - 2 * PADDLE_MARGIN);
+    mvhline(rows - 1, PADDLE_MARGIN, ACS_HLINE, cols - 2 * PADDLE_MARGIN);
+    for (y = 1; y < rows - 1; y += 2)
+        mvaddch(y, cols / 2, ACS_VLINE);
+    attroff(COLOR_PAIR(2));
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-g games] [-r rows] [-c cols] [-t term]\n"
+            "  -g  matches to play (default 20)\n"
+            "  -r  court rows (default 24)\n"
+            "  -c  court columns (default 80)\n"
+            "  -t  terminal type of the ncurses side (default xterm)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    int games = 20, rows = 24, cols = 80;
+    const char *term = "xterm";
+    FILE *tty, *null_in;
+    wire_out w;
+    wire_objects o;
+    long frames = 0;
+    long long nc_bytes;
+    double secs = 0;
+    int g, opt;
+
+    while ((opt = getopt(argc, argv, "g:r:c:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'g':
+                games = atoi(optarg);
+                break;
+
+            case 'r':
+                rows = atoi(optarg);
+                break;
+
+            case 'c':
+                cols = atoi(optarg);
+                break;
+
+            case 't':
+                term = optarg;
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (games < 1 || rows < 10 || cols < 10)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* ncurses on a terminal writing into a temporary file */
+    tty = tmpfile();
+    null_in = fopen("/dev/null", "r");
+    if (tty == NULL || null_in == NULL
+            || newterm(term, tty, null_in) == NULL)
+    {
+        fprintf(stderr, "cannot open a %s terminal\n", term);
+        return EXIT_FAILURE;
+    }
+    resizeterm(rows, cols);
+    start_color();
+    init_pair(1, COLOR_WHITE, COLOR_BLUE);
+    init_pair(2, COLOR_GREEN, COLOR_BLACK);
+    init_pair(3, COLOR_RED, COLOR_BLACK);
+    curs_set(0);
+
+    wire_init(&w, open("/dev/null", O_WRONLY));
+    srand(1);
+
+    for (g = 0; g < games; ++g)
+    {
+        match_state m;
+        int ev = 0, steps;
+
+        match_serve(&m, rows, cols, rand() % 2 ? 1 : -1);
+        m.rng = rand() | 1;
+
+        court(rows, cols);
+        wire_court(&w, rows, cols);
+        wire_score(&w, m.gameLevel, 0, g);
+
+        for (steps = 0; steps < MAX_STEPS && !(ev & BALL_OVER); ++steps)
+        {
+            int dir = (m.ball_y > m.paddle_pos) - (m.ball_y < m.paddle_pos);
+            int player = m.paddle_pos, ai = m.ai_paddle_pos;
+            int by = m.ball_y, bx = m.ball_x;
+
+            secs += MAX(BALL_DELAY(m.gameLevel), 0) / 1e6;
+            ev = match_step(&m, dir);
+
+            /* ncurses: clear the old objects, draw the new ones */
+            paddle(player, m.paddle_col - 1, 0);
+            paddle(ai, m.ai_paddle_col, 0);
+            mvaddch(by, bx, ' ');
+            paddle(m.paddle_pos, m.paddle_col - 1, COLOR_PAIR(1));
+            paddle(m.ai_paddle_pos, m.ai_paddle_col, COLOR_PAIR(1));
+            mvaddch(m.ball_y, m.ball_x, 'o' | COLOR_PAIR(3));
+            refresh();
+
+            /* wire: the objects that moved */
+            o.player = m.paddle_pos;
+            o.ai = m.ai_paddle_pos;
+            o.ball_y = m.ball_y;
+            o.ball_x = m.ball_x;
+            wire_frame(&w, &o);
+            wire_flush(&w);
+            frames++;
+        }
+    }
+
+    endwin();
+    nc_bytes = lseek(fileno(tty), 0, SEEK_END);
+
+    printf("%d games, %ld frames, %.1f s of game time\n", games, frames,
+            secs);
+    printf("ncurses: %lld bytes, %.1f bytes/frame, %.0f bytes/s\n",
+            nc_bytes, (double) nc_bytes / frames, nc_bytes / secs);
+    printf("wire:    %lld bytes, %.1f bytes/frame, %.0f bytes/s, "
+            "%.1f times less\n", w.sent, (double) w.sent / frames,
+            w.sent / secs, (double) nc_bytes / w.sent);
+    return 0;
+}
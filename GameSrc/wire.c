@@ -0,0 +1,310 @@
+/*!
+ * \file wire.c
+ *
+ * \brief This file implements the frame-delta stream declared in wire.h.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "wire.h"
+
+/*!
+ * Append a varint.
+ */
+static void put_varint(wire_out *w, unsigned v)
+{
+    while (v >= 0x80)
+    {
+        w->buf[w->len++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    w->buf[w->len++] = v;
+}
+
+/*!
+ * Append a signed change as a zigzag varint: small changes of either sign
+ * take one byte.
+ */
+static void put_delta(wire_out *w, int d)
+{
+    put_varint(w, ((unsigned) d << 1) ^ (unsigned) (d >> 31));
+}
+
+/*!
+ * Start a message, flushing first if it might not fit.
+ */
+static int begin(wire_out *w, int type)
+{
+    if (!wire_active(w))
+        return 0;
+    if (w->len + WIRE_MAX > WIRE_BUF)
+        wire_flush(w);
+    w->buf[w->len++] = type;
+    return 1;
+}
+
+/*!
+ * Read a varint, return its bytes, 0 if incomplete, -1 if too long.
+ */
+static int get_varint(const unsigned char *buf, size_t len, unsigned *v)
+{
+    size_t i;
+
+    *v = 0;
+    for (i = 0; i < len && i < 5; ++i)
+    {
+        *v |= (unsigned) (buf[i] & 0x7f) << (7 * i);
+        if (!(buf[i] & 0x80))
+            return i + 1;
+    }
+    return i < 5 ? 0 : -1;
+}
+
+/*!
+ * Undo the zigzag encoding of a change.
+ */
+static int unzigzag(unsigned v)
+{
+    return (int) (v >> 1) ^ -(int) (v & 1);
+}
+
+/*!
+ * Append the changes from one set of coordinates to another as a frame
+ * message, if any coordinate changed.
+ */
+static void put_frame(wire_out *w, const wire_objects *from,
+        const wire_objects *to)
+{
+    int mask = (to->player != from->player ? WIRE_PLAYER : 0)
+        | (to->ai != from->ai ? WIRE_AI : 0)
+        | (to->ball_y != from->ball_y || to->ball_x != from->ball_x
+                ? WIRE_BALL : 0);
+
+    if (mask == 0)
+        return;
+    w->buf[w->len++] = WIRE_FRAME;
+    w->buf[w->len++] = mask;
+    if (mask & WIRE_PLAYER)
+        put_delta(w, to->player - from->player);
+    if (mask & WIRE_AI)
+        put_delta(w, to->ai - from->ai);
+    if (mask & WIRE_BALL)
+    {
+        put_delta(w, to->ball_y - from->ball_y);
+        put_delta(w, to->ball_x - from->ball_x);
+    }
+}
+
+/*!
+ */
+int wire_active(const wire_out *w)
+{
+    return w->fd >= 0 || w->tap != NULL;
+}
+
+/*!
+ */
+void wire_init(wire_out *w, int fd)
+{
+    w->fd = fd;
+    w->tap = NULL;
+    w->tap_ctx = NULL;
+    w->len = 0;
+    w->last.player = w->last.ai = w->last.ball_y = w->last.ball_x = 0;
+    w->rows = w->cols = 0;
+    w->score[0] = w->score[1] = w->score[2] = 0;
+    w->menu = -1;
+    w->arg = 0;
+    w->frames = 0;
+    w->sent = 0;
+}
+
+/*!
+ */
+void wire_court(wire_out *w, int rows, int cols)
+{
+    if (!begin(w, WIRE_COURT))
+        return;
+    put_varint(w, rows);
+    put_varint(w, cols);
+    w->last.player = w->last.ai = w->last.ball_y = w->last.ball_x = 0;
+    w->rows = rows;
+    w->cols = cols;
+    w->menu = -1;
+}
+
+/*!
+ */
+void wire_score(wire_out *w, int level, int won, int lost)
+{
+    if (!begin(w, WIRE_SCORE))
+        return;
+    put_varint(w, level);
+    put_varint(w, won);
+    put_varint(w, lost);
+    w->score[0] = level;
+    w->score[1] = won;
+    w->score[2] = lost;
+}
+
+/*!
+ */
+void wire_frame(wire_out *w, const wire_objects *o)
+{
+    if (!wire_active(w)
+            || (o->player == w->last.player && o->ai == w->last.ai
+                && o->ball_y == w->last.ball_y
+                && o->ball_x == w->last.ball_x))
+        return;
+    if (w->len + WIRE_MAX > WIRE_BUF)
+        wire_flush(w);
+    put_frame(w, &w->last, o);
+    w->last = *o;
+    w->frames++;
+}
+
+/*!
+ */
+void wire_menu(wire_out *w, int menu, int arg)
+{
+    if (!begin(w, WIRE_MENU))
+        return;
+    put_varint(w, menu);
+    put_varint(w, arg);
+    w->menu = menu;
+    w->arg = arg;
+}
+
+/*!
+ */
+int wire_flush(wire_out *w)
+{
+    size_t done = 0;
+
+    if (w->tap && w->len > 0)
+        w->tap(w->tap_ctx, w->buf, w->len);
+    while (w->fd >= 0 && done < w->len)
+    {
+        ssize_t n = write(w->fd, w->buf + done, w->len - done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            w->len = 0;
+            return -1;
+        }
+        done += n;
+    }
+    if (w->fd >= 0)
+        w->sent += w->len;
+    w->len = 0;
+    return 0;
+}
+
+/*!
+ * The keyframe is built in a scratch output, with the messages the stream
+ * would hold if it had just started: court, score, all the objects from
+ * zero and the menu on screen.
+ */
+size_t wire_keyframe(const wire_out *w, unsigned char *buf)
+{
+    static const wire_objects zero;
+    wire_out k;
+
+    k.len = 0;
+    if (w->rows > 0)
+    {
+        k.buf[k.len++] = WIRE_COURT;
+        put_varint(&k, w->rows);
+        put_varint(&k, w->cols);
+        k.buf[k.len++] = WIRE_SCORE;
+        put_varint(&k, w->score[0]);
+        put_varint(&k, w->score[1]);
+        put_varint(&k, w->score[2]);
+        put_frame(&k, &zero, &w->last);
+    }
+    if (w->menu >= 0)
+    {
+        k.buf[k.len++] = WIRE_MENU;
+        put_varint(&k, w->menu);
+        put_varint(&k, w->arg);
+    }
+    memcpy(buf, k.buf, k.len);
+    return k.len;
+}
+
+/*!
+ * The message is decoded into locals first, so that an incomplete one
+ * leaves the coordinates untouched for the next attempt.
+ */
+int wire_decode(const unsigned char *buf, size_t len, wire_msg *m,
+        wire_objects *o)
+{
+    int count, i, n;
+    size_t at = 1;
+    unsigned v[4];
+    wire_objects next = *o;
+
+    if (len == 0)
+        return 0;
+    m->type = buf[0];
+    switch (m->type)
+    {
+        case WIRE_COURT:
+        case WIRE_MENU:
+            count = 2;
+            break;
+
+        case WIRE_SCORE:
+            count = 3;
+            break;
+
+        case WIRE_FRAME:
+            if (len < 2)
+                return 0;
+            m->v[0] = buf[1];
+            if (m->v[0] & ~(WIRE_PLAYER | WIRE_AI | WIRE_BALL))
+                return -1;
+            at = 2;
+            count = !!(m->v[0] & WIRE_PLAYER) + !!(m->v[0] & WIRE_AI)
+                + 2 * !!(m->v[0] & WIRE_BALL);
+            break;
+
+        default:
+            return -1;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        n = get_varint(buf + at, len - at, &v[i]);
+        if (n <= 0)
+            return n;
+        at += n;
+    }
+
+    if (m->type != WIRE_FRAME)
+    {
+        for (i = 0; i < count; ++i)
+            m->v[i] = v[i];
+        if (m->type == WIRE_COURT)
+            next.player = next.ai = next.ball_y = next.ball_x = 0;
+    } else
+    {
+        /* zigzag changes, in mask order */
+        i = 0;
+        if (m->v[0] & WIRE_PLAYER)
+            next.player += unzigzag(v[i++]);
+        if (m->v[0] & WIRE_AI)
+            next.ai += unzigzag(v[i++]);
+        if (m->v[0] & WIRE_BALL)
+        {
+            next.ball_y += unzigzag(v[i++]);
+            next.ball_x += unzigzag(v[i++]);
+        }
+    }
+    *o = next;
+    return at;
+}
@@ -0,0 +1,176 @@
+/*!
+ * \file wire.h
+ *
+ * \brief Compact frame-delta stream for remote thin clients.
+ *
+ * Instead of the escape sequences painting a terminal, a game in wire
+ * mode sends what changed on the court, and a client process close to the
+ * player (tools/pong_client.c) draws it on its own terminal. The stream is
+ * a sequence of messages, a type byte followed by varints (7 bits per
+ * byte, least significant first, high bit set on all bytes but the last):
+ *
+ *     'C' rows cols          court size, the next frame is complete
+ *     'S' level won lost     score frame
+ *     'F' mask deltas...     objects that moved since the last frame
+ *     'M' menu arg           menu or banner (WIRE_MENU_*)
+ *
+ * A frame carries a WIRE_* mask of the objects it holds, then for each of
+ * them, in mask order, the zigzag encoded change of its coordinates: the
+ * player paddle row, the ai paddle row, the ball row and column. Every
+ * coordinate starts from zero after a court message.
+ *
+ * In the other direction the client sends the bytes of the keys, as an
+ * xterm in keypad mode would (ESC O A for the up arrow).
+ *
+ * A keyframe (wire_keyframe) holds the whole state in the same messages,
+ * so that a viewer can join the stream at any message boundary.
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+
+#define WIRE_COURT 'C' /*!< court size message */
+#define WIRE_SCORE 'S' /*!< score message */
+#define WIRE_FRAME 'F' /*!< frame message */
+#define WIRE_MENU 'M' /*!< menu message */
+
+#define WIRE_PLAYER 1 /*!< frame holds the player paddle */
+#define WIRE_AI 2 /*!< frame holds the ai paddle */
+#define WIRE_BALL 4 /*!< frame holds the ball */
+
+#define WIRE_MENU_INTRO 0 /*!< intro menu */
+#define WIRE_MENU_WON 1 /*!< game won menu */
+#define WIRE_MENU_LOST 2 /*!< game lost menu */
+#define WIRE_MENU_LEVEL 3 /*!< level cleared banner, arg is the level */
+
+#define WIRE_MAX 64 /*!< max bytes of a message */
+#define WIRE_BUF 256 /*!< bytes buffered before a flush */
+
+/*!
+ * Coordinates of the moving objects
+ */
+typedef struct {
+    int player; /*!< player paddle row */
+    int ai; /*!< ai paddle row */
+    int ball_y; /*!< ball row */
+    int ball_x; /*!< ball column */
+} wire_objects;
+
+/*!
+ * Wire output of a game
+ */
+typedef struct {
+    int fd; /*!< output, -1 when the game isn't in wire mode */
+    /*! also called with the bytes of every flush, when not NULL */
+    void (*tap)(void *ctx, const unsigned char *buf, size_t len);
+    void *tap_ctx; /*!< argument of tap */
+    unsigned char buf[WIRE_BUF]; /*!< messages not flushed yet */
+    size_t len; /*!< bytes used */
+    wire_objects last; /*!< coordinates the client knows */
+    int rows; /*!< court rows, 0 before the first court message */
+    int cols; /*!< court columns */
+    int score[3]; /*!< level, won and lost of the last score message */
+    int menu; /*!< menu of the last menu message, -1 after a court */
+    int arg; /*!< its argument */
+    long frames; /*!< frame messages sent */
+    long long sent; /*!< bytes sent */
+} wire_out;
+
+/*!
+ * Decoded message
+ */
+typedef struct {
+    int type; /*!< WIRE_COURT, WIRE_SCORE, WIRE_FRAME or WIRE_MENU */
+    int v[3]; /*!< values: rows cols, level won lost, mask, menu arg */
+} wire_msg;
+
+/*!
+ * \brief Return non-zero if the output has a destination, otherwise every
+ * call is a no-op.
+ *
+ * @param w wire output
+ */
+int wire_active(const wire_out *w);
+
+/*!
+ * \brief Initialize a wire output.
+ *
+ * @param w wire output
+ * @param fd output file descriptor, -1 for none
+ */
+void wire_init(wire_out *w, int fd);
+
+/*!
+ * \brief Queue a court size message.
+ *
+ * @param w wire output
+ * @param rows court rows
+ * @param cols court columns
+ */
+void wire_court(wire_out *w, int rows, int cols);
+
+/*!
+ * \brief Queue a score message.
+ *
+ * @param w wire output
+ * @param level game level
+ * @param won games won by the player
+ * @param lost games lost by the player
+ */
+void wire_score(wire_out *w, int level, int won, int lost);
+
+/*!
+ * \brief Queue a frame message with the objects that moved, if any.
+ *
+ * @param w wire output
+ * @param o current coordinates
+ */
+void wire_frame(wire_out *w, const wire_objects *o);
+
+/*!
+ * \brief Queue a menu message.
+ *
+ * @param w wire output
+ * @param menu WIRE_MENU_* menu
+ * @param arg menu argument
+ */
+void wire_menu(wire_out *w, int menu, int arg);
+
+/*!
+ * \brief Send the queued messages with a single write, and hand them to
+ * the tap.
+ *
+ * @param w wire output
+ * @return 0 on success, -1 on error
+ */
+int wire_flush(wire_out *w);
+
+/*!
+ * \brief Encode the whole state sent so far, as if the stream started
+ * now.
+ *
+ * @param w wire output
+ * @param buf at least WIRE_BUF bytes
+ * @return bytes of the keyframe
+ */
+size_t wire_keyframe(const wire_out *w, unsigned char *buf);
+
+/*!
+ * \brief Decode a message.
+ *
+ * Frame messages are applied to the coordinates, court messages reset
+ * them.
+ *
+ * @param buf received bytes
+ * @param len number of bytes
+ * @param m decoded message
+ * @param o coordinates known to the client
+ * @return bytes of the message, 0 if it isn't complete yet, -1 if the
+ * stream is malformed
+ */
+int wire_decode(const unsigned char *buf, size_t len, wire_msg *m,
+        wire_objects *o);
+
+#endif
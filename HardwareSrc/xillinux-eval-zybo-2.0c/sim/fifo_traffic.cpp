@@ -0,0 +1,296 @@
+/*!
+ * \file fifo_traffic.cpp
+ *
+ * \brief Verilator harness measuring the xillydemo FIFOs under game traffic.
+ *
+ * The FIFO (sync_fifo.v, the behavioral stand-in of the fifo_32x512 and
+ * fifo_8x2048 cores) runs on bus_clk. A game-shaped producer writes a small
+ * burst of words at every 60 Hz tick, plus a large frame dump every few
+ * ticks, as fast as the FIFO accepts them. The consumer is a host that
+ * wakes up every period cycles and reads one word every read cycles for
+ * window cycles, like a polling reader of the Xillybus device file.
+ *
+ * For the core depth the harness reports the sustained throughput, the
+ * cycles the producer found the FIFO full (the game blocked), the cycles
+ * the consumer found it empty inside its read window, the worst latency of
+ * a word through the FIFO and the highest fill. Then it searches the
+ * smallest depth the producer never blocks on with the same traffic.
+ *
+ * Build (one binary per core):
+ *     verilator --cc --exe --build -O3 -GWIDTH=32 -GDEPTH=512 \
+ *         -CFLAGS "-DFIFO_WIDTH=32 -DFIFO_DEPTH=512" \
+ *         -o fifo-traffic-32x512 sync_fifo.v fifo_traffic.cpp
+ *     verilator --cc --exe --build -O3 -GWIDTH=8 -GDEPTH=2048 \
+ *         -CFLAGS "-DFIFO_WIDTH=8 -DFIFO_DEPTH=2048" \
+ *         -o fifo-traffic-8x2048 sync_fifo.v fifo_traffic.cpp
+ * Usage: obj_dir/fifo-traffic-32x512 [-b burst] [-d dump] [-e every]
+ *            [-p period] [-w window] [-r read] [-t ticks] [-c clock]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <deque>
+#include <unistd.h>
+#include "Vsync_fifo.h"
+#include "verilated.h"
+
+#ifndef FIFO_WIDTH
+#define FIFO_WIDTH 32 /*!< data width, must match -GWIDTH */
+#endif
+#ifndef FIFO_DEPTH
+#define FIFO_DEPTH 512 /*!< core depth, must match -GDEPTH */
+#endif
+
+#define TICK_HZ 60 /*!< game frame rate */
+#define CELLS (80 * 24) /*!< bytes of a full screen dump */
+
+/*!
+ * Traffic pattern
+ */
+struct traffic
+{
+    long burst; /*!< words written at every tick */
+    long dump; /*!< words of a frame dump */
+    long every; /*!< ticks between two frame dumps */
+    long period; /*!< cycles between two host wakeups */
+    long window; /*!< cycles the host reads after a wakeup */
+    long read; /*!< cycles between two reads inside the window */
+    long ticks; /*!< game ticks to simulate */
+    long clock; /*!< bus_clk frequency in Hz */
+};
+
+/*!
+ * Measures of a run
+ */
+struct result
+{
+    uint64_t cycles; /*!< simulated cycles */
+    uint64_t words; /*!< words through the FIFO */
+    uint64_t full_stalls; /*!< cycles the producer found the FIFO full */
+    uint64_t empty_stalls; /*!< cycles in a read window with an empty FIFO */
+    uint64_t max_latency; /*!< worst cycles from write to read */
+    uint64_t max_fill; /*!< highest number of words in the FIFO */
+    uint64_t errors; /*!< words read out of order */
+};
+
+/*!
+ * Clock the FIFO through one rising edge.
+ */
+static void cycle(Vsync_fifo *f)
+{
+    f->clk = 0;
+    f->eval();
+    f->clk = 1;
+    f->eval();
+}
+
+/*!
+ * Run the traffic through the FIFO limited to depth words.
+ */
+static result run(Vsync_fifo *f, const traffic &t, long depth)
+{
+    const uint64_t mask = (FIFO_WIDTH < 64 ? 1ULL << FIFO_WIDTH : 0) - 1;
+    const uint64_t frame = t.clock / TICK_HZ;
+    std::deque<uint64_t> stamps; /* write cycle of the words in the FIFO */
+    result r = {};
+    uint64_t seq_in = 0, seq_out = 0;
+    long pending = 0;
+
+    f->limit = depth;
+    f->wr_en = 0;
+    f->rd_en = 0;
+    f->srst = 1;
+    cycle(f);
+    cycle(f);
+    f->srst = 0;
+
+    r.cycles = frame * t.ticks;
+    for (uint64_t now = 0; now < r.cycles; ++now)
+    {
+        uint64_t phase = now % t.period;
+        bool wr, rd;
+
+        /* game side: the tick burst and the frame dumps */
+        if (now % frame == 0)
+        {
+            pending += t.burst;
+            if ((now / frame) % t.every == 0)
+                pending += t.dump;
+        }
+        wr = pending > 0 && !f->full;
+        if (pending > 0 && f->full)
+            r.full_stalls++;
+
+        /* host side: polling reader */
+        rd = false;
+        if (phase < (uint64_t) t.window && phase % t.read == 0)
+        {
+            if (f->empty)
+                r.empty_stalls++;
+            else
+                rd = true;
+        }
+
+        f->wr_en = wr;
+        f->rd_en = rd;
+        f->din = seq_in & mask;
+        cycle(f);
+
+        if (wr)
+        {
+            stamps.push_back(now);
+            seq_in++;
+            pending--;
+        }
+        if (rd)
+        {
+            uint64_t late = now - stamps.front();
+
+            if (f->dout != (seq_out & mask))
+                r.errors++;
+            if (late > r.max_latency)
+                r.max_latency = late;
+            stamps.pop_front();
+            seq_out++;
+        }
+        if (f->count > r.max_fill)
+            r.max_fill = f->count;
+    }
+    r.words = seq_out;
+    return r;
+}
+
+/*!
+ * \brief Print the measures of a run.
+ */
+static void report(const traffic &t, long depth, const result &r)
+{
+    double secs = (double) r.cycles / t.clock;
+    double us = 1e6 / t.clock;
+
+    printf("fifo %dx%ld: %llu words in %.3f s, %.0f words/s (%.1f kB/s)\n",
+            FIFO_WIDTH, depth, (unsigned long long) r.words, secs,
+            r.words / secs, r.words * FIFO_WIDTH / 8 / secs / 1e3);
+    printf("  full stalls %llu cycles, empty stalls %llu cycles\n",
+            (unsigned long long) r.full_stalls,
+            (unsigned long long) r.empty_stalls);
+    printf("  worst latency %llu cycles (%.1f us), max fill %llu words\n",
+            (unsigned long long) r.max_latency, r.max_latency * us,
+            (unsigned long long) r.max_fill);
+    if (r.errors)
+        printf("  %llu words read out of order\n",
+                (unsigned long long) r.errors);
+}
+
+/*!
+ * \brief Print command line usage.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-b burst] [-d dump] [-e every] [-p period]\n"
+            "          [-w window] [-r read] [-t ticks] [-c clock]\n"
+            "  -b  words written at every tick\n"
+            "  -d  words of a frame dump\n"
+            "  -e  ticks between two frame dumps (default 10)\n"
+            "  -p  cycles between two host wakeups (default 100000)\n"
+            "  -w  cycles the host reads after a wakeup (default 5000)\n"
+            "  -r  cycles between two host reads (default 1)\n"
+            "  -t  game ticks to simulate (default 60)\n"
+            "  -c  bus_clk frequency in Hz (default 100000000)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    /* 16 bytes of commands per tick, a full screen dump every 10 ticks */
+    traffic t = { 16 * 8 / FIFO_WIDTH, CELLS * 8 / FIFO_WIDTH, 10,
+        100000, 5000, 1, 60, 100000000 };
+    Vsync_fifo *f;
+    result r;
+    long lo, hi;
+    int opt;
+
+    Verilated::commandArgs(argc, argv);
+
+    while ((opt = getopt(argc, argv, "b:d:e:p:w:r:t:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                t.burst = atol(optarg);
+                break;
+
+            case 'd':
+                t.dump = atol(optarg);
+                break;
+
+            case 'e':
+                t.every = atol(optarg);
+                break;
+
+            case 'p':
+                t.period = atol(optarg);
+                break;
+
+            case 'w':
+                t.window = atol(optarg);
+                break;
+
+            case 'r':
+                t.read = atol(optarg);
+                break;
+
+            case 't':
+                t.ticks = atol(optarg);
+                break;
+
+            case 'c':
+                t.clock = atol(optarg);
+                break;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (t.burst < 0 || t.dump < 0 || t.every < 1 || t.period < 1
+            || t.window < 1 || t.read < 1 || t.ticks < 1
+            || t.clock < TICK_HZ)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    f = new Vsync_fifo;
+
+    r = run(f, t, FIFO_DEPTH);
+    report(t, FIFO_DEPTH, r);
+
+    /* binary search of the smallest depth the game never blocks on */
+    lo = 1;
+    hi = FIFO_DEPTH;
+    if (r.full_stalls == 0)
+    {
+        while (lo < hi)
+        {
+            long mid = (lo + hi) / 2;
+
+            if (run(f, t, mid).full_stalls == 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        printf("smallest depth that never blocks at %d Hz: %ld words\n",
+                TICK_HZ, lo);
+    }
+    else
+        printf("the game blocks even at depth %d: the host drains too "
+                "slowly\n", FIFO_DEPTH);
+
+    f->final();
+    delete f;
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Behavioral model of the fifo_32x512 and fifo_8x2048 cores (Xilinx FIFO
+// Generator, common clock, standard read mode) for simulation: dout is
+// registered and valid the cycle after rd_en, full and empty are
+// registered flags. The cores themselves are netlists and can't be
+// simulated outside the Xilinx tools.
+//
+// limit lowers the usable depth at run time (1 to DEPTH) so that a single
+// simulation build can search the smallest depth that fits a traffic
+// pattern; tie it to DEPTH for the plain core behaviour.
+
+module sync_fifo
+  #(
+    parameter WIDTH = 32,
+    parameter DEPTH = 512,
+    parameter AW = $clog2(DEPTH)
+    )
+   (
+    input              clk,
+    input              srst,
+    input [AW:0]       limit,
+    input [WIDTH-1:0]  din,
+    input              wr_en,
+    input              rd_en,
+    output reg [WIDTH-1:0] dout,
+    output             full,
+    output             empty,
+    output reg [AW:0]  count
+    );
+
+   reg [WIDTH-1:0]     mem[0:DEPTH-1];
+   reg [AW-1:0]        wr_ptr;
+   reg [AW-1:0]        rd_ptr;
+
+   wire                do_wr = wr_en && !full;
+   wire                do_rd = rd_en && !empty;
+
+   assign full = (count >= limit);
+   assign empty = (count == 0);
+
+   always @(posedge clk)
+     if (srst)
+       begin
+	  wr_ptr <= 0;
+	  rd_ptr <= 0;
+	  count <= 0;
+       end
+     else
+       begin
+	  if (do_wr)
+	    begin
+	       mem[wr_ptr] <= din;
+	       wr_ptr <= (wr_ptr == DEPTH - 1) ? 0 : wr_ptr + 1;
+	    end
+
+	  if (do_rd)
+	    begin
+	       dout <= mem[rd_ptr];
+	       rd_ptr <= (rd_ptr == DEPTH - 1) ? 0 : rd_ptr + 1;
+	    end
+
+	  count <= count + do_wr - do_rd;
+       end
+
+endmodule
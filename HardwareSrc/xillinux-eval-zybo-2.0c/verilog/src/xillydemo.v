@@ -233,7 +233,15 @@ module xillydemo
     .vga_vsync(vga_vsync)
   );
 
-   assign      user_irq = 0; // No interrupts for now
+   // Frame tick interrupt: vsync is brought into the user_clk domain and
+   // each of its rising edges raises user_irq for one user_clk cycle, so
+   // the host gets exactly one interrupt per frame (/dev/uio0).
+   reg [2:0]   vsync_sync;
+
+   always @(posedge user_clk)
+     vsync_sync <= { vsync_sync[1:0], vga_vsync };
+
+   assign      user_irq = vsync_sync[1] && !vsync_sync[2];
    
    always @(posedge user_clk)
      begin
@@ -276,6 +276,8 @@ architecture sample_arch of xillydemo is
   signal user_wr_data :  std_logic_vector(31 DOWNTO 0);
   signal user_addr :  std_logic_vector(31 DOWNTO 0);
   signal user_irq :  std_logic;
+  signal vsync :  std_logic;
+  signal vsync_sync :  std_logic_vector(2 DOWNTO 0);
 
   -- Note that none of the ARM processor's direct connections to pads is
   -- defined as I/O on this module. Normally, they should be connected
@@ -424,7 +426,7 @@ begin
       vga4_green => vga4_green,
       vga4_red => vga4_red,
       vga_hsync => vga_hsync,
-      vga_vsync => vga_vsync,
+      vga_vsync => vsync,
       hdmi_clk_p => hdmi_clk_p,
       hdmi_clk_n => hdmi_clk_n,
       hdmi_d_p => hdmi_d_p,
@@ -434,7 +436,20 @@ begin
 
   -- Xillybus Lite
   
-  user_irq <= '0'; -- No interrupts for now
+  -- Frame tick interrupt: vsync is brought into the user_clk domain and
+  -- each of its rising edges raises user_irq for one user_clk cycle, so
+  -- the host gets exactly one interrupt per frame (/dev/uio0).
+
+  vga_vsync <= vsync;
+
+  process (user_clk)
+  begin
+    if (user_clk'event and user_clk = '1') then
+      vsync_sync <= vsync_sync(1 DOWNTO 0) & vsync;
+    end if;
+  end process;
+
+  user_irq <= vsync_sync(1) and not vsync_sync(2);
 
   lite_addr <= conv_integer(user_addr(6 DOWNTO 2));
 